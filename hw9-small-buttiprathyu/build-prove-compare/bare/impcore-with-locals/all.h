@@ -19,7 +19,7 @@
 
 
 /* type definitions for \impcore 43a */
-typedef int32_t Value;
+typedef int64_t Value;  // an integer, or in bignum mode, maybe a handle
 typedef struct Valuelist *Valuelist;     // list of Value
 /* type definitions for \impcore 43b */
 typedef struct Funlist *Funlist; // list of Fun
@@ -36,6 +36,7 @@ typedef enum { LITERAL, VAR, SET, IFX, WHILEX, BEGIN, APPLY } Expalt;
 
 /* type definitions for \impcore (generated by a script) */
 typedef struct Userfun Userfun; 
+typedef struct Code *Code;  // a function body compiled for [[eval]]'s machine
 typedef struct Def *Def;
 typedef enum { VAL, EXP, DEFINE } Defalt; 
 /* type definitions for \impcore (generated by a script) */
@@ -47,6 +48,15 @@ typedef enum { CHECK_EXPECT, CHECK_ASSERT, CHECK_ERROR } UnitTestalt;
 /* type definitions for \impcore (generated by a script) */
 typedef struct Fun Fun;
 typedef enum { USERDEF, PRIMITIVE } Funalt; 
+/* operations of the primitive functions, chosen when [[main]] binds them */
+typedef enum Primop {
+    ADD, SUB, MUL, DIV, LT, GT, EQ, PRINT, PRINTLN, PRINTU,
+    MKARRAY, ARRAYAT, ARRAYPUT, ARRAYSIZE
+} Primop;
+/* type definitions for \impcore: numbers */
+typedef enum Arithmetic { ARITH32, ARITH64, ARITHBIG } Arithmetic;
+/* type definitions for \impcore: arrays */
+typedef struct Array { Value *elems; int size; } Array;
 /* shared type definitions 42b */
 typedef struct Name *Name;
 typedef struct Namelist *Namelist;   // list of Name
@@ -127,10 +137,19 @@ struct Exp {
         Explist begin;
         struct { Name name; Explist actuals; } apply;
     } u;
+    union { Value *val; Fun *fun; } slot;  // of a global VAR, SET, or APPLY,
+                                           // or NULL until first evaluated
+    int index;    // of a VAR or SET, index in the activation record of
+                  // the formal or local it names, or -1
+    Exp source;   // if made by the optimizer, the expression it was made
+                  // from, which messages print; otherwise NULL
 };
 
 /* structure definitions for \impcore (generated by a script) */
-struct Userfun { Namelist formals; Namelist locals; Exp body; };
+struct Userfun {
+    Namelist formals; Namelist locals; Exp body; Code code;
+    int nformals, nlocals;  // lengths of formals and locals
+};
 struct Def {
     Defalt alt;
     union {
@@ -155,7 +174,8 @@ struct UnitTest {
 };
 
 /* structure definitions for \impcore (generated by a script) */
-struct Fun { Funalt alt; union { Userfun userdef; Name primitive; } u; }; 
+struct Fun { Funalt alt; union { Userfun userdef;
+                              struct { Name name; Primop op; } primitive; } u; }; 
 /* structure definitions for \impcore (generated by a script) */
 struct Parlist {
    Par hd;
@@ -230,11 +250,16 @@ Fun   fetchfun(Name name, Funenv env);
 /* function prototypes for \impcore 44d */
 bool isvalbound(Name name, Valenv env);
 bool isfunbound(Name name, Funenv env);
+/* function prototypes for \impcore: slots */
+Value *findval(Name name, Valenv env);  // NULL if name is not bound
+Fun   *findfun(Name name, Funenv env);  // NULL if name is not bound
+void   bindslots(Exp body, Namelist formals, Namelist locals);
+void   markvalenv(Valenv env);  // calls marknumber on each value in env
 /* function prototypes for \impcore 44e */
 void bindval(Name name, Value val, Valenv env);
 void bindfun(Name name, Fun   fun, Funenv env);
 /* function prototypes for \impcore 45a */
-Value eval   (Exp e, Valenv globals, Funenv functions, Valenv formals);
+Value eval   (Exp e, Valenv globals, Funenv functions);
 void  evaldef(Def d, Valenv globals, Funenv functions, Echo echo_level);
 /* function prototypes for \impcore S129a */
 void readevalprint(XDefstream s, Valenv globals, Funenv functions, Echo
@@ -283,7 +308,7 @@ struct UnitTest mkCheckAssertStruct(Exp check_assert);
 struct UnitTest mkCheckErrorStruct(Exp check_error);
 /* function prototypes for \impcore 43e */
 Fun mkUserdef(Userfun userdef);
-Fun mkPrimitive(Name primitive);
+Fun mkPrimitive(Name name, Primop op);
 /* function prototypes for \impcore (generated by a script) */
 int     lengthPL(Parlist ps);
 Par     nthPL   (Parlist ps, unsigned n);
@@ -418,8 +443,35 @@ Printbuf errorbuf;         /* if error occurs during a test, message is here */
 /* shared function prototypes S28 */
 extern int  checkoverflow(int limit);
 extern void reset_overflow_check(void);
-/* shared function prototypes S30a */
-extern void checkarith(char operation, int32_t n, int32_t m, int precision);
+/* function prototypes for \impcore: numbers */
+extern Arithmetic arithmetic;      // chosen by BPCOPTIONS
+extern Value smallmin, smallmax;   // integers that are their own values
+void  initarithmetic(void);
+Value arith(char operation, Value n, Value m);  // + - * /, m != 0 for /
+int   compare(Value n, Value m);                // negative, zero, or positive
+bool  readnumber(const char *numeral, Value *vp); // false if it doesn't fit
+void  printnumber(Printbuf output, Value v);
+extern bool numbersgrew;           // big integers doubled since last sweep
+void  marknumber(Value v);         // v is in a root
+void  sweepnumbers(void);          // frees the big integers not marked
+Value holdnumber(Value v);         // keeps v alive outside the roots...
+void  releasenumber(Value v);      // ... until it is released
+/* function prototypes for \impcore: arrays */
+extern Array *arrays;  // arrays[1..narrays] are the arrays made so far
+extern int narrays;
+Value  mkarray  (Exp e, Value size, Value init);
+Value *arrayelem(Exp e, Value a, Value i);  // checks a and i
+Value  arraysize(Exp e, Value a);
+/* function prototypes for \impcore: optimizing */
+Exp  optimize (Name f, Userfun *fun, Funenv functions, int *nslots);
+bool inlinable(Name f, Userfun *fun);  // might a call to f be inlined?
+/* function prototypes for \impcore: profiling */
+extern bool profiling;          // BPCOPTIONS holds profile
+extern unsigned long profsteps; // evaluation steps, counted while profiling
+void initprofile(void);
+void profenter(Name f);         // a call to f begins
+void profexit(void);            // the innermost call ends
+void profunwind(void);          // every call ends, after an error
 /* shared function prototypes S31a */
 void fprint_utf8(FILE *output, unsigned code_point);
 void print_utf8 (unsigned u);
@@ -1,20 +1,591 @@
 #include "all.h"
-/* arith.c S30b */
-void checkarith(char operation, int32_t n, int32_t m, int precision) {
-  int64_t nx = n;
-  int64_t mx = m;
-  int64_t result;
-  switch (operation) {
-    case '+': result = nx + mx; break;
-    case '-': result = nx - mx; break;
-    case '*': result = nx * mx; break;
-    case '/': result = mx != 0 ? nx / mx : 0; break;
-    default:  return;  /* other operations can't overflow */
-  }
-
-/* if [[result]] cannot be represented using [[precision]] signed bits, signal overflow S30c */
-  assert(precision > 0 && precision < 64);  // shifts are defined
-  if ((result << (64-precision)) >> precision != result) {
-    runerror("Arithmetic overflow");
-  }
+/* arith.c: Impcore's numbers */
+/*
+ * Impcore has three kinds of arithmetic, chosen when the interpreter
+ * starts.  By default an integer has 32 bits; if [[BPCOPTIONS]] holds
+ * [[int64]], an integer has 64 bits; and if it holds [[bignum]], an
+ * integer has as many bits as it needs.  In the first two modes, a
+ * result that does not fit is a run-time error.
+ *
+ * A [[Value]] has 64 bits in every mode.  An integer in the range
+ * [[smallmin..smallmax]] is its own value.  In bignum mode that range
+ * has 63 bits, and an integer outside it is a big integer, which is
+ * interned in a table and represented by a handle below [[smallmin]].
+ * Because equal big integers share one handle, two values are equal
+ * integers exactly when they are equal values, and every value but 0
+ * is true.  A big integer that no root holds is freed by the evaluator,
+ * and its handle is used again.
+ *
+ * [[arith]] and [[compare]] work in every mode, but a caller that finds
+ * its operands and result in the small range may skip them.
+ */
+Arithmetic arithmetic = ARITH32;
+Value smallmin = INT32_MIN;
+Value smallmax = INT32_MAX;
+
+void initarithmetic(void) {
+    const char *options = getenv("BPCOPTIONS");
+
+    if (options != NULL && strstr(options, "bignum") != NULL) {
+        arithmetic = ARITHBIG;
+        smallmin = -((Value)1 << 62);
+        smallmax = ((Value)1 << 62) - 1;
+    } else if (options != NULL && strstr(options, "int64") != NULL) {
+        arithmetic = ARITH64;
+        smallmin = INT64_MIN;
+        smallmax = INT64_MAX;
+    }
+}
+/* arith.c: magnitudes */
+/*
+ * The magnitude of a big integer is an array of 32-bit limbs, least
+ * significant first, with no leading zero limbs.  Operations allocate
+ * their results.  A magnitude may also be a view into part of another
+ * one's limbs; views are never freed.
+ */
+typedef struct Mag {
+    uint32_t *d;
+    int n;
+} Mag;
+
+#define KARATSUBA 32  /* limbs in the shorter factor before Karatsuba pays */
+
+static Mag magnew(int n) {
+    Mag m;
+
+    m.d = calloc(n > 0 ? n : 1, sizeof(*m.d));
+    assert(m.d != NULL);
+    m.n = n;
+    return m;
+}
+
+static Mag magtrim(Mag m) {
+    while (m.n > 0 && m.d[m.n - 1] == 0)
+        m.n--;
+    return m;
+}
+
+static Mag magview(Mag m, int lo, int hi) {  // limbs [lo..hi) of m
+    Mag v;
+
+    if (hi > m.n)
+        hi = m.n;
+    v.d = m.d + lo;
+    v.n = hi > lo ? hi - lo : 0;
+    return magtrim(v);
+}
+
+static int magcmp(Mag a, Mag b) {
+    int i;
+
+    if (a.n != b.n)
+        return a.n < b.n ? -1 : 1;
+    for (i = a.n - 1; i >= 0; i--)
+        if (a.d[i] != b.d[i])
+            return a.d[i] < b.d[i] ? -1 : 1;
+    return 0;
+}
+
+static void addinto(Mag r, Mag a, int offset) {  // r += a * 2^(32*offset)
+    uint64_t carry = 0;
+    int i;
+
+    for (i = 0; i < a.n || carry != 0; i++) {
+        assert(offset + i < r.n);
+        carry += (uint64_t)r.d[offset + i] + (i < a.n ? a.d[i] : 0);
+        r.d[offset + i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+static void subfrom(Mag r, Mag a) {  // r -= a, where r >= a
+    int64_t borrow = 0;
+    int i;
+
+    for (i = 0; i < a.n || borrow != 0; i++) {
+        assert(i < r.n);
+        borrow += (int64_t)r.d[i] - (i < a.n ? a.d[i] : 0);
+        r.d[i] = (uint32_t)borrow;
+        borrow = borrow < 0 ? -1 : 0;
+    }
+}
+
+static Mag magadd(Mag a, Mag b) {
+    Mag r = magnew((a.n > b.n ? a.n : b.n) + 1);
+
+    addinto(r, a, 0);
+    addinto(r, b, 0);
+    return magtrim(r);
+}
+
+static Mag magsub(Mag a, Mag b) {  // a >= b
+    Mag r = magnew(a.n);
+
+    memcpy(r.d, a.d, a.n * sizeof(*a.d));
+    subfrom(r, b);
+    return magtrim(r);
+}
+
+static Mag magmul(Mag a, Mag b);
+
+static Mag schoolbook(Mag a, Mag b) {
+    Mag r = magnew(a.n + b.n);
+    int i, j;
+
+    for (i = 0; i < a.n; i++) {
+        uint64_t carry = 0;
+
+        for (j = 0; j < b.n; j++) {
+            carry += (uint64_t)a.d[i] * b.d[j] + r.d[i + j];
+            r.d[i + j] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        r.d[i + b.n] = (uint32_t)carry;
+    }
+    return magtrim(r);
+}
+/*
+ * Karatsuba splits each factor at limb [[k]], into [[x1 * B^k + x0]],
+ * and forms the product from three half-size products instead of four:
+ * [[z2 * B^2k + ((a0 + a1)(b0 + b1) - z2 - z0) * B^k + z0]].
+ */
+static Mag karatsuba(Mag a, Mag b) {
+    int k = ((a.n > b.n ? a.n : b.n) + 1) / 2;
+    Mag a0 = magview(a, 0, k), a1 = magview(a, k, a.n);
+    Mag b0 = magview(b, 0, k), b1 = magview(b, k, b.n);
+    Mag z0 = magmul(a0, b0), z2 = magmul(a1, b1);
+    Mag sa = magadd(a0, a1), sb = magadd(b0, b1);
+    Mag z1 = magmul(sa, sb);
+    Mag r = magnew(a.n + b.n + 1);
+
+    subfrom(z1, z0);
+    subfrom(z1, z2);
+    addinto(r, z0, 0);
+    addinto(r, magtrim(z1), k);
+    addinto(r, z2, 2 * k);
+    free(z0.d); free(z2.d); free(sa.d); free(sb.d); free(z1.d);
+    return magtrim(r);
+}
+
+static Mag magmul(Mag a, Mag b) {
+    if (a.n < KARATSUBA || b.n < KARATSUBA)
+        return schoolbook(a, b);
+    else
+        return karatsuba(a, b);
+}
+/*
+ * Division is Knuth's Algorithm D, with both operands shifted so that
+ * the divisor's top limb has its high bit set.  Only the quotient is
+ * kept, truncated toward zero as in C.
+ */
+static uint32_t shortdiv(Mag q, Mag a, uint32_t v) {  // q = a / v; remainder
+    uint64_t rem = 0;
+    int i;
+
+    for (i = a.n - 1; i >= 0; i--) {
+        rem = (rem << 32) | a.d[i];
+        q.d[i] = (uint32_t)(rem / v);
+        rem %= v;
+    }
+    return (uint32_t)rem;
+}
+
+static Mag magdiv(Mag u, Mag v) {  // v > 0
+    Mag q, un, vn;
+    int s, i, j, m = u.n - v.n, n = v.n;
+
+    if (magcmp(u, v) < 0)
+        return magnew(0);
+    q = magnew(m + 1);
+    if (n == 1) {
+        shortdiv(q, u, v.d[0]);
+        return magtrim(q);
+    }
+    for (s = 0; (v.d[n - 1] << s & 0x80000000u) == 0; s++)
+        ;
+    vn = magnew(n);
+    for (i = n - 1; i > 0; i--)
+        vn.d[i] = (v.d[i] << s) | (s ? v.d[i - 1] >> (32 - s) : 0);
+    vn.d[0] = v.d[0] << s;
+    un = magnew(u.n + 1);
+    un.d[u.n] = s ? u.d[u.n - 1] >> (32 - s) : 0;
+    for (i = u.n - 1; i > 0; i--)
+        un.d[i] = (u.d[i] << s) | (s ? u.d[i - 1] >> (32 - s) : 0);
+    un.d[0] = u.d[0] << s;
+
+    for (j = m; j >= 0; j--) {
+        uint64_t num = ((uint64_t)un.d[j + n] << 32) | un.d[j + n - 1];
+        uint64_t qhat = num / vn.d[n - 1], rhat = num % vn.d[n - 1];
+        int64_t borrow = 0, t;
+
+        while (qhat > 0xffffffffu ||
+               qhat * vn.d[n - 2] > ((rhat << 32) | un.d[j + n - 2])) {
+            qhat--;
+            rhat += vn.d[n - 1];
+            if (rhat > 0xffffffffu)
+                break;
+        }
+        for (i = 0; i < n; i++) {
+            uint64_t p = qhat * vn.d[i];
+
+            t = un.d[i + j] - borrow - (int64_t)(p & 0xffffffffu);
+            un.d[i + j] = (uint32_t)t;
+            borrow = (int64_t)(p >> 32) - (t >> 32);
+        }
+        t = un.d[j + n] - borrow;
+        un.d[j + n] = (uint32_t)t;
+        q.d[j] = (uint32_t)qhat;
+        if (t < 0) {  // qhat was one too big; add back
+            uint64_t carry = 0;
+
+            q.d[j]--;
+            for (i = 0; i < n; i++) {
+                carry += (uint64_t)un.d[i + j] + vn.d[i];
+                un.d[i + j] = (uint32_t)carry;
+                carry >>= 32;
+            }
+            un.d[j + n] += (uint32_t)carry;
+        }
+    }
+    free(un.d);
+    free(vn.d);
+    return magtrim(q);
+}
+/* arith.c: big integers */
+/*
+ * Big integers are interned in [[bigs]], and a hash table of indices
+ * into [[bigs]] finds the one equal to a new result.  The value of
+ * [[bigs[i]]] is [[smallmin - 1 - i]].  A freed entry has no limbs, and
+ * its [[mag.n]] links it to the next free entry.
+ */
+typedef struct Big {
+    bool negative;
+    bool marked;  // reached from a root since the last sweep
+    int holds;    // holdnumber calls not yet released
+    Mag mag;
+} Big;
+
+static Big *bigs;
+static int nbigs, bigsize;  // bigs[0..nbigs) are in use or free
+static int nlive;           // entries of bigs in use
+static int freebig = -1;    // first free entry, or -1
+static int bigtrigger = 1024;  // nlive that makes numbersgrew true
+static int *bigindex;  // indices into bigs, or -1; size is 2 * bigsize
+static int bigindexsize;
+
+bool numbersgrew;
+
+static unsigned bighash(Big b) {
+    unsigned h = b.negative;
+    int i;
+
+    for (i = 0; i < b.mag.n; i++)
+        h = h * 31 + b.mag.d[i];
+    return h;
+}
+
+static bool bigeq(Big a, Big b) {
+    return a.negative == b.negative && magcmp(a.mag, b.mag) == 0;
+}
+
+static void indexbig(int i) {
+    unsigned h = bighash(bigs[i]) & (bigindexsize - 1);
+
+    while (bigindex[h] >= 0)
+        h = (h + 1) & (bigindexsize - 1);
+    bigindex[h] = i;
+}
+
+static void reindex(int size) {
+    int i;
+
+    if (size != bigindexsize) {
+        bigindexsize = size;
+        free(bigindex);
+        bigindex = malloc(bigindexsize * sizeof(*bigindex));
+        assert(bigindex != NULL);
+    }
+    for (i = 0; i < bigindexsize; i++)
+        bigindex[i] = -1;
+    for (i = 0; i < nbigs; i++)
+        if (bigs[i].mag.d != NULL)
+            indexbig(i);
+}
+
+static Value intern(Big b) {  // takes ownership of b.mag
+    unsigned h;
+    int i;
+
+    if (2 * (nlive + 1) > bigindexsize)
+        reindex(bigindexsize ? 2 * bigindexsize : 256);
+    for (h = bighash(b) & (bigindexsize - 1); bigindex[h] >= 0;
+                                          h = (h + 1) & (bigindexsize - 1))
+        if (bigeq(bigs[bigindex[h]], b)) {
+            free(b.mag.d);
+            return smallmin - 1 - bigindex[h];
+        }
+    if (freebig >= 0) {
+        i = freebig;
+        freebig = bigs[i].mag.n;
+    } else {
+        if (nbigs == bigsize) {
+            bigsize = bigsize ? 2 * bigsize : 128;
+            bigs = realloc(bigs, bigsize * sizeof(*bigs));
+            assert(bigs != NULL);
+        }
+        i = nbigs++;
+    }
+    b.marked = false;
+    b.holds = 0;
+    bigs[i] = b;
+    bigindex[h] = i;
+    if (++nlive >= bigtrigger)
+        numbersgrew = true;
+    return smallmin - 1 - i;
+}
+/* arith.c: freeing big integers */
+/*
+ * Any value may be a handle, so a big integer lives while a root holds
+ * it.  The evaluator's roots are the global variables, the value
+ * stack, and the arrays; when [[numbersgrew]] says that [[nlive]] has
+ * doubled since the last sweep, the evaluator calls [[marknumber]] on
+ * every value in a root and then [[sweepnumbers]].  A big integer that
+ * lives outside those roots, like a literal in the code or a value that
+ * a unit test holds while it evaluates another expression, is held by
+ * [[holdnumber]].  A big integer is interned only between sweeps, so a
+ * value that [[arith]] is working on is never freed.
+ */
+static Big *bigof(Value v) {  // the entry for v, or NULL
+    int i = v < smallmin ? (int)(smallmin - 1 - v) : -1;
+
+    return i >= 0 && i < nbigs && bigs[i].mag.d != NULL ? &bigs[i] : NULL;
+}
+
+void marknumber(Value v) {
+    Big *b = bigof(v);
+
+    if (b != NULL)
+        b->marked = true;
+}
+
+Value holdnumber(Value v) {
+    Big *b = bigof(v);
+
+    if (b != NULL)
+        b->holds++;
+    return v;
+}
+
+void releasenumber(Value v) {
+    Big *b = bigof(v);
+
+    if (b != NULL) {
+        assert(b->holds > 0);
+        b->holds--;
+    }
+}
+
+void sweepnumbers(void) {
+    int i;
+
+    for (i = 0; i < nbigs; i++)
+        if (bigs[i].mag.d != NULL) {
+            if (!bigs[i].marked && bigs[i].holds == 0) {
+                free(bigs[i].mag.d);
+                bigs[i].mag.d = NULL;
+                bigs[i].mag.n = freebig;
+                freebig = i;
+                nlive--;
+            }
+            bigs[i].marked = false;
+        }
+    if (bigindexsize > 0)
+        reindex(bigindexsize);
+    bigtrigger = nlive < 512 ? 1024 : 2 * nlive;
+    numbersgrew = false;
+}
+/*
+ * A small integer becomes a big one in [[buf]], which must hold two
+ * limbs.  A big result becomes a value by [[normalize]], which returns
+ * a small integer if the result fits.
+ */
+static Big tobig(Value v, uint32_t *buf) {
+    Big b;
+    uint64_t u;
+
+    if (v < smallmin)
+        return bigs[smallmin - 1 - v];
+    b.negative = v < 0;
+    u = b.negative ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+    buf[0] = (uint32_t)u;
+    buf[1] = (uint32_t)(u >> 32);
+    b.mag.d = buf;
+    b.mag.n = 2;
+    b.mag = magtrim(b.mag);
+    return b;
+}
+
+static Value normalize(Big b) {  // takes ownership of b.mag
+    if (b.mag.n <= 2) {
+        uint64_t u = b.mag.n == 0 ? 0 : b.mag.n == 1 ? b.mag.d[0]
+                   : (uint64_t)b.mag.d[1] << 32 | b.mag.d[0];
+
+        if (u <= (uint64_t)smallmax || (b.negative && u == (uint64_t)smallmax + 1)) {
+            free(b.mag.d);
+            return b.negative ? (Value)((uint64_t)0 - u) : (Value)u;
+        }
+    }
+    return intern(b);
+}
+
+static Value bigarith(char operation, Big x, Big y) {
+    Big r;
+
+    switch (operation) {
+    case '-':
+        y.negative = !y.negative;
+        /* fall through */
+    case '+':
+        if (x.negative == y.negative) {
+            r.negative = x.negative;
+            r.mag = magadd(x.mag, y.mag);
+        } else if (magcmp(x.mag, y.mag) >= 0) {
+            r.negative = x.negative;
+            r.mag = magsub(x.mag, y.mag);
+        } else {
+            r.negative = y.negative;
+            r.mag = magsub(y.mag, x.mag);
+        }
+        return normalize(r);
+    case '*':
+        r.negative = x.negative != y.negative;
+        r.mag = magmul(x.mag, y.mag);
+        return normalize(r);
+    case '/':
+        r.negative = x.negative != y.negative;
+        r.mag = magdiv(x.mag, y.mag);
+        return normalize(r);
+    default:
+        assert(0);
+        return 0;
+    }
+}
+/* arith.c: arithmetic in every mode */
+Value arith(char operation, Value n, Value m) {
+    Value r;
+    bool overflow;
+    uint32_t nbuf[2], mbuf[2];
+
+    switch (operation) {
+    case '+': overflow = __builtin_add_overflow(n, m, &r); break;
+    case '-': overflow = __builtin_sub_overflow(n, m, &r); break;
+    case '*': overflow = __builtin_mul_overflow(n, m, &r); break;
+    case '/':
+        assert(m != 0);
+        overflow = n == INT64_MIN && m == -1;
+        r = overflow ? 0 : n / m;
+        break;
+    default:
+        assert(0);
+        return 0;
+    }
+    if (n >= smallmin && m >= smallmin && !overflow &&
+                                                r >= smallmin && r <= smallmax)
+        return r;
+    if (arithmetic != ARITHBIG)
+        runerror("Arithmetic overflow");
+    return bigarith(operation, tobig(n, nbuf), tobig(m, mbuf));
+}
+
+int compare(Value n, Value m) {
+    Big x, y;
+    uint32_t nbuf[2], mbuf[2];
+    int c;
+
+    if (n >= smallmin && m >= smallmin)
+        return n < m ? -1 : n > m;
+    x = tobig(n, nbuf);
+    y = tobig(m, mbuf);
+    if (x.negative != y.negative)
+        return x.negative ? -1 : 1;
+    c = magcmp(x.mag, y.mag);
+    return x.negative ? -c : c;
+}
+/* arith.c: reading and printing numbers */
+/*
+ * A numeral is an optional sign followed by digits.  [[readnumber]]
+ * returns false if the integer does not fit in the current mode.
+ */
+bool readnumber(const char *s, Value *vp) {
+    bool negative = *s == '-';
+    const char *digits = s + (*s == '-' || *s == '+'), *p;
+    Value v = 0;  // minus the digits read so far
+    Big b;
+
+    for (p = digits; *p; p++)
+        if (__builtin_mul_overflow(v, 10, &v) ||
+            __builtin_sub_overflow(v, *p - '0', &v) || v < smallmin)
+            break;
+    if (*p == '\0' && (negative || v >= -smallmax)) {
+        *vp = negative ? v : -v;
+        return true;
+    }
+    if (arithmetic != ARITHBIG)
+        return false;
+    b.negative = negative;
+    b.mag = magnew(strlen(digits) / 9 + 1);
+    b.mag.n = 0;
+    for (p = digits; *p; p++) {
+        uint64_t carry = *p - '0';
+        int i;
+
+        for (i = 0; i < b.mag.n; i++) {
+            carry += (uint64_t)b.mag.d[i] * 10;
+            b.mag.d[i] = (uint32_t)carry;
+            carry >>= 32;
+        }
+        if (carry != 0)
+            b.mag.d[b.mag.n++] = (uint32_t)carry;
+    }
+    *vp = normalize(b);
+    return true;
+}
+
+void printnumber(Printbuf output, Value v) {
+    Big b;
+    Mag q;
+    char *digits, *p;
+    int ndigits;
+    uint32_t buf[2];
+
+    if (v >= smallmin) {
+        char small[24];
+
+        snprintf(small, sizeof(small), "%" PRId64, v);
+        bprint(output, "%s", small);
+        return;
+    }
+    b = tobig(v, buf);
+    q = magnew(b.mag.n);
+    memcpy(q.d, b.mag.d, b.mag.n * sizeof(*q.d));
+    ndigits = 10 * b.mag.n + 2;
+    digits = malloc(ndigits);
+    assert(digits != NULL);
+    p = digits + ndigits - 1;
+    *p = '\0';
+    while (q.n > 0) {  // nine digits at a time
+        uint32_t chunk = shortdiv(q, q, 1000000000);
+        int i;
+
+        q = magtrim(q);
+        for (i = 0; i < 9 && (q.n > 0 || chunk != 0); i++) {
+            *--p = '0' + chunk % 10;
+            chunk /= 10;
+        }
+    }
+    if (b.negative)
+        *--p = '-';
+    bprint(output, "%s", p);
+    free(digits);
+    free(q.d);
 }
@@ -0,0 +1,53 @@
+#include "all.h"
+/* array.c: arrays */
+/*
+ * An array is a fixed number of integers, stored contiguously.  Since
+ * every Impcore value is an integer, an array is named by a number, as
+ * a file is named by a descriptor: [[make-array]] returns the number of
+ * a new array, and a program keeps that number in a variable.  Arrays
+ * are numbered from 1, so every array is true, and they are never
+ * freed.
+ */
+Array *arrays;
+int narrays;
+static int maxarrays;  // arrays[0..maxarrays) are allocated
+
+Value mkarray(Exp e, Value size, Value init) {
+    Value *elems = NULL;
+    int i;
+
+    if (size >= 0 && size <= INT_MAX / (int) sizeof(*elems))
+        elems = malloc(size > 0 ? size * sizeof(*elems) : 1);
+    if (elems == NULL)
+        runerror("in %e, cannot make an array of size %v", e, size);
+    for (i = 0; i < size; i++)
+        elems[i] = init;
+    if (narrays + 1 >= maxarrays) {
+        maxarrays = maxarrays ? 2 * maxarrays : 64;
+        arrays = realloc(arrays, maxarrays * sizeof(*arrays));
+        assert(arrays != NULL);
+    }
+    narrays++;
+    arrays[narrays].elems = elems;
+    arrays[narrays].size  = size;
+    return narrays;
+}
+
+static Array *findarray(Exp e, Value a) {
+    if (a < 1 || a > narrays)
+        runerror("in %e, %v is not an array", e, a);
+    return &arrays[a];
+}
+
+Value *arrayelem(Exp e, Value a, Value i) {
+    Array *array = findarray(e, a);
+
+    if (i < 0 || i >= array->size)
+        runerror("in %e, index %v is out of bounds for an array of size %d",
+                                                           e, i, array->size);
+    return &array->elems[i];
+}
+
+Value arraysize(Exp e, Value a) {
+    return findarray(e, a)->size;
+}
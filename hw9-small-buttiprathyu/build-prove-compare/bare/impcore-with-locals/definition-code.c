@@ -5,6 +5,10 @@ Userfun mkUserfun(Namelist formals, Namelist locals, Exp body) {
     n.formals = formals;
     n.locals = locals;
     n.body = body;
+    n.code = NULL;
+    n.nformals = lengthNL(formals);
+    n.nlocals = lengthNL(locals);
+    bindslots(body, formals, locals);
     return n;
 }
 
@@ -1,9 +1,67 @@
 #include "all.h"
+#include <stdint.h>
+/* env.c: indexes */
+/*
+ * An environment that grows by [[bindval]] or [[bindfun]] holds the
+ * globals or the functions, and it may grow large, so it keeps an
+ * index: a hash table from each name to the list cell that holds the
+ * name's value.  Cells never move, and binding a name that is already
+ * bound overwrites its cell, so a pointer to a cell is a stable slot.
+ * Environments of formal parameters never grow, and they are searched
+ * as lists.
+ */
+typedef struct Index {
+    Name *names;
+    void **slots;
+    unsigned size, used;     // size is a power of 2
+} *Index;
+
+static void *indexfind(Index ix, Name x) {
+    unsigned i;
+
+    for (i = ((uintptr_t)x >> 4) & (ix->size - 1); ix->names[i] != NULL;
+         i = (i + 1) & (ix->size - 1))
+        if (ix->names[i] == x)
+            return ix->slots[i];
+    return NULL;
+}
+
+static Index indexadd(Index ix, Name x, void *slot) {  // x is not in ix
+    unsigned i;
+
+    if (ix == NULL) {
+        ix = calloc(1, sizeof(*ix));
+        assert(ix != NULL);
+    }
+    if (2 * (ix->used + 1) > ix->size) {  // grow and rehash
+        Name *names = ix->names;
+        void **slots = ix->slots;
+        unsigned j, n = ix->size;
+        ix->size  = n ? 2 * n : 64;
+        ix->names = calloc(ix->size, sizeof(*ix->names));
+        ix->slots = calloc(ix->size, sizeof(*ix->slots));
+        assert(ix->names && ix->slots);
+        ix->used = 0;
+        for (j = 0; j < n; j++)
+            if (names[j] != NULL)
+                indexadd(ix, names[j], slots[j]);
+        free(names);
+        free(slots);
+    }
+    for (i = ((uintptr_t)x >> 4) & (ix->size - 1); ix->names[i] != NULL;
+         i = (i + 1) & (ix->size - 1))
+        ;
+    ix->names[i] = x;
+    ix->slots[i] = slot;
+    ix->used++;
+    return ix;
+}
 /* env.c 57b */
 struct Valenv {
     Namelist  xs;
     Valuelist vs;
     // invariant: lists have the same length
+    Index index;  // NULL, or indexes every name in xs
 };
 /* env.c 57c */
 Valenv mkValenv(Namelist xs, Valuelist vs) {
@@ -12,13 +70,16 @@ Valenv mkValenv(Namelist xs, Valuelist vs) {
     assert(lengthNL(xs) == lengthVL(vs));
     e->xs = xs;
     e->vs = vs;
+    e->index = NULL;
     return e;
 }
 /* env.c 58a */
-static Value* findval(Name x, Valenv env) {
+Value* findval(Name x, Valenv env) {
     Namelist  xs;
     Valuelist vs;
 
+    if (env->index)
+        return indexfind(env->index, x);
     for (xs=env->xs, vs=env->vs; xs && vs; xs=xs->tl, vs=vs->tl)
         if (x == xs->hd)
             return &vs->hd;
@@ -42,13 +103,29 @@ void bindval(Name name, Value val, Valenv env) {
     else {
         env->xs = mkNL(name, env->xs);
         env->vs = mkVL(val,  env->vs);
+        if (env->index)
+            env->index = indexadd(env->index, name, &env->vs->hd);
+        else {
+            Namelist  xs;
+            Valuelist vs;
+            for (xs = env->xs, vs = env->vs; xs && vs; xs = xs->tl, vs = vs->tl)
+                env->index = indexadd(env->index, xs->hd, &vs->hd);
+        }
     }
 }
+/*
+ * In bignum mode, the globals are roots of the big integers.
+ */
+void markvalenv(Valenv env) {
+    for (Valuelist vs = env->vs; vs; vs = vs->tl)
+        marknumber(vs->hd);
+}
 /* env.c S143b */
 struct Funenv {
     Namelist xs;
     Funlist funs;
     // invariant: both lists are the same length
+    Index index;  // NULL, or indexes every name in xs
 };
 /* env.c S143c */
 Funenv mkFunenv(Namelist xs, Funlist funs) {
@@ -57,13 +134,16 @@ Funenv mkFunenv(Namelist xs, Funlist funs) {
     assert(lengthNL(xs) == lengthFL(funs));
     env->xs = xs;
     env->funs = funs;
+    env->index = NULL;
     return env;
 }
 /* env.c S143d */
-static Fun* findfun(Name name, Funenv env) {
+Fun* findfun(Name name, Funenv env) {
     Namelist xs  = env->xs;
     Funlist funs = env->funs;
 
+    if (env->index)
+        return indexfind(env->index, name);
     for ( ; xs && funs; xs = xs->tl, funs = funs->tl)
         if (name == xs->hd)
             return &funs->hd;
@@ -87,6 +167,15 @@ void bindfun(Name name, Fun fun, Funenv env) {
     else {
         env->xs   = mkNL(name, env->xs);
         env->funs = mkFL(fun,  env->funs);
+        if (env->index)
+            env->index = indexadd(env->index, name, &env->funs->hd);
+        else {
+            Namelist xs;
+            Funlist funs;
+            for (xs = env->xs, funs = env->funs; xs && funs;
+                 xs = xs->tl, funs = funs->tl)
+                env->index = indexadd(env->index, xs->hd, &funs->hd);
+        }
     }
 }
 /* env.c S144b */
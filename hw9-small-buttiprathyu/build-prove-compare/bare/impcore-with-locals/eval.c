@@ -1,148 +1,199 @@
 #include "all.h"
 /* eval.c 48c */
-static Valuelist evallist(Explist es, Valenv globals, Funenv functions, Valenv
-                                                                       formals);
+static Value evalframe(Exp e, Valenv globals, Funenv functions, int fp);
+static int   evalactuals(Explist es, Valenv globals, Funenv functions, int fp);
+static Value applyprimitive(Exp e, Primop op, Value *args, int n);
+static bool  usebytecode(void);
+static Value runtoplevel(Exp e, Valenv globals, Funenv functions);
+static Exp   funbody(Userfun *f, Funenv functions, int *nlocals);
+/* eval.c: the value stack */
+/*
+ * The actual parameters of every active call live on one value stack.
+ * A call pushes its actuals, then room for the function's locals and
+ * for any slots that the optimizer adds, all zero, and the whole
+ * becomes the activation record of the function's body; the call pops
+ * it when the body returns.  A formal or local is found by its index in
+ * the record, which [[bindslots]] computes when the function is parsed.
+ * Records are named by their offsets, so the stack may move when it
+ * grows.  An error abandons
+ * every active call, so each top-level evaluation starts with an empty
+ * stack.
+ */
+static Value *stack;
+static int sp, stacksize;  // stack[0..sp) holds the active records
+
+static void reserve(int n) {  // make room for stack[0..n)
+    if (n > stacksize) {
+        int old = stacksize;
+
+        while (stacksize < n)
+            stacksize = stacksize ? 2 * stacksize : 1024;
+        stack = realloc(stack, stacksize * sizeof(*stack));
+        assert(stack != NULL);
+        memset(stack + old, 0, (stacksize - old) * sizeof(*stack));
+    }
+}
+
+static void push(Value v) {
+    if (sp == stacksize)
+        reserve(sp + 1);
+    stack[sp++] = v;
+}
+/* eval.c: freeing big integers */
+/*
+ * In bignum mode, [[collect]] frees the big integers that no global,
+ * array, or stack slot holds.  The bytecode keeps no stack pointer, so
+ * the whole stack is marked; a slot above the active records holds
+ * only a stale value, which at worst keeps a dead number until the
+ * next collection.  The evaluator collects at the start of each
+ * top-level evaluation, on each call of a user function, and on each
+ * iteration of a loop, where every live value is in a root.
+ */
+static void collect(Valenv globals) {
+    int i, j;
+
+    for (i = 0; i < stacksize; i++)
+        marknumber(stack[i]);
+    for (i = 1; i <= narrays; i++)
+        for (j = 0; j < arrays[i].size; j++)
+            marknumber(arrays[i].elems[j]);
+    markvalenv(globals);
+    sweepnumbers();
+}
+/* eval.c: global slots */
+/*
+ * The first time a global variable or a function call is evaluated,
+ * [[eval]] finds the slot that holds the name's value and keeps it in
+ * the expression, so later evaluations skip the lookup.  A slot is
+ * kept once the name is bound, and binding again updates the slot in
+ * place.  An expression is always evaluated with the same [[globals]]
+ * and [[functions]], so a kept slot stays right.
+ */
+static Value *globalslot(Exp e, Name x, Valenv globals) {
+    if (e->slot.val == NULL)
+        e->slot.val = findval(x, globals);
+    return e->slot.val;
+}
+
+static Fun *funslot(Exp e, Funenv functions) {
+    if (e->slot.fun == NULL)
+        e->slot.fun = findfun(e->u.apply.name, functions);
+    return e->slot.fun;
+}
 /* eval.c 49a */
-Value eval(Exp e, Valenv globals, Funenv functions, Valenv formals) {
+Value eval(Exp e, Valenv globals, Funenv functions) {
+    sp = 0;
+    if (profiling)
+        profunwind();  // calls abandoned by an error
+    if (numbersgrew)
+        collect(globals);
+    if (usebytecode())
+        return runtoplevel(e, globals, functions);
+    return evalframe(e, globals, functions, 0);
+}
+
+static Value evalframe(Exp e, Valenv globals, Funenv functions, int fp) {
     checkoverflow(1000000 * sizeof(char *));
                                         // see last section of Appendix A (OMIT)
+    if (profiling)
+        profsteps++;
     switch (e->alt) {
     case LITERAL:
         /* evaluate [[e->u.literal]] and return the result 49b */
         return e->u.literal;
     case VAR:
         /* evaluate [[e->u.var]] and return the result 50a */
-        if (isvalbound(e->u.var, formals))
-            return fetchval(e->u.var, formals);
-        else if (isvalbound(e->u.var, globals))
-            return fetchval(e->u.var, globals);
-        else
-            runerror("unbound variable %n", e->u.var);
-        assert(0);   // not reached, but the compiler can't know
+        if (e->index >= 0)
+            return stack[fp + e->index];
+        else {
+            Value *vp = globalslot(e, e->u.var, globals);
+
+            if (vp == NULL)
+                runerror("unbound variable %n", e->u.var);
+            return *vp;
+        }
     case SET:
         /* evaluate [[e->u.set]] and return the result 50b */
         {
-            Value v = eval(e->u.set.exp, globals, functions, formals);
+            Value v = evalframe(e->u.set.exp, globals, functions, fp);
+            Value *vp = e->index >= 0 ? &stack[fp + e->index]
+                                       : globalslot(e, e->u.set.name, globals);
 
-            if (isvalbound(e->u.set.name, formals))
-                bindval(e->u.set.name, v, formals);
-            else if (isvalbound(e->u.set.name, globals))
-                bindval(e->u.set.name, v, globals);
-            else
+            if (vp == NULL)
                 runerror("tried to set unbound variable %n in %e", e->u.set.name
                                                                            , e);
+            *vp = v;
             return v;
         }
     case IFX:
         /* evaluate [[e->u.ifx]] and return the result 51a */
-        if (eval(e->u.ifx.cond, globals, functions, formals) != 0)
-            return eval(e->u.ifx.truex, globals, functions, formals);
+        if (evalframe(e->u.ifx.cond, globals, functions, fp) != 0)
+            return evalframe(e->u.ifx.truex, globals, functions, fp);
         else
-            return eval(e->u.ifx.falsex, globals, functions, formals);
+            return evalframe(e->u.ifx.falsex, globals, functions, fp);
     case WHILEX:
         /* evaluate [[e->u.whilex]] and return the result 51b */
-        while (eval(e->u.whilex.cond, globals, functions, formals) != 0)
-            eval(e->u.whilex.exp, globals, functions, formals);
+        while (evalframe(e->u.whilex.cond, globals, functions, fp) != 0) {
+            evalframe(e->u.whilex.exp, globals, functions, fp);
+            if (numbersgrew)
+                collect(globals);
+        }
         return 0;
     case BEGIN:
         /* evaluate [[e->u.begin]] and return the result 52a */
         {
             Value lastval = 0;
             for (Explist es = e->u.begin; es; es = es->tl)
-                lastval = eval(es->hd, globals, functions, formals);
+                lastval = evalframe(es->hd, globals, functions, fp);
             return lastval;
         }
     case APPLY:
         /* evaluate [[e->u.apply]] and return the result 52b */
         {
-            Fun f;
+            Fun *f;
+            int args, n;
 
 /* make [[f]] the function denoted by [[e->u.apply.name]], or call [[runerror]] 52c */
-            if (!isfunbound(e->u.apply.name, functions))
-                runerror("call to undefined function %n in %e", e->u.apply.name,
-                                                                             e);
-            f = fetchfun(e->u.apply.name, functions);
-            switch (f.alt) {
+            f = funslot(e, functions);
+            if (f == NULL)
+                runerror("call to undefined function %n in %e",
+                                                        e->u.apply.name, e);
+            args = sp;
+            n = evalactuals(e->u.apply.actuals, globals, functions, fp);
+            switch (f->alt) {
             case USERDEF:
-                /* apply [[f.u.userdef]] and return the result 53b */
+                /* apply [[f->u.userdef]] and return the result 53b */
                 {
-                    Namelist  xs = f.u.userdef.formals;
-                    Valuelist vs = evallist(e->u.apply.actuals, globals,
-                                                            functions, formals);
-                    checkargc(e, lengthNL(xs), lengthVL(vs));
-                    return eval(f.u.userdef.body, globals, functions, mkValenv(
-                                                                       xs, vs));
+                    int nlocals;
+                    Exp body = funbody(&f->u.userdef, functions, &nlocals);
+                    Value v;
+
+                    checkargc(e, f->u.userdef.nformals, n);
+                    reserve(sp + nlocals);
+                    memset(stack + sp, 0, nlocals * sizeof(*stack));
+                    sp += nlocals;
+                    if (numbersgrew)
+                        collect(globals);
+                    if (profiling)
+                        profenter(e->u.apply.name);
+                    v = evalframe(body, globals, functions, args);
+                    if (profiling)
+                        profexit();
+                    sp = args;
+                    return v;
                 }
             case PRIMITIVE:
-                /* apply [[f.u.primitive]] and return the result 54a */
-                {
-                    Valuelist vs = evallist(e->u.apply.actuals, globals,
-                                                            functions, formals);
-                    if (f.u.primitive == strtoname("print"))
-
-              /* apply \impcore\ primitive [[print]] to [[vs]] and return 54b */
-                        {
-                            checkargc(e, 1, lengthVL(vs));
-                            Value v = nthVL(vs, 0);
-                            print("%v", v);
-                            return v;
-                        }
-                    else if (f.u.primitive == strtoname("println"))
-
-          /* apply \impcore\ primitive [[println]] to [[vs]] and return S142d */
-                        {
-                            checkargc(e, 1, lengthVL(vs));
-                            Value v = nthVL(vs, 0);
-                            print("%v\n", v);
-                            return v;
-                        }
-                    else if (f.u.primitive == strtoname("printu"))
-
-           /* apply \impcore\ primitive [[printu]] to [[vs]] and return S143a */
-                        {
-                            checkargc(e, 1, lengthVL(vs));
-                            Value v = nthVL(vs, 0);
-                            print_utf8(v);
-                            return v;
-                        }
-                    else
-
-                       /* apply arithmetic primitive to [[vs]] and return 55a */
-                        {
-                            const char *s = nametostr(f.u.primitive);
-                            Value v, w;
-
-/* check that [[vs]] has exactly two values, and assign them to [[v]] and [[w]] 55c */
-                            checkargc(e, 2, lengthVL(vs));
-                            v = nthVL(vs, 0);
-                            w = nthVL(vs, 1);
-
-/* if operation [[s]] would overflow on [[v]] and [[w]], call [[runerror]] 55b */
-                            checkarith(s[0], v, w, 32);
-                            assert(strlen(s) == 1);
-
-                            switch (s[0]) {
-                            case '<':
-                                return v < w;
-                            case '>':
-                                return v > w;
-                            case '=':
-                                return v == w;
-                            case '+':
-                                return v + w;
-                            case '-':
-                                return v - w;
-                            case '*':
-                                return v * w;
-                            case '/':
-                                if (w == 0)
-                                    runerror("division by zero in %e", e);
-                                return v / w;
-                            default:
-                                assert(0);
-                            }
-                        }
+                /* apply [[f->u.primitive]] and return the result 54a */
+                sp = args;  // the actuals stay in stack[args..args+n)
+                if (profiling) {
+                    Value v;
+
+                    profenter(e->u.apply.name);
+                    v = applyprimitive(e, f->u.primitive.op, stack + args, n);
+                    profexit();
+                    return v;
                 }
+                return applyprimitive(e, f->u.primitive.op, stack + args, n);
             default:
                 assert(0);
             }
@@ -151,14 +202,900 @@ Value eval(Exp e, Valenv globals, Funenv functions, Valenv formals) {
     assert(0);
 }
 /* eval.c 53a */
-static Valuelist evallist(Explist es, Valenv globals, Funenv functions, Valenv
-                                                                      formals) {
-    if (es == NULL) {
-        return NULL;
+static int evalactuals(Explist es, Valenv globals, Funenv functions, int fp) {
+    int n = 0;
+
+    for ( ; es; es = es->tl, n++)
+        push(evalframe(es->hd, globals, functions, fp));
+    return n;
+}
+/*
+ * A primitive is applied to the [[n]] values at [[args]].
+ */
+static Value applyprimitive(Exp e, Primop op, Value *args, int n) {
+    Value v, w;
+
+    switch (op) {
+    case PRINT:
+        /* apply \impcore\ primitive [[print]] to [[vs]] and return 54b */
+        checkargc(e, 1, n);
+        v = args[0];
+        print("%v", v);
+        return v;
+    case PRINTLN:
+        /* apply \impcore\ primitive [[println]] to [[vs]] and return S142d */
+        checkargc(e, 1, n);
+        v = args[0];
+        print("%v\n", v);
+        return v;
+    case PRINTU:
+        /* apply \impcore\ primitive [[printu]] to [[vs]] and return S143a */
+        checkargc(e, 1, n);
+        v = args[0];
+        if (v < INT32_MIN || v > INT32_MAX)
+            runerror("%v does not represent a Unicode code point", v);
+        print_utf8(v);
+        return v;
+    case MKARRAY:
+        checkargc(e, 2, n);
+        return mkarray(e, args[0], args[1]);
+    case ARRAYAT:
+        checkargc(e, 2, n);
+        return *arrayelem(e, args[0], args[1]);
+    case ARRAYPUT:
+        checkargc(e, 3, n);
+        return *arrayelem(e, args[0], args[1]) = args[2];
+    case ARRAYSIZE:
+        checkargc(e, 1, n);
+        return arraysize(e, args[0]);
+    default:
+        break;
+    }
+
+    /* apply arithmetic primitive to [[vs]] and return 55a */
+    /* check that [[vs]] has exactly two values, and assign them to [[v]] and [[w]] 55c */
+    checkargc(e, 2, n);
+    v = args[0];
+    w = args[1];
+    switch (op) {
+    case LT:
+        return compare(v, w) < 0;
+    case GT:
+        return compare(v, w) > 0;
+    case EQ:
+        return v == w;
+    case ADD:
+        return arith('+', v, w);
+    case SUB:
+        return arith('-', v, w);
+    case MUL:
+        return arith('*', v, w);
+    case DIV:
+        if (w == 0)
+            runerror("division by zero in %e", e);
+        return arith('/', v, w);
+    default:
+        assert(0);
+    }
+}
+/* eval.c: resolving formals and locals */
+/*
+ * When a function is parsed, each variable in its body that names a
+ * formal or a local is given that variable's index in the activation
+ * record: the formals come first, then the locals.  A local hides a
+ * formal of the same name.
+ */
+static int slotindex(Name x, Namelist formals, Namelist locals) {
+    int i;
+
+    for (i = lengthNL(formals); locals; locals = locals->tl, i++)
+        if (locals->hd == x)
+            return i;
+    for (i = 0; formals; formals = formals->tl, i++)
+        if (formals->hd == x)
+            return i;
+    return -1;
+}
+
+void bindslots(Exp e, Namelist formals, Namelist locals) {
+    switch (e->alt) {
+    case LITERAL:
+        return;
+    case VAR:
+        e->index = slotindex(e->u.var, formals, locals);
+        return;
+    case SET:
+        e->index = slotindex(e->u.set.name, formals, locals);
+        bindslots(e->u.set.exp, formals, locals);
+        return;
+    case IFX:
+        bindslots(e->u.ifx.cond, formals, locals);
+        bindslots(e->u.ifx.truex, formals, locals);
+        bindslots(e->u.ifx.falsex, formals, locals);
+        return;
+    case WHILEX:
+        bindslots(e->u.whilex.cond, formals, locals);
+        bindslots(e->u.whilex.exp, formals, locals);
+        return;
+    case BEGIN:
+        for (Explist es = e->u.begin; es; es = es->tl)
+            bindslots(es->hd, formals, locals);
+        return;
+    case APPLY:
+        for (Explist es = e->u.apply.actuals; es; es = es->tl)
+            bindslots(es->hd, formals, locals);
+        return;
+    }
+    assert(0);
+}
+/* eval.c: the bytecode machine */
+/*
+ * Unless [[BPCOPTIONS]] holds [[nobytecode]], [[eval]] does not walk
+ * the tree.  It compiles the expression to instructions for a register
+ * machine and runs them, and a function's body is compiled the first
+ * time the function is called.  A function's registers are its
+ * activation record on the value stack: first the formals, then the
+ * locals, then temporaries.  The actuals of a call are computed into registers at
+ * the top of the caller's record, and they become the formals of the
+ * callee's record, so a call copies nothing.
+ *
+ * Arithmetic, comparison, and array primitives are done inline, and a
+ * comparison that decides an [[if]] or [[while]] is fused with its
+ * branch.  Which names denote primitives is settled at compile time, so
+ * redefining a primitive makes compiled code stale, as does redefining
+ * a function that the optimizer may have inlined.  Code remembers the
+ * [[generation]] it was made in, and stale code is optimized and
+ * compiled again the next time it is called.  Other calls go through the slot of the
+ * call's expression, which the instruction keeps, as does every
+ * instruction that can fail, so error messages are the tree walker's.
+ *
+ * The machine burns a unit of fuel on each call and each trip around a
+ * loop, not on each expression, so a throttled program runs longer
+ * before it exhausts its CPU time.
+ */
+typedef enum Opcode {
+    LOADK, MOVE, GETGLOBAL, SETGLOBAL,
+    IADD, ISUB, IMUL, IDIV, ILT, IGT, IEQ,
+    JUMP, LOOP, JFALSE, JNLT, JNGT, JNEQ,
+    CHECKFUN, CALL, RETURN,
+    AGET, AGETU, APUT, APUTU, ASIZE, GUARDARRAY, GUARDBOUND
+} Opcode;
+
+typedef struct Instruction {
+    Opcode op;
+    int a, b, c;  // registers, or in [[c]], the target of a jump
+    Value k;      // a constant, for LOADK
+    Exp e;        // the source, for its slot and for error messages
+} Instruction;
+
+struct Code {
+    Name name;                     // of the function
+    Exp body;                      // optimized, or NULL until optimized
+    Instruction *instrs;           // compiled from body, if ninstrs > 0
+    int ninstrs, size;
+    int nformals, nlocals, nregs;  // registers [0..nformals) hold the
+                                   // actuals, and the locals follow
+    int generation;
+};
+
+static int generation;  // advanced each time a primitive, or a function
+                        // that may have been inlined, is redefined
+
+static bool usebytecode(void) {
+    static int use = -1;
+
+    if (use < 0) {
+        const char *options = getenv("BPCOPTIONS");
+        use = options == NULL || strstr(options, "nobytecode") == NULL;
+    }
+    return use;
+}
+/* eval.c: compiling to bytecode */
+/*
+ * Registers are allocated like a stack: [[next]] is the first free
+ * register, and each expression frees the temporaries it allocates.
+ * A result is compiled into a temporary, never straight into a formal
+ * or local, because the expression may read that variable after writing
+ * its target.  An operand that is a formal or local is read in place,
+ * unless an operand computed after it may set it.
+ */
+#define MAXSAFE 16
+
+typedef struct Compiler {
+    Code code;
+    int next;
+    Funenv functions;
+    struct { int array, index; } safe[MAXSAFE];  // variables known to be
+    int nsafe;                                    // an array and an index in it
+} Compiler;
+
+static void compileexp(Compiler *c, Exp e, int target);
+
+static int emit(Compiler *c, Opcode op, int a, int b, int cc, Exp e) {
+    Code code = c->code;
+
+    if (code->ninstrs == code->size) {
+        code->size = code->size ? 2 * code->size : 32;
+        code->instrs = realloc(code->instrs, code->size * sizeof(*code->instrs));
+        assert(code->instrs != NULL);
+    }
+    code->instrs[code->ninstrs] = (Instruction) { op, a, b, cc, 0, e };
+    return code->ninstrs++;
+}
+
+static void loadk(Compiler *c, int target, Value k) {
+    int i = emit(c, LOADK, target, 0, 0, NULL);
+
+    c->code->instrs[i].k = k;
+}
+
+static void patch(Compiler *c, int jump) {  // jump to the next instruction
+    c->code->instrs[jump].c = c->code->ninstrs;
+}
+
+static int newreg(Compiler *c) {
+    if (++c->next > c->code->nregs)
+        c->code->nregs = c->next;
+    return c->next - 1;
+}
+
+static bool sets(Exp e, int x) {  // does e set slot x?
+    switch (e->alt) {
+    case LITERAL:
+    case VAR:
+        return false;
+    case SET:
+        return e->index == x || sets(e->u.set.exp, x);
+    case IFX:
+        return sets(e->u.ifx.cond, x) || sets(e->u.ifx.truex, x) ||
+               sets(e->u.ifx.falsex, x);
+    case WHILEX:
+        return sets(e->u.whilex.cond, x) || sets(e->u.whilex.exp, x);
+    case BEGIN:
+        for (Explist es = e->u.begin; es; es = es->tl)
+            if (sets(es->hd, x))
+                return true;
+        return false;
+    case APPLY:
+        for (Explist es = e->u.apply.actuals; es; es = es->tl)
+            if (sets(es->hd, x))
+                return true;
+        return false;
+    }
+    assert(0);
+    return false;
+}
+
+static bool setsany(Explist es, int x) {
+    for ( ; es; es = es->tl)
+        if (sets(es->hd, x))
+            return true;
+    return false;
+}
+
+static int operand(Compiler *c, Exp e, Explist later) {
+    int r;
+
+    if (e->alt == VAR && e->index >= 0 && !setsany(later, e->index))
+        return e->index;
+    r = newreg(c);
+    compileexp(c, e, r);
+    return r;
+}
+/*
+ * A call to a primitive with the right number of arguments is done
+ * inline, unless the primitive prints or makes an array, or unless the
+ * profiler is on; then every call is made by [[CALL]], which tells the
+ * profiler.
+ */
+static int inlineop(Exp e, Funenv functions) {  // an opcode, or -1
+    Fun *f;
+    int n;
+
+    if (e->alt != APPLY || profiling)
+        return -1;
+    f = funslot(e, functions);
+    if (f == NULL || f->alt != PRIMITIVE)
+        return -1;
+    n = lengthEL(e->u.apply.actuals);
+    switch (f->u.primitive.op) {
+    case ADD:       return n == 2 ? IADD  : -1;
+    case SUB:       return n == 2 ? ISUB  : -1;
+    case MUL:       return n == 2 ? IMUL  : -1;
+    case DIV:       return n == 2 ? IDIV  : -1;
+    case LT:        return n == 2 ? ILT   : -1;
+    case GT:        return n == 2 ? IGT   : -1;
+    case EQ:        return n == 2 ? IEQ   : -1;
+    case ARRAYAT:   return n == 2 ? AGET  : -1;
+    case ARRAYPUT:  return n == 3 ? APUT  : -1;
+    case ARRAYSIZE: return n == 1 ? ASIZE : -1;
+    default:        return -1;
+    }
+}
+
+static int compilecond(Compiler *c, Exp cond) {  // the jump taken if false
+    int jump, save = c->next, op = inlineop(cond, c->functions);
+
+    if (op == ILT || op == IGT || op == IEQ) {
+        Exp x = cond->u.apply.actuals->hd;
+        Exp y = cond->u.apply.actuals->tl->hd;
+        int rx = operand(c, x, cond->u.apply.actuals->tl);
+        int ry = operand(c, y, NULL);
+
+        jump = emit(c, op == ILT ? JNLT : op == IGT ? JNGT : JNEQ, rx, ry, 0,
+                                                                          cond);
     } else {
-        Value v = eval(es->hd, globals, functions, formals);
-        return mkVL(v, evallist(es->tl, globals, functions, formals));
+        int r = newreg(c);
+
+        compileexp(c, cond, r);
+        jump = emit(c, JFALSE, r, 0, 0, cond);
+    }
+    c->next = save;
+    return jump;
+}
+
+static bool safe(Compiler *c, Exp a, Exp i) {
+    int k;
+
+    if (a->alt != VAR || a->index < 0 || i->alt != VAR || i->index < 0)
+        return false;
+    for (k = 0; k < c->nsafe; k++)
+        if (c->safe[k].array == a->index && c->safe[k].index == i->index)
+            return true;
+    return false;
+}
+
+static void compilearray(Compiler *c, Exp e, Opcode op, int target) {
+    Explist es = e->u.apply.actuals;
+    int ra = operand(c, es->hd, es->tl);
+    int ri = operand(c, es->tl->hd, es->tl->tl);
+
+    if (op == APUT)
+        compileexp(c, es->tl->tl->hd, target);
+    if (safe(c, es->hd, es->tl->hd))
+        op = op == AGET ? AGETU : APUTU;
+    emit(c, op, target, ra, ri, e);
+}
+/*
+ * Bounds checks are hoisted out of a loop of the form
+ *
+ *   (while (< i n) (begin ... (set i (+ i k))))
+ *
+ * in which [[i]] is a formal or local that only the last expression of
+ * the body sets, [[k]] is a literal that is not negative, and [[n]] is
+ * a literal, a formal or local that the body doesn't set, or
+ * [[(array-size x)]] for such a variable [[x]].  Until the last
+ * expression of the body, [[i]] lies in [[i0..n)]], where [[i0]] is its
+ * value when the loop starts.  So if [[i0]] is not negative, and [[n]]
+ * is at most the size of array [[a]], a formal or local that the body
+ * doesn't set, then
+ * [[(array-at a i)]] and [[(array-put a i v)]] need no checks.
+ *
+ * Such a loop is compiled twice.  Guards before the first copy test
+ * [[i0]] and [[n]] against each array, and if any test fails, control
+ * goes to the second copy, in which every access is checked.
+ */
+static bool steps(Exp e, Exp i, Funenv functions) {  // (set i (+ i k))?
+    Exp sum, x, k;
+
+    if (e->alt != SET || e->index != i->index)
+        return false;
+    sum = e->u.set.exp;
+    if (inlineop(sum, functions) != IADD)
+        return false;
+    x = sum->u.apply.actuals->hd;
+    k = sum->u.apply.actuals->tl->hd;
+    return x->alt == VAR && x->index == i->index &&
+           k->alt == LITERAL && k->u.literal >= 0;
+}
+
+static bool hoistable(Compiler *c, Exp loop, Exp *ip, Exp *np) {
+    Exp cond = loop->u.whilex.cond, body = loop->u.whilex.exp, i, n;
+    Explist es;
+
+    if (inlineop(cond, c->functions) != ILT)
+        return false;
+    i = *ip = cond->u.apply.actuals->hd;
+    n = *np = cond->u.apply.actuals->tl->hd;
+    if (i->alt != VAR || i->index < 0 || body->alt != BEGIN ||
+                                          body->u.begin == NULL)
+        return false;
+    for (es = body->u.begin; es->tl; es = es->tl)
+        if (sets(es->hd, i->index))
+            return false;
+    if (!steps(es->hd, i, c->functions))
+        return false;
+    if (inlineop(n, c->functions) == ASIZE)
+        n = n->u.apply.actuals->hd;
+    else if (n->alt == LITERAL)
+        return true;
+    return n->alt == VAR && n->index >= 0 && !sets(body, n->index);
+}
+
+static int findarrays(Compiler *c, Exp e, Exp i, Exp body, int *arrays,
+                                                                       int n) {
+    Explist es;
+    int k;
+
+    switch (e->alt) {
+    case LITERAL:
+    case VAR:
+        return n;
+    case SET:
+        return findarrays(c, e->u.set.exp, i, body, arrays, n);
+    case IFX:
+        n = findarrays(c, e->u.ifx.cond, i, body, arrays, n);
+        n = findarrays(c, e->u.ifx.truex, i, body, arrays, n);
+        return findarrays(c, e->u.ifx.falsex, i, body, arrays, n);
+    case WHILEX:
+        n = findarrays(c, e->u.whilex.cond, i, body, arrays, n);
+        return findarrays(c, e->u.whilex.exp, i, body, arrays, n);
+    case BEGIN:
+        for (es = e->u.begin; es; es = es->tl)
+            n = findarrays(c, es->hd, i, body, arrays, n);
+        return n;
+    case APPLY:
+        es = e->u.apply.actuals;
+        k = inlineop(e, c->functions);
+        if ((k == AGET || k == APUT) && es->hd->alt == VAR &&
+            es->hd->index >= 0 && !sets(body, es->hd->index) &&
+            es->tl->hd->alt == VAR && es->tl->hd->index == i->index) {
+            for (k = 0; k < n && arrays[k] != es->hd->index; k++)
+                ;
+            if (k == n && n < MAXSAFE)
+                arrays[n++] = es->hd->index;
+        }
+        for ( ; es; es = es->tl)
+            n = findarrays(c, es->hd, i, body, arrays, n);
+        return n;
+    }
+    assert(0);
+    return n;
+}
+
+static void compileloop(Compiler *c, Exp e, int target) {
+    int top = c->code->ninstrs, jump = compilecond(c, e->u.whilex.cond);
+
+    compileexp(c, e->u.whilex.exp, target);
+    emit(c, LOOP, 0, 0, top, e);
+    patch(c, jump);
+    loadk(c, target, 0);
+}
+
+static void compilewhile(Compiler *c, Exp e, int target) {
+    Exp i, n;
+    int hoisted[MAXSAFE], nhoisted, guards[2 * MAXSAFE + 1], nguards = 0;
+    int k, end, size = -1, save = c->next, nsafe = c->nsafe;
+
+    if (!hoistable(c, e, &i, &n) ||
+        (nhoisted = findarrays(c, e->u.whilex.exp, i, e->u.whilex.exp,
+                                                         hoisted, 0)) == 0 ||
+        c->nsafe + nhoisted > MAXSAFE) {
+        compileloop(c, e, target);
+        return;
+    }
+    if (n->alt == APPLY) {
+        size = n->u.apply.actuals->hd->index;
+        guards[nguards++] = emit(c, GUARDARRAY, size, i->index, 0, e);
+    }
+    for (k = 0; k < nhoisted; k++) {
+        int bound;
+
+        guards[nguards++] = emit(c, GUARDARRAY, hoisted[k], i->index, 0, e);
+        if (hoisted[k] == size)
+            continue;
+        else if (n->alt == LITERAL)
+            loadk(c, bound = newreg(c), n->u.literal);
+        else if (n->alt == VAR)
+            bound = n->index;
+        else
+            emit(c, ASIZE, bound = newreg(c), size, 0, n);
+        guards[nguards++] = emit(c, GUARDBOUND, hoisted[k], bound, 0, e);
+        c->next = save;
+    }
+    for (k = 0; k < nhoisted; k++) {
+        c->safe[c->nsafe].array = hoisted[k];
+        c->safe[c->nsafe++].index = i->index;
+    }
+    compileloop(c, e, target);
+    c->nsafe = nsafe;
+    end = emit(c, JUMP, 0, 0, 0, e);
+    for (k = 0; k < nguards; k++)
+        patch(c, guards[k]);
+    compileloop(c, e, target);
+    patch(c, end);
+}
+
+static void compileexp(Compiler *c, Exp e, int target) {
+    int jump, top, op, save = c->next;
+
+    switch (e->alt) {
+    case LITERAL:
+        loadk(c, target, e->u.literal);
+        return;
+    case VAR:
+        if (e->index >= 0)
+            emit(c, MOVE, target, e->index, 0, e);
+        else
+            emit(c, GETGLOBAL, target, 0, 0, e);
+        return;
+    case SET:
+        compileexp(c, e->u.set.exp, target);
+        if (e->index >= 0)
+            emit(c, MOVE, e->index, target, 0, e);
+        else
+            emit(c, SETGLOBAL, target, 0, 0, e);
+        return;
+    case IFX:
+        jump = compilecond(c, e->u.ifx.cond);
+        compileexp(c, e->u.ifx.truex, target);
+        top = emit(c, JUMP, 0, 0, 0, e);
+        patch(c, jump);
+        compileexp(c, e->u.ifx.falsex, target);
+        patch(c, top);
+        return;
+    case WHILEX:
+        compilewhile(c, e, target);
+        return;
+    case BEGIN:
+        if (e->u.begin == NULL)
+            loadk(c, target, 0);
+        for (Explist es = e->u.begin; es; es = es->tl)
+            compileexp(c, es->hd, target);
+        return;
+    case APPLY:
+        op = inlineop(e, c->functions);
+        if (op == ASIZE)
+            emit(c, ASIZE, target, operand(c, e->u.apply.actuals->hd, NULL), 0,
+                                                                             e);
+        else if (op == AGET || op == APUT)
+            compilearray(c, e, op, target);
+        else if (op >= 0) {
+            Exp x = e->u.apply.actuals->hd;
+            Exp y = e->u.apply.actuals->tl->hd;
+            int rx = operand(c, x, e->u.apply.actuals->tl);
+            int ry = operand(c, y, NULL);
+
+            emit(c, op, target, rx, ry, e);
+        } else {
+            int n = lengthEL(e->u.apply.actuals), base = c->next, i = 0;
+
+            if (funslot(e, c->functions) == NULL)
+                emit(c, CHECKFUN, 0, 0, 0, e);
+            for (i = 0; i < n; i++)
+                newreg(c);
+            i = 0;
+            for (Explist es = e->u.apply.actuals; es; es = es->tl)
+                compileexp(c, es->hd, base + i++);
+            emit(c, CALL, target, base, n, e);
+        }
+        c->next = save;
+        return;
+    }
+    assert(0);
+}
+
+static void compilecode(Code code, Funenv functions) {
+    Compiler c;
+    int result;
+
+    code->ninstrs = 0;
+    code->nregs = code->nformals + code->nlocals;
+    c.code = code;
+    c.next = code->nregs;
+    c.functions = functions;
+    c.nsafe = 0;
+    result = newreg(&c);
+    compileexp(&c, code->body, result);
+    emit(&c, RETURN, result, 0, 0, code->body);
+}
+/*
+ * A function's code is made when the function is defined, and it holds
+ * the optimized body, which both evaluators run.  The body is compiled
+ * to instructions the first time the function is called.  Stale code
+ * is optimized and compiled again.
+ */
+static Code freshcode(Userfun *f, Funenv functions) {
+    Code code = f->code;
+
+    assert(code != NULL);
+    if (code->body == NULL || code->generation != generation) {
+        int nslots;
+
+        code->body = optimize(code->name, f, functions, &nslots);
+        code->nformals = f->nformals;
+        code->nlocals = nslots - f->nformals;
+        code->ninstrs = 0;
+        code->generation = generation;
     }
+    return code;
+}
+
+static Exp funbody(Userfun *f, Funenv functions, int *nlocals) {
+    Code code = freshcode(f, functions);
+
+    *nlocals = code->nlocals;
+    return code->body;
+}
+
+static Code funcode(Userfun *f, Funenv functions) {
+    Code code = freshcode(f, functions);
+
+    if (code->ninstrs == 0)
+        compilecode(code, functions);
+    return code;
+}
+
+static void freecode(Code code) {
+    if (code != NULL) {
+        free(code->instrs);
+        free(code);
+    }
+}
+/* eval.c: running bytecode */
+/*
+ * [[run]] executes [[code]] in the record at [[stack[fp]]].  Because
+ * a call may move the stack, the registers are found again after each
+ * call.  With GCC, each instruction jumps straight to the next one's
+ * handler through a table of label addresses; elsewhere, the handlers
+ * are the cases of a [[switch]].  While profiling, every entry of the
+ * table leads to [[count]], which counts a step and goes on to the
+ * handler, so counting costs nothing when the profiler is off.
+ */
+#if defined(__GNUC__) && !defined(NOCOMPUTEDGOTO)
+#define COMPUTEDGOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"  // labels as values
+#endif
+
+/*
+ * An arithmetic or comparison instruction calls [[arith]] or
+ * [[compare]] only when an operand or the result is outside [[lo..hi]].
+ */
+#define ARITH(OVERFLOWS, OPERATION)                                           \
+    {                                                                         \
+        Value x = r[pc->b], y = r[pc->c], z;                                  \
+                                                                              \
+        if (OVERFLOWS(x, y, &z) || x < lo || y < lo ||            \
+                                   z < lo || z > hi)              \
+            z = arith(OPERATION, x, y);                                       \
+        r[pc->a] = z;                                                         \
+        pc++;                                                                 \
+        NEXT;                                                                 \
+    }
+#define COMPARE(OP)                                                           \
+    {                                                                         \
+        Value x = r[pc->b], y = r[pc->c];                                     \
+                                                                              \
+        r[pc->a] = x >= lo && y >= lo ? x OP y                    \
+                                                  : compare(x, y) OP 0;       \
+        pc++;                                                                 \
+        NEXT;                                                                 \
+    }
+
+static Value run(Code code, int fp, Valenv globals, Funenv functions) {
+    Instruction *pc = code->instrs;
+    Value *r;
+    const Value lo = smallmin, hi = smallmax;  // the small integers
+
+#ifdef COMPUTEDGOTO
+    static void *handlers[] = {
+        &&do_LOADK, &&do_MOVE, &&do_GETGLOBAL, &&do_SETGLOBAL,
+        &&do_IADD, &&do_ISUB, &&do_IMUL, &&do_IDIV, &&do_ILT, &&do_IGT,
+        &&do_IEQ, &&do_JUMP, &&do_LOOP, &&do_JFALSE, &&do_JNLT, &&do_JNGT,
+        &&do_JNEQ, &&do_CHECKFUN, &&do_CALL, &&do_RETURN, &&do_AGET,
+        &&do_AGETU, &&do_APUT, &&do_APUTU, &&do_ASIZE, &&do_GUARDARRAY,
+        &&do_GUARDBOUND
+    };
+    static void *counters[sizeof(handlers) / sizeof(handlers[0])];
+    void **table = handlers;
+#define NEXT        goto *table[pc->op]
+#define HANDLE(OP)  do_##OP
+#else
+#define NEXT        goto dispatch
+#define HANDLE(OP)  case OP
+#endif
+
+    checkoverflow(1000000 * sizeof(char *));
+    reserve(fp + code->nregs);
+    r = stack + fp;
+    memset(r + code->nformals, 0, code->nlocals * sizeof(*r));
+    if (numbersgrew)
+        collect(globals);
+#ifdef COMPUTEDGOTO
+    if (profiling) {
+        for (unsigned k = 0; k < sizeof(counters) / sizeof(counters[0]); k++)
+            counters[k] = &&count;
+        table = counters;
+    }
+    NEXT;
+    {
+  count:
+        profsteps++;
+        goto *handlers[pc->op];
+#else
+  dispatch:
+    if (profiling)
+        profsteps++;
+    switch (pc->op) {
+#endif
+    HANDLE(LOADK):
+        r[pc->a] = pc->k;
+        pc++;
+        NEXT;
+    HANDLE(MOVE):
+        r[pc->a] = r[pc->b];
+        pc++;
+        NEXT;
+    HANDLE(GETGLOBAL):
+        {
+            Value *vp = globalslot(pc->e, pc->e->u.var, globals);
+
+            if (vp == NULL)
+                runerror("unbound variable %n", pc->e->u.var);
+            r[pc->a] = *vp;
+            pc++;
+            NEXT;
+        }
+    HANDLE(SETGLOBAL):
+        {
+            Value *vp = globalslot(pc->e, pc->e->u.set.name, globals);
+
+            if (vp == NULL)
+                runerror("tried to set unbound variable %n in %e",
+                                                       pc->e->u.set.name, pc->e);
+            *vp = r[pc->a];
+            pc++;
+            NEXT;
+        }
+    HANDLE(IADD):
+        ARITH(__builtin_add_overflow, '+')
+    HANDLE(ISUB):
+        ARITH(__builtin_sub_overflow, '-')
+    HANDLE(IMUL):
+        ARITH(__builtin_mul_overflow, '*')
+    HANDLE(IDIV):
+        {
+            Value x = r[pc->b], y = r[pc->c];
+
+            if (y == 0)
+                runerror("division by zero in %e", pc->e);
+            if (x >= lo && y >= lo && !(x == lo && y == -1))
+                r[pc->a] = x / y;
+            else
+                r[pc->a] = arith('/', x, y);
+            pc++;
+            NEXT;
+        }
+    HANDLE(ILT):
+        COMPARE(<)
+    HANDLE(IGT):
+        COMPARE(>)
+    HANDLE(IEQ):
+        r[pc->a] = r[pc->b] == r[pc->c];
+        pc++;
+        NEXT;
+    HANDLE(JUMP):
+        pc = code->instrs + pc->c;
+        NEXT;
+    HANDLE(LOOP):
+        checkoverflow(1000000 * sizeof(char *));
+        if (numbersgrew)
+            collect(globals);
+        pc = code->instrs + pc->c;
+        NEXT;
+    HANDLE(JFALSE):
+        pc = r[pc->a] == 0 ? code->instrs + pc->c : pc + 1;
+        NEXT;
+    HANDLE(JNLT):
+        {
+            Value x = r[pc->a], y = r[pc->b];
+            bool lt = x >= lo && y >= lo ? x < y : compare(x, y) < 0;
+
+            pc = lt ? pc + 1 : code->instrs + pc->c;
+            NEXT;
+        }
+    HANDLE(JNGT):
+        {
+            Value x = r[pc->a], y = r[pc->b];
+            bool gt = x >= lo && y >= lo ? x > y : compare(x, y) > 0;
+
+            pc = gt ? pc + 1 : code->instrs + pc->c;
+            NEXT;
+        }
+    HANDLE(JNEQ):
+        pc = r[pc->a] != r[pc->b] ? code->instrs + pc->c : pc + 1;
+        NEXT;
+    HANDLE(CHECKFUN):
+        if (funslot(pc->e, functions) == NULL)
+            runerror("call to undefined function %n in %e",
+                                                    pc->e->u.apply.name, pc->e);
+        pc++;
+        NEXT;
+    HANDLE(CALL):
+        {
+            Fun *f = pc->e->slot.fun;
+            Value v;
+
+            if (f->alt == PRIMITIVE) {
+                if (profiling)
+                    profenter(pc->e->u.apply.name);
+                v = applyprimitive(pc->e, f->u.primitive.op, r + pc->b, pc->c);
+            } else {
+                Code callee = funcode(&f->u.userdef, functions);
+
+                checkargc(pc->e, callee->nformals, pc->c);
+                if (profiling)
+                    profenter(pc->e->u.apply.name);
+                v = run(callee, fp + pc->b, globals, functions);
+                r = stack + fp;
+            }
+            if (profiling)
+                profexit();
+            r[pc->a] = v;
+            pc++;
+            NEXT;
+        }
+    HANDLE(RETURN):
+        return r[pc->a];
+    HANDLE(AGET):
+        r[pc->a] = *arrayelem(pc->e, r[pc->b], r[pc->c]);
+        pc++;
+        NEXT;
+    HANDLE(AGETU):
+        r[pc->a] = arrays[r[pc->b]].elems[r[pc->c]];
+        pc++;
+        NEXT;
+    HANDLE(APUT):
+        *arrayelem(pc->e, r[pc->b], r[pc->c]) = r[pc->a];
+        pc++;
+        NEXT;
+    HANDLE(APUTU):
+        arrays[r[pc->b]].elems[r[pc->c]] = r[pc->a];
+        pc++;
+        NEXT;
+    HANDLE(ASIZE):
+        r[pc->a] = arraysize(pc->e, r[pc->b]);
+        pc++;
+        NEXT;
+    HANDLE(GUARDARRAY):  // is r[a] an array and r[b] not negative?
+        {
+            Value a = r[pc->a];
+
+            pc = a >= 1 && a <= narrays && r[pc->b] >= 0 ? pc + 1
+                                                         : code->instrs + pc->c;
+            NEXT;
+        }
+    HANDLE(GUARDBOUND):  // is r[b] at most the size of array r[a]?
+        {
+            Value n = r[pc->b];
+
+            pc = n >= lo && n <= arrays[r[pc->a]].size ? pc + 1
+                                                       : code->instrs + pc->c;
+            NEXT;
+        }
+    }
+    assert(0);
+    return 0;
+#undef NEXT
+#undef HANDLE
+#undef ARITH
+#undef COMPARE
+}
+
+#ifdef COMPUTEDGOTO
+#pragma GCC diagnostic pop
+#endif
+/*
+ * A top-level expression is compiled once, into code that is used
+ * again for the next one.
+ */
+static Value runtoplevel(Exp e, Valenv globals, Funenv functions) {
+    static struct Code code;
+
+    code.body = e;
+    compilecode(&code, functions);
+    return run(&code, 0, globals, functions);
 }
 /* eval.c 56a */
 void evaldef(Def d, Valenv globals, Funenv functions, Echo echo) {
@@ -166,8 +1103,7 @@ void evaldef(Def d, Valenv globals, Funenv functions, Echo echo) {
     case VAL:
         /* evaluate [[d->u.val]], mutating [[globals]] 56b */
         {
-            Value v = eval(d->u.val.exp, globals, functions, mkValenv(NULL, NULL
-                                                                             ));
+            Value v = eval(d->u.val.exp, globals, functions);
             bindval(d->u.val.name, v, globals);
             if (echo == ECHOES)
                 print("%v\n", v);
@@ -176,7 +1112,7 @@ void evaldef(Def d, Valenv globals, Funenv functions, Echo echo) {
     case EXP:
         /* evaluate [[d->u.exp]] and possibly print the result 56c */
         {
-            Value v = eval(d->u.exp, globals, functions, mkValenv(NULL, NULL));
+            Value v = eval(d->u.exp, globals, functions);
             bindval(strtoname("it"), v, globals);
             if (echo == ECHOES)
                 print("%v\n", v);
@@ -184,7 +1120,26 @@ void evaldef(Def d, Valenv globals, Funenv functions, Echo echo) {
         return;
     case DEFINE:
         /* evaluate [[d->u.define]], mutating [[functions]] 57a */
+        {
+            Fun *old = findfun(d->u.define.name, functions);
+
+            if (old != NULL && old->alt == PRIMITIVE)
+                generation++;  // code that does the primitive inline is stale
+            else if (old != NULL) {
+                if (inlinable(d->u.define.name, &old->u.userdef))
+                    generation++;  // so is code that inlined the function
+                freecode(old->u.userdef.code);
+            }
+        }
         bindfun(d->u.define.name, mkUserdef(d->u.define.userfun), functions);
+        {
+            Userfun *f = &findfun(d->u.define.name, functions)->u.userdef;
+
+            f->code = calloc(1, sizeof(*f->code));
+            assert(f->code != NULL);
+            f->code->name = d->u.define.name;
+            freshcode(f, functions);
+        }
         if (echo == ECHOES)
             print("%n\n", d->u.define.name);
         return;
@@ -24,17 +24,23 @@ int main(int argc, char *argv[]) {
     installprinter('v', printvalue);
     installprinter('V', printvaluelist);
     installprinter('%', printpercent);
+    initarithmetic();
 
     Valenv globals   = mkValenv(NULL, NULL);
     Funenv functions = mkFunenv(NULL, NULL);
     /* install the initial basis in [[functions]] S134a */
     {
-        static const char *prims[] = 
-           { "+", "-", "*", "/", "<", ">", "=", "println", "print", "printu", 0
-                                                                              };
-        for (const char **p = prims; *p; p++) {
-            Name x = strtoname(*p);
-            bindfun(x, mkPrimitive(x), functions);
+        static const struct { const char *name; Primop op; } prims[] = {
+            { "+", ADD }, { "-", SUB }, { "*", MUL }, { "/", DIV },
+            { "<", LT }, { ">", GT }, { "=", EQ },
+            { "println", PRINTLN }, { "print", PRINT }, { "printu", PRINTU },
+            { "make-array", MKARRAY }, { "array-at", ARRAYAT },
+            { "array-put", ARRAYPUT }, { "array-size", ARRAYSIZE },
+            { NULL, ADD }
+        };
+        for (int i = 0; prims[i].name; i++) {
+            Name x = strtoname(prims[i].name);
+            bindfun(x, mkPrimitive(x, prims[i].op), functions);
         }
     }
     /* install the initial basis in [[functions]] S134c */
@@ -63,6 +69,7 @@ int main(int argc, char *argv[]) {
     if (argv[1] && !strcmp(argv[1], "-names")) { dump_fenv_names(functions);
                                                              exit(0); } /*OMIT*/
 
+    initprofile();
     while (setjmp(errorjmp))
         ;
     readevalprint(xdefs, globals, functions, ECHOES);
@@ -33,6 +33,8 @@ void printexp(Printbuf output, va_list_box *box) {
         bprint(output, "<null>");
         return;
     }
+    if (e->source != NULL)
+        e = e->source;  // print what the programmer wrote
 
     switch (e->alt){
     case LITERAL:
@@ -123,14 +125,14 @@ void printxdef(Printbuf output, va_list_box *box) {
 /* printfuns.c S142b */
 void printvalue(Printbuf output, va_list_box *box) {
     Value v = va_arg(box->ap, Value);
-    bprint(output, "%d", v);
+    printnumber(output, v);
 }
 /* printfuns.c S142c */
 void printfun(Printbuf output, va_list_box *box) {
     Fun f = va_arg(box->ap, Fun);
     switch (f.alt) {
     case PRIMITIVE:
-        bprint(output, "<%n>", f.u.primitive);
+        bprint(output, "<%n>", f.u.primitive.name);
         break;
     case USERDEF:
         bprint(output, "<userfun (%N) %e>", f.u.userdef.formals,
@@ -0,0 +1,201 @@
+#define _POSIX_C_SOURCE 199309L  /* for clock_gettime */
+#include "all.h"
+#include <time.h>
+/* profile.c: a profiler */
+/*
+ * If [[BPCOPTIONS]] holds [[profile]], [[eval]] tells the profiler when
+ * each call to a function or a primitive begins and ends, and it counts
+ * evaluation steps in [[profsteps]].  The time and the steps that pass
+ * between two events are charged to the innermost active call, both in
+ * a record for the function called and in a node of a calling-context
+ * tree, which stands for the sequence of calls that are active.  Calls
+ * more than [[MAXDEPTH]] deep are charged to the node at that depth.
+ *
+ * At exit, the records are printed on [[stderr]], sorted by self time.
+ * The tree is written to [[impcore.folded]] as folded stacks: a line
+ * per node, naming the calls from the top level down, then the node's
+ * self time in microseconds.  Flame-graph tools read this format.
+ */
+bool profiling;
+unsigned long profsteps;
+
+#define MAXDEPTH 1000
+
+typedef struct Record {
+    Name name;
+    unsigned long calls, steps;  // steps taken in the function itself
+    int64_t self, total;         // nanoseconds in the function itself, and
+                                 // in its outermost activations
+    int64_t start;               // when the outermost activation began
+    int active;                  // number of activations
+} Record;
+
+typedef struct Node *Node;
+struct Node {
+    int record;               // index of the function's record
+    int64_t self;
+    Node parent, children, sibling;
+};
+
+static Record *records;
+static int nrecords, maxrecords;
+
+static struct Frame { Node node; int record; } *frames;
+static int depth, maxframes;  // frames[0..depth) are the active calls,
+                              // and frames[0] is the top level
+static int64_t lasttime;      // time of the last event
+static unsigned long laststeps;
+
+static int64_t now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int recordof(Name f) {
+    int i;
+
+    for (i = 0; i < nrecords; i++)
+        if (records[i].name == f)
+            return i;
+    if (nrecords == maxrecords) {
+        maxrecords = maxrecords ? 2 * maxrecords : 64;
+        records = realloc(records, maxrecords * sizeof(*records));
+        assert(records != NULL);
+    }
+    records[nrecords] = (Record) { f, 0, 0, 0, 0, 0, 0 };
+    return nrecords++;
+}
+
+static Node child(Node parent, Name f) {
+    Node n;
+
+    for (n = parent->children; n != NULL; n = n->sibling)
+        if (records[n->record].name == f)
+            return n;
+    n = calloc(1, sizeof(*n));
+    assert(n != NULL);
+    n->record  = recordof(f);
+    n->parent  = parent;
+    n->sibling = parent->children;
+    parent->children = n;
+    return n;
+}
+
+static void charge(void) {  // the time and steps since the last event
+    int64_t t = now();
+    struct Frame *f = &frames[depth - 1];
+
+    f->node->self += t - lasttime;
+    records[f->record].self  += t - lasttime;
+    records[f->record].steps += profsteps - laststeps;
+    lasttime  = t;
+    laststeps = profsteps;
+}
+
+static void push(Node n, int record) {
+    Record *r = &records[record];
+
+    if (depth == maxframes) {
+        maxframes = maxframes ? 2 * maxframes : 256;
+        frames = realloc(frames, maxframes * sizeof(*frames));
+        assert(frames != NULL);
+    }
+    frames[depth++] = (struct Frame) { n, record };
+    r->calls++;
+    if (r->active++ == 0)
+        r->start = lasttime;
+}
+
+void profenter(Name f) {
+    Node n = frames[depth - 1].node;
+
+    charge();
+    if (depth < MAXDEPTH)
+        n = child(n, f);
+    push(n, depth < MAXDEPTH ? n->record : recordof(f));
+}
+
+void profexit(void) {
+    Record *r;
+
+    charge();
+    r = &records[frames[--depth].record];
+    if (--r->active == 0)
+        r->total += lasttime - r->start;
+}
+
+void profunwind(void) {
+    while (depth > 1)
+        profexit();
+}
+/* profile.c: reports */
+static int byselftime(const void *p, const void *q) {
+    const Record *r = *(Record *const *) p, *s = *(Record *const *) q;
+
+    return (r->self < s->self) - (r->self > s->self);
+}
+
+static void printpath(FILE *out, Node n) {
+    if (n->parent != NULL) {
+        printpath(out, n->parent);
+        fputc(';', out);
+    }
+    fputs(nametostr(records[n->record].name), out);
+}
+
+static void printfolded(FILE *out, Node n) {
+    if (n->self >= 1000) {
+        printpath(out, n);
+        fprintf(out, " %" PRId64 "\n", n->self / 1000);
+    }
+    for (n = n->children; n != NULL; n = n->sibling)
+        printfolded(out, n);
+}
+
+static void printprofile(void) {
+    Record **sorted = malloc(nrecords * sizeof(*sorted));
+    FILE *out;
+    int i;
+
+    assert(sorted != NULL);
+    profunwind();
+    profexit();  // the top level
+    for (i = 0; i < nrecords; i++)
+        sorted[i] = &records[i];
+    qsort(sorted, nrecords, sizeof(*sorted), byselftime);
+    fprintf(stderr, "%-24s %10s %14s %12s %12s\n",
+                    "function", "calls", "steps", "self ms", "total ms");
+    for (i = 0; i < nrecords; i++)
+        fprintf(stderr, "%-24s %10lu %14lu %12.3f %12.3f\n",
+                        nametostr(sorted[i]->name), sorted[i]->calls,
+                        sorted[i]->steps, sorted[i]->self / 1e6,
+                        sorted[i]->total / 1e6);
+    free(sorted);
+    out = fopen("impcore.folded", "w");
+    if (out == NULL) {
+        fprintf(stderr, "impcore: cannot write impcore.folded\n");
+        return;
+    }
+    printfolded(out, frames[0].node);
+    fclose(out);
+}
+/*
+ * [[initprofile]] starts the clock, and with it the top level, which
+ * is charged for whatever is evaluated outside any function.
+ */
+void initprofile(void) {
+    const char *options = getenv("BPCOPTIONS");
+    Node root;
+
+    profiling = options != NULL && strstr(options, "profile") != NULL;
+    if (!profiling)
+        return;
+    root = calloc(1, sizeof(*root));
+    assert(root != NULL);
+    root->record = recordof(strtoname("(top-level)"));
+    lasttime = now();
+    push(root, root->record);
+    atexit(printprofile);
+}
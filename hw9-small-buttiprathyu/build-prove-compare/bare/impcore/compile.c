@@ -0,0 +1,993 @@
+#include "all.h"
+/* compile.c: compiling Impcore to C */
+/*
+ * [[impcore -c out.c]] reads a program from standard input and writes
+ * a C program that, compiled and run, prints what [[impcore -q]] would
+ * print given the same input.  Each [[define]] becomes a C function,
+ * each global variable a static variable, and each unit test a C
+ * function that returns 1 if the test passes.  Every other top-level
+ * item becomes a numbered step, which [[main]] runs in order.  After a
+ * run-time error, the compiled program does what the interpreter does:
+ * it forgets its pending tests and resumes with the next item read from
+ * standard input.
+ *
+ * The compiled program differs from the interpreter in four ways.  A
+ * file named in [[use]] is read when the program is compiled, not when
+ * it runs; the compiled program is never throttled, as if
+ * [[BPCOPTIONS]] held [[nothrottle]]; its integers have 32 bits, so
+ * [[-c]] refuses to run in [[int64]] or [[bignum]] mode; and a program
+ * that has a syntax error, or that redefines a primitive, is rejected.
+ */
+typedef enum { STEPDEF, STEPTEST, BEGINUSE, ENDUSE, BADUSE, ENDPROGRAM }
+                                                                      Stepalt;
+typedef struct Step {
+    Stepalt alt;
+    int level;       // 0 for standard input, -1 for the initial basis
+    bool echo;
+    Def def;         // STEPDEF
+    int test;        // STEPTEST
+    Name file;       // BADUSE
+    int version;     // STEPDEF of a [[define]]: which definition of the name
+} Step;
+
+static struct {
+    Step *steps;
+    int nsteps, size;
+    UnitTest *tests;
+    int ntests, testsize;
+    int maxlevel;
+} program;
+/*
+ * Global variables and functions are numbered, and a [[Valenv]] maps
+ * each name to its number.  For a function, the compiler also records
+ * how many times it is defined and, if it is defined only once, its
+ * arity.  A function defined once is called directly; one defined more
+ * than once is called through the pointer that its [[define]] sets.
+ */
+static Valenv globalnums, funnums;
+static Namelist globalnames, funnames;   // newest first
+static int nglobals, nfuns;
+static struct { int ndefs, arity; } *funinfo;
+static Funenv primitives;
+
+static int number(Name x, Valenv nums, Namelist *names, int *n) {
+    Value *vp = findval(x, nums);
+
+    if (vp != NULL)
+        return *vp;
+    bindval(x, *n, nums);
+    *names = mkNL(x, *names);
+    return (*n)++;
+}
+
+static int globalnum(Name x) {
+    return number(x, globalnums, &globalnames, &nglobals);
+}
+
+static int funnum(Name x) {
+    int n = nfuns, k = number(x, funnums, &funnames, &nfuns);
+    static int size;
+
+    if (k >= size) {
+        size = size ? 2 * size : 64;
+        funinfo = realloc(funinfo, size * sizeof(*funinfo));
+        assert(funinfo != NULL);
+    }
+    if (nfuns > n)  // x is new
+        funinfo[k].ndefs = 0;
+    return k;
+}
+
+static bool isprimitive(Name x, Primop *op) {
+    Fun *fp = findfun(x, primitives);
+
+    if (fp == NULL || fp->alt != PRIMITIVE)
+        return false;
+    *op = fp->u.primitive.op;
+    return true;
+}
+/* compile.c: collecting the program */
+static Step *addstep(Stepalt alt, int level, bool echo) {
+    Step *s;
+
+    if (program.nsteps == program.size) {
+        program.size = program.size ? 2 * program.size : 256;
+        program.steps = realloc(program.steps,
+                                program.size * sizeof(*program.steps));
+        assert(program.steps != NULL);
+    }
+    s = &program.steps[program.nsteps++];
+    s->alt = alt;
+    s->level = level;
+    s->echo = echo;
+    if (level > program.maxlevel)
+        program.maxlevel = level;
+    return s;
+}
+
+static void collect(XDefstream xdefs, int level, bool echo) {
+    for (XDef d = getxdef(xdefs); d; d = getxdef(xdefs))
+        switch (d->alt) {
+        case TEST:
+            if (program.ntests == program.testsize) {
+                program.testsize = program.testsize ? 2 * program.testsize : 64;
+                program.tests = realloc(program.tests,
+                                  program.testsize * sizeof(*program.tests));
+                assert(program.tests != NULL);
+            }
+            program.tests[program.ntests] = d->u.test;
+            addstep(STEPTEST, level, echo)->test = program.ntests++;
+            break;
+        case USE:
+            {
+                const char *filename = nametostr(d->u.use);
+                FILE *fin = fopen(filename, "r");
+                if (fin == NULL) {
+                    addstep(BADUSE, level, echo)->file = d->u.use;
+                    break;
+                }
+                addstep(BEGINUSE, level, echo);
+                collect(filexdefs(filename, fin, NO_PROMPTS), level + 1, echo);
+                addstep(ENDUSE, level + 1, echo);
+                fclose(fin);
+            }
+            break;
+        case DEF:
+            {
+                Def def = d->u.def;
+                Step *s;
+                Primop op;
+
+                if (def->alt == DEFINE) {
+                    int k = funnum(def->u.define.name);
+                    if (isprimitive(def->u.define.name, &op)) {
+                        fprint(stderr, "impcore: cannot compile a redefinition "
+                                       "of primitive %n\n", def->u.define.name);
+                        exit(1);
+                    }
+                    funinfo[k].arity = lengthNL(def->u.define.userfun.formals);
+                    s = addstep(STEPDEF, level, echo);
+                    s->version = ++funinfo[k].ndefs;
+                } else {
+                    s = addstep(STEPDEF, level, echo);
+                }
+                s->def = def;
+            }
+            break;
+        default:
+            assert(0);
+        }
+}
+/* compile.c: writing C */
+/*
+ * Names, expressions, and error messages go into the C code as string
+ * literals; names also go into identifiers, keeping only the letters
+ * and digits.
+ */
+static char *cstring(const char *s) {
+    Printbuf buf = printbuf();
+    char c[2] = { 0, 0 };
+    char *result;
+
+    bprint(buf, "\"");
+    for ( ; *s; s++)
+        switch (*s) {
+        case '"':  bprint(buf, "\\\""); break;
+        case '\\': bprint(buf, "\\\\"); break;
+        case '\n': bprint(buf, "\\n");  break;
+        case '\t': bprint(buf, "\\t");  break;
+        case '?':  bprint(buf, "\\?");  break;  // no trigraphs
+        default:
+            c[0] = *s;
+            bprint(buf, "%s", c);
+        }
+    bprint(buf, "\"");
+    result = bufcopy(buf);
+    freebuf(&buf);
+    return result;
+}
+
+static char *quotename(Name x) {
+    return cstring(nametostr(x));
+}
+
+static char *quoteexp(Exp e) {
+    Printbuf buf = printbuf();
+    char *s, *result;
+
+    bprint(buf, "%e", e);
+    s = bufcopy(buf);
+    freebuf(&buf);
+    result = cstring(s);
+    free(s);
+    return result;
+}
+
+static char *cname(Name x) {
+    const char *s = nametostr(x);
+    char *result = malloc(strlen(s) + 1), *p = result;
+
+    assert(result != NULL);
+    for ( ; *s && p - result < 24; s++)
+        if (isalnum((unsigned char)*s) || *s == '_')
+            *p++ = *s;
+    *p = '\0';
+    return result;
+}
+/*
+ * A function's code goes into a buffer as it is compiled, because the
+ * temporaries it declares are known only at the end.  Every value is
+ * computed into a temporary; leaving the rest to the C compiler keeps
+ * the order of evaluation Impcore's own.
+ */
+typedef struct Gen {
+    Printbuf code;
+    int ntemps;
+    Namelist formals;  // NULL at top level
+} Gen;
+
+static void emit(Gen *g, int depth, const char *fmt, ...) {
+    va_list_box box;
+
+    for (int i = 0; i < depth; i++)
+        bprint(g->code, "    ");
+    va_start(box.ap, fmt);
+    vbprint(g->code, fmt, &box);
+    va_end(box.ap);
+}
+
+static int newtemp(Gen *g) {
+    return g->ntemps++;
+}
+
+static int formalindex(Name x, Namelist xs) {
+    int i;
+
+    for (i = 0; xs; xs = xs->tl, i++)
+        if (xs->hd == x)
+            return i;
+    return -1;
+}
+
+static void compileexp(Gen *g, Exp e, int t, int depth);
+
+static void compileglobal(Gen *g, Exp e, Name x, int t, int depth) {
+    int k = globalnum(x);
+    char *cx = cname(x), *qx = quotename(x);
+
+    if (e->alt == VAR) {
+        emit(g, depth, "if (!bound%d) unbound(%s);\n", k, qx);
+        emit(g, depth, "t%d = g%d_%s;\n", t, k, cx);
+    } else {
+        char *qe = quoteexp(e);
+        emit(g, depth, "if (!bound%d) unboundset(%s, %s);\n", k, qx, qe);
+        emit(g, depth, "g%d_%s = t%d;\n", k, cx, t);
+        free(qe);
+    }
+    free(cx);
+    free(qx);
+}
+
+static void compileprimitive(Gen *g, Exp e, Primop op, int *args, int n,
+                             int t, int depth) {
+    static const char *arith[] = { [ADD] = "add", [SUB] = "sub",
+                                   [MUL] = "mul", [DIV] = "divide" };
+    static const char *compare[] = { [LT] = "<", [GT] = ">", [EQ] = "==" };
+    static const char *printer[] = { [PRINT] = "printvalue",
+                                     [PRINTLN] = "printline",
+                                     [PRINTU] = "printutf8" };
+    static const int arity[] = { [PRINT] = 1, [PRINTLN] = 1, [PRINTU] = 1,
+                                 [ARRAYPUT] = 3, [ARRAYSIZE] = 1 };
+    int expected = arity[op] ? arity[op] : 2;
+    char *qe = quoteexp(e);
+
+    if (n != expected) {
+        for (int i = 0; i < n; i++)   // evaluated, but never used
+            emit(g, depth, "(void) t%d;\n", args[i]);
+        emit(g, depth, "argcerror(%s, %d, %d);\n", qe, expected, n);
+        emit(g, depth, "t%d = 0;\n", t);
+        free(qe);
+        return;
+    }
+    switch (op) {
+    case PRINT: case PRINTLN: case PRINTU:
+        emit(g, depth, "t%d = %s(t%d);\n", t, printer[op], args[0]);
+        break;
+    case LT: case GT: case EQ:
+        emit(g, depth, "t%d = t%d %s t%d;\n", t, args[0], compare[op], args[1]);
+        break;
+    case DIV:
+        emit(g, depth, "t%d = divide(t%d, t%d, %s);\n", t, args[0], args[1], qe);
+        break;
+    case MKARRAY:
+        emit(g, depth, "t%d = makearray(t%d, t%d, %s);\n", t, args[0], args[1],
+                                                                            qe);
+        break;
+    case ARRAYAT:
+        emit(g, depth, "t%d = *arrayelem(t%d, t%d, %s);\n", t, args[0], args[1],
+                                                                            qe);
+        break;
+    case ARRAYPUT:
+        emit(g, depth, "t%d = *arrayelem(t%d, t%d, %s) = t%d;\n", t, args[0],
+                                                          args[1], qe, args[2]);
+        break;
+    case ARRAYSIZE:
+        emit(g, depth, "t%d = findarray(t%d, %s)->size;\n", t, args[0], qe);
+        break;
+    default:
+        emit(g, depth, "t%d = %s(t%d, t%d);\n", t, arith[op], args[0], args[1]);
+        break;
+    }
+    free(qe);
+}
+
+static void compileapply(Gen *g, Exp e, int t, int depth) {
+    Name f = e->u.apply.name;
+    int n = lengthEL(e->u.apply.actuals);
+    int *args = malloc((n + 1) * sizeof(*args));
+    char *qe = quoteexp(e), *qf = quotename(f), *cf = cname(f);
+    Primop op;
+    int i, k;
+    Explist es;
+
+    assert(args != NULL);
+    if (isprimitive(f, &op)) {
+        for (i = 0, es = e->u.apply.actuals; es; es = es->tl, i++)
+            compileexp(g, es->hd, args[i] = newtemp(g), depth);
+        compileprimitive(g, e, op, args, n, t, depth);
+    } else {
+        k = funnum(f);
+        emit(g, depth, "if (arity%d < 0) undefined(%s, %s);\n", k, qf, qe);
+        if (funinfo[k].ndefs == 0) {  // never defined
+            emit(g, depth, "t%d = 0;\n", t);
+            goto done;
+        }
+        for (i = 0, es = e->u.apply.actuals; es; es = es->tl, i++)
+            compileexp(g, es->hd, args[i] = newtemp(g), depth);
+        if (funinfo[k].ndefs == 1 && funinfo[k].arity == n) {
+            emit(g, depth, "t%d = f%d_%s(", t, k, cf);
+        } else if (funinfo[k].ndefs == 1) {
+            for (i = 0; i < n; i++)   // evaluated, but never passed
+                emit(g, depth, "(void) t%d;\n", args[i]);
+            emit(g, depth, "argcerror(%s, %d, %d);\n", qe, funinfo[k].arity, n);
+            emit(g, depth, "t%d = 0;\n", t);
+        } else {
+            emit(g, depth, "if (arity%d != %d) argcerror(%s, arity%d, %d);\n",
+                           k, n, qe, k, n);
+            emit(g, depth, "t%d = ((Value (*)(", t);
+            for (i = 0; i < n; i++)
+                bprint(g->code, "%sValue", i ? ", " : "");
+            bprint(g->code, "%s)) fn%d)(", n ? "" : "void", k);
+        }
+        if (funinfo[k].ndefs > 1 || funinfo[k].arity == n) {
+            for (i = 0; i < n; i++)
+                bprint(g->code, "%st%d", i ? ", " : "", args[i]);
+            bprint(g->code, ");\n");
+        }
+    }
+done:
+    free(args);
+    free(qe);
+    free(qf);
+    free(cf);
+}
+
+static void compileexp(Gen *g, Exp e, int t, int depth) {
+    int i;
+
+    switch (e->alt) {
+    case LITERAL:
+        if (e->u.literal == INT32_MIN)
+            emit(g, depth, "t%d = -2147483647 - 1;\n", t);
+        else
+            emit(g, depth, "t%d = %d;\n", t, (int) e->u.literal);
+        return;
+    case VAR:
+        if ((i = formalindex(e->u.var, g->formals)) >= 0)
+            emit(g, depth, "t%d = x%d;\n", t, i);
+        else
+            compileglobal(g, e, e->u.var, t, depth);
+        return;
+    case SET:
+        compileexp(g, e->u.set.exp, t, depth);
+        if ((i = formalindex(e->u.set.name, g->formals)) >= 0)
+            emit(g, depth, "x%d = t%d;\n", i, t);
+        else
+            compileglobal(g, e, e->u.set.name, t, depth);
+        return;
+    case IFX:
+        i = newtemp(g);
+        compileexp(g, e->u.ifx.cond, i, depth);
+        emit(g, depth, "if (t%d != 0) {\n", i);
+        compileexp(g, e->u.ifx.truex, t, depth + 1);
+        emit(g, depth, "} else {\n");
+        compileexp(g, e->u.ifx.falsex, t, depth + 1);
+        emit(g, depth, "}\n");
+        return;
+    case WHILEX:
+        i = newtemp(g);
+        emit(g, depth, "for (;;) {\n");
+        compileexp(g, e->u.whilex.cond, i, depth + 1);
+        emit(g, depth + 1, "if (t%d == 0)\n", i);
+        emit(g, depth + 2, "break;\n");
+        compileexp(g, e->u.whilex.exp, t, depth + 1);
+        emit(g, depth, "}\n");
+        emit(g, depth, "t%d = 0;\n", t);
+        return;
+    case BEGIN:
+        emit(g, depth, "t%d = 0;\n", t);
+        for (Explist es = e->u.begin; es; es = es->tl)
+            compileexp(g, es->hd, t, depth);
+        return;
+    case APPLY:
+        compileapply(g, e, t, depth);
+        return;
+    }
+    assert(0);
+}
+/*
+ * A compiled function is written to [[out]] with its temporaries
+ * declared first.  [[header]] is the C declarator.
+ */
+static void writefunction(FILE *out, const char *header, Gen *g) {
+    fprintf(out, "%s {\n", header);
+    if (g->ntemps > 0) {
+        fprintf(out, "    Value");
+        for (int i = 0; i < g->ntemps; i++)
+            fprintf(out, "%s t%d", i ? "," : "", i);
+        fprintf(out, ";\n");
+    }
+    fwritebuf(g->code, out);
+    fprintf(out, "}\n\n");
+    freebuf(&g->code);
+}
+
+static Gen newgen(Namelist formals) {
+    Gen g;
+    g.code = printbuf();
+    g.ntemps = 0;
+    g.formals = formals;
+    return g;
+}
+/* compile.c: compiling functions, tests, and steps */
+static char *fundeclarator(Name f, int version, Namelist formals) {
+    Printbuf buf = printbuf();
+    char *cf = cname(f), *result;
+    int i, n = lengthNL(formals);
+
+    if (funinfo[funnum(f)].ndefs == 1)
+        bprint(buf, "static Value f%d_%s(", funnum(f), cf);
+    else
+        bprint(buf, "static Value f%d_%s_%d(", funnum(f), cf, version);
+    for (i = 0; i < n; i++)
+        bprint(buf, "%sValue x%d", i ? ", " : "", i);
+    bprint(buf, "%s)", n ? "" : "void");
+    result = bufcopy(buf);
+    freebuf(&buf);
+    free(cf);
+    return result;
+}
+
+static void compilefunction(FILE *out, Def d, int version) {
+    Userfun u = d->u.define.userfun;
+    Gen g = newgen(u.formals);
+    char *header = fundeclarator(d->u.define.name, version, u.formals);
+    int t = newtemp(&g);
+
+    emit(&g, 1, "checkstack();\n");
+    compileexp(&g, u.body, t, 1);
+    emit(&g, 1, "return t%d;\n", t);
+    writefunction(out, header, &g);
+    free(header);
+}
+
+static void compiletest(FILE *out, UnitTest test, int n) {
+    Gen g = newgen(NULL);
+    char header[64];
+
+    snprintf(header, sizeof(header), "static int test%d(void)", n);
+    switch (test->alt) {
+    case CHECK_EXPECT:
+        {
+            Exp check = test->u.check_expect.check;
+            Exp expect = test->u.check_expect.expect;
+            char *qc = quoteexp(check), *qx = quoteexp(expect);
+            int tc = newtemp(&g), tx = newtemp(&g);
+
+            emit(&g, 1, "if (setjmp(testjmp)) {\n");
+            emit(&g, 2, "expecterror(%s, %s, %s);\n", qc, qx, qc);
+            emit(&g, 2, "return 0;\n");
+            emit(&g, 1, "}\n");
+            compileexp(&g, check, tc, 1);
+            emit(&g, 1, "if (setjmp(testjmp)) {\n");
+            emit(&g, 2, "expecterror(%s, %s, %s);\n", qc, qx, qx);
+            emit(&g, 2, "return 0;\n");
+            emit(&g, 1, "}\n");
+            compileexp(&g, expect, tx, 1);
+            emit(&g, 1, "if (t%d != t%d) {\n", tc, tx);
+            emit(&g, 2, "expectfailed(%s, %s, t%d, t%d);\n", qc,
+                        expect->alt != LITERAL ? qx : "NULL", tx, tc);
+            emit(&g, 2, "return 0;\n");
+            emit(&g, 1, "}\n");
+            free(qc);
+            free(qx);
+        }
+        break;
+    case CHECK_ASSERT:
+        {
+            char *qa = quoteexp(test->u.check_assert);
+            int ta = newtemp(&g);
+
+            emit(&g, 1, "if (setjmp(testjmp)) {\n");
+            emit(&g, 2, "asserterror(%s);\n", qa);
+            emit(&g, 2, "return 0;\n");
+            emit(&g, 1, "}\n");
+            compileexp(&g, test->u.check_assert, ta, 1);
+            emit(&g, 1, "if (t%d == 0) {\n", ta);
+            emit(&g, 2, "assertfailed(%s);\n", qa);
+            emit(&g, 2, "return 0;\n");
+            emit(&g, 1, "}\n");
+            free(qa);
+        }
+        break;
+    case CHECK_ERROR:
+        {
+            char *qe = quoteexp(test->u.check_error);
+            int te = newtemp(&g);
+
+            emit(&g, 1, "if (setjmp(testjmp))\n");
+            emit(&g, 2, "return 1;\n");
+            compileexp(&g, test->u.check_error, te, 1);
+            emit(&g, 1, "errorfailed(%s, t%d);\n", qe, te);
+            emit(&g, 1, "return 0;\n");
+            free(qe);
+        }
+        break;
+    default:
+        assert(0);
+    }
+    emit(&g, 1, "return 1;\n");
+    writefunction(out, header, &g);
+}
+
+static void compilestep(FILE *out, Step *s, int n) {
+    Gen g = newgen(NULL);
+    char header[64];
+
+    snprintf(header, sizeof(header), "static void step%d(void)", n);
+    switch (s->alt) {
+    case STEPDEF:
+        {
+            Def d = s->def;
+            int t = d->alt == DEFINE ? -1 : newtemp(&g);
+            switch (d->alt) {
+            case VAL:
+                {
+                    int k = globalnum(d->u.val.name);
+                    char *cx = cname(d->u.val.name);
+                    compileexp(&g, d->u.val.exp, t, 1);
+                    emit(&g, 1, "g%d_%s = t%d;\n", k, cx, t);
+                    emit(&g, 1, "bound%d = 1;\n", k);
+                    free(cx);
+                }
+                break;
+            case EXP:
+                {
+                    int k = globalnum(strtoname("it"));
+                    compileexp(&g, d->u.exp, t, 1);
+                    emit(&g, 1, "g%d_it = t%d;\n", k, t);
+                    emit(&g, 1, "bound%d = 1;\n", k);
+                }
+                break;
+            case DEFINE:
+                {
+                    Name f = d->u.define.name;
+                    int k = funnum(f);
+                    int n = lengthNL(d->u.define.userfun.formals);
+                    char *cf = cname(f);
+                    if (funinfo[k].ndefs > 1)
+                        emit(&g, 1, "fn%d = (void (*)(void)) f%d_%s_%d;\n",
+                                    k, k, cf, s->version);
+                    else
+                        emit(&g, 1, "fn%d = (void (*)(void)) f%d_%s;\n",
+                                    k, k, cf);
+                    emit(&g, 1, "arity%d = %d;\n", k, n);
+                    free(cf);
+                }
+                break;
+            }
+            if (s->echo && d->alt == DEFINE) {
+                char *qf = quotename(d->u.define.name);
+                emit(&g, 1, "echoname(%s);\n", qf);
+                free(qf);
+            } else if (s->echo) {
+                emit(&g, 1, "printline(t%d);\n", t);
+            }
+        }
+        break;
+    case STEPTEST:
+        emit(&g, 1, "pending[npending++] = %d;\n", s->test);
+        break;
+    case BEGINUSE:
+        emit(&g, 1, "bases[%d] = npending;\n", s->level + 1);
+        break;
+    case ENDUSE:
+        emit(&g, 1, "runtests(bases[%d]);\n", s->level);
+        break;
+    case BADUSE:
+        {
+            char *qf = cstring(nametostr(s->file));
+            emit(&g, 1, "cannotopen(%s);\n", qf);
+            free(qf);
+        }
+        break;
+    case ENDPROGRAM:
+        emit(&g, 1, "runtests(0);\n");
+        break;
+    }
+    writefunction(out, header, &g);
+}
+/* compile.c: the run-time system */
+/*
+ * These lines begin every compiled program.  They repeat what the
+ * interpreter does on errors, on arithmetic, and in unit tests, so the
+ * compiled program's output matches, message for message.  Few programs
+ * use every helper, so the helpers, like the globals and functions
+ * declared for a particular program, are marked [[UNUSED]].  A function
+ * that always calls itself is the Impcore program's business, and
+ * [[checkstack]] ends it as the interpreter would, so GCC is told not
+ * to warn about it.  The compiled program then builds cleanly with
+ * [[-Wall -Wextra -Werror]].
+ */
+static const char *runtime[] = {
+    "#include <setjmp.h>",
+    "#include <stdarg.h>",
+    "#include <stdint.h>",
+    "#include <stdio.h>",
+    "#include <stdlib.h>",
+    "",
+    "#ifdef __GNUC__",
+    "#define UNUSED __attribute__((unused))",
+    "#else",
+    "#define UNUSED",
+    "#endif",
+    "#define HELPER static UNUSED",
+    "#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12",
+    "#pragma GCC diagnostic ignored \"-Winfinite-recursion\"",
+    "#endif",
+    "",
+    "typedef int32_t Value;",
+    "",
+    "static jmp_buf errorjmp, testjmp;",
+    "static int testing;",
+    "static char errormsg[4096];",
+    "static char *low_water_mark;",
+    "",
+    "HELPER void runerror(const char *fmt, ...) {",
+    "    va_list ap;",
+    "    va_start(ap, fmt);",
+    "    vsnprintf(errormsg, sizeof(errormsg), fmt, ap);",
+    "    va_end(ap);",
+    "    if (testing)",
+    "        longjmp(testjmp, 1);",
+    "    fflush(stdout);",
+    "    fprintf(stderr, \"Run-time error: %s\\n\", errormsg);",
+    "    fflush(stderr);",
+    "    longjmp(errorjmp, 1);",
+    "}",
+    "",
+    "HELPER void checkstack(void) {",
+    "    char c;",
+    "    if (low_water_mark - &c >= (long) (1000000 * sizeof(char *)))",
+    "        runerror(\"recursion too deep\");",
+    "}",
+    "",
+    "HELPER void unbound(const char *x) {",
+    "    runerror(\"unbound variable %s\", x);",
+    "}",
+    "",
+    "HELPER void unboundset(const char *x, const char *e) {",
+    "    runerror(\"tried to set unbound variable %s in %s\", x, e);",
+    "}",
+    "",
+    "HELPER void undefined(const char *f, const char *e) {",
+    "    runerror(\"call to undefined function %s in %s\", f, e);",
+    "}",
+    "",
+    "HELPER void argcerror(const char *e, int expected, int actual) {",
+    "    runerror(\"in %s, expected %d argument%s but found %d\",",
+    "             e, expected, expected == 1 ? \"\" : \"s\", actual);",
+    "}",
+    "",
+    "HELPER void cannotopen(const char *filename) {",
+    "    runerror(\"cannot open file \\\"%s\\\"\", filename);",
+    "}",
+    "",
+    "HELPER Value checked(int64_t result) {",
+    "    if (result < INT32_MIN || result > INT32_MAX)",
+    "        runerror(\"Arithmetic overflow\");",
+    "    return (Value) result;",
+    "}",
+    "",
+    "HELPER Value add(Value x, Value y) { return checked((int64_t) x + y); }",
+    "HELPER Value sub(Value x, Value y) { return checked((int64_t) x - y); }",
+    "HELPER Value mul(Value x, Value y) { return checked((int64_t) x * y); }",
+    "",
+    "HELPER Value divide(Value x, Value y, const char *e) {",
+    "    if (y == 0)",
+    "        runerror(\"division by zero in %s\", e);",
+    "    return checked((int64_t) x / y);",
+    "}",
+    "",
+    "typedef struct { Value *elems; int size; } Array;",
+    "static Array *arrays;",
+    "static int narrays, maxarrays;",
+    "",
+    "HELPER Value makearray(Value size, Value init, const char *e) {",
+    "    Value *elems = NULL;",
+    "    int i;",
+    "    if (size >= 0 && size <= INT32_MAX / 8)",
+    "        elems = malloc(size > 0 ? size * sizeof(*elems) : 1);",
+    "    if (elems == NULL)",
+    "        runerror(\"in %s, cannot make an array of size %d\", e, (int) size);",
+    "    for (i = 0; i < size; i++)",
+    "        elems[i] = init;",
+    "    if (narrays + 1 >= maxarrays) {",
+    "        maxarrays = maxarrays ? 2 * maxarrays : 64;",
+    "        arrays = realloc(arrays, maxarrays * sizeof(*arrays));",
+    "        if (arrays == NULL)",
+    "            abort();",
+    "    }",
+    "    narrays++;",
+    "    arrays[narrays].elems = elems;",
+    "    arrays[narrays].size = size;",
+    "    return narrays;",
+    "}",
+    "",
+    "HELPER Array *findarray(Value a, const char *e) {",
+    "    if (a < 1 || a > narrays)",
+    "        runerror(\"in %s, %d is not an array\", e, (int) a);",
+    "    return &arrays[a];",
+    "}",
+    "",
+    "HELPER Value *arrayelem(Value a, Value i, const char *e) {",
+    "    Array *array = findarray(a, e);",
+    "    if (i < 0 || i >= array->size)",
+    "        runerror(\"in %s, index %d is out of bounds for an array of size %d\",",
+    "                 e, (int) i, array->size);",
+    "    return &array->elems[i];",
+    "}",
+    "",
+    "HELPER Value printvalue(Value v) {",
+    "    printf(\"%d\", (int) v);",
+    "    fflush(stdout);",
+    "    return v;",
+    "}",
+    "",
+    "HELPER Value printline(Value v) {",
+    "    printf(\"%d\\n\", (int) v);",
+    "    fflush(stdout);",
+    "    return v;",
+    "}",
+    "",
+    "HELPER void echoname(const char *x) {",
+    "    printf(\"%s\\n\", x);",
+    "    fflush(stdout);",
+    "}",
+    "",
+    "HELPER Value printutf8(Value v) {",
+    "    unsigned code_point = v;",
+    "    if ((code_point & 0x1fffff) != code_point)",
+    "        runerror(\"%d does not represent a Unicode code point\", (int) v);",
+    "    if (code_point > 0xffff) {",
+    "        putchar(0xf0 |  (code_point >> 18));",
+    "        putchar(0x80 | ((code_point >> 12) & 0x3f));",
+    "        putchar(0x80 | ((code_point >>  6) & 0x3f));",
+    "        putchar(0x80 | ((code_point      ) & 0x3f));",
+    "    } else if (code_point > 0x7ff) {",
+    "        putchar(0xe0 |  (code_point >> 12));",
+    "        putchar(0x80 | ((code_point >>  6) & 0x3f));",
+    "        putchar(0x80 | ((code_point      ) & 0x3f));",
+    "    } else if (code_point > 0x7f) {",
+    "        putchar(0xc0 |  (code_point >>  6));",
+    "        putchar(0x80 |  (code_point & 0x3f));",
+    "    } else {",
+    "        putchar(code_point);",
+    "    }",
+    "    return v;",
+    "}",
+    "",
+    "HELPER void expecterror(const char *check, const char *expect,",
+    "                        const char *culprit) {",
+    "    fprintf(stderr, \"Check-expect failed: expected %s to evaluate to the \"",
+    "                    \"same value as %s, but evaluating %s causes an error: \"",
+    "                    \"%s.\\n\", check, expect, culprit, errormsg);",
+    "}",
+    "",
+    "HELPER void expectfailed(const char *check, const char *expect,",
+    "                         Value expected, Value actual) {",
+    "    fprintf(stderr, \"Check-expect failed: expected %s to evaluate to %d\",",
+    "            check, (int) expected);",
+    "    if (expect != NULL)",
+    "        fprintf(stderr, \" (from evaluating %s)\", expect);",
+    "    fprintf(stderr, \", but it's %d.\\n\", (int) actual);",
+    "}",
+    "",
+    "HELPER void asserterror(const char *e) {",
+    "    fprintf(stderr, \"Check-assert failed: evaluating %s causes an error: \"",
+    "                    \"%s.\\n\", e, errormsg);",
+    "}",
+    "",
+    "HELPER void assertfailed(const char *e) {",
+    "    fprintf(stderr, \"Check-assert failed: %s evaluated to 0.\\n\", e);",
+    "}",
+    "",
+    "HELPER void errorfailed(const char *e, Value v) {",
+    "    fprintf(stderr, \"Check-error failed: evaluating %s was expected to \"",
+    "                    \"produce an error, but instead it produced the value \"",
+    "                    \"%d.\\n\", e, (int) v);",
+    "}",
+    "",
+    "HELPER void report(int npassed, int ntests) {",
+    "    switch (ntests) {",
+    "    case 0: break;",
+    "    case 1:",
+    "        if (npassed == 1)",
+    "            printf(\"The only test passed.\\n\");",
+    "        else",
+    "            printf(\"The only test failed.\\n\");",
+    "        break;",
+    "    case 2:",
+    "        switch (npassed) {",
+    "        case 0: printf(\"Both tests failed.\\n\"); break;",
+    "        case 1: printf(\"One of two tests passed.\\n\"); break;",
+    "        default: printf(\"Both tests passed.\\n\"); break;",
+    "        }",
+    "        break;",
+    "    default:",
+    "        if (npassed == ntests)",
+    "            printf(\"All %d tests passed.\\n\", ntests);",
+    "        else if (npassed == 0)",
+    "            printf(\"All %d tests failed.\\n\", ntests);",
+    "        else",
+    "            printf(\"%d of %d tests passed.\\n\", npassed, ntests);",
+    "        break;",
+    "    }",
+    "}",
+    "",
+    NULL
+};
+/*
+ * The pending tests of every file being read are kept in one array;
+ * [[bases[i]]] is where the tests of the file at level [[i]] begin.
+ * A file's tests run when its last item has run.
+ */
+static const char *runtests[] = {
+    "static void runtests(int base) {",
+    "    int i, npassed = 0;",
+    "    testing = 1;",
+    "    for (i = base; i < npending; i++)",
+    "        npassed += tests[pending[i]]();",
+    "    testing = 0;",
+    "    report(npassed, npending - base);",
+    "    npending = base;",
+    "}",
+    "",
+    NULL
+};
+
+static const char *mainfunction[] = {
+    "int main(void) {",
+    "    static int i;",
+    "    char c;",
+    "",
+    "    low_water_mark = &c;",
+    "    if (setjmp(errorjmp)) {",
+    "        i = resume[i];",
+    "        npending = 0;",
+    "    }",
+    "    for ( ; i < NSTEPS; i++)",
+    "        steps[i]();",
+    "    return 0;",
+    "}",
+    NULL
+};
+
+static void writelines(FILE *out, const char **lines) {
+    for ( ; *lines; lines++)
+        fprintf(out, "%s\n", *lines);
+}
+/* compile.c: compiling a program */
+void compileprogram(XDefstream basis, XDefstream xdefs, Funenv functions,
+                                                                   FILE *out) {
+    Namelist xs;
+    int i, k;
+
+    if (arithmetic != ARITH32) {
+        fprintf(stderr, "impcore: compiled programs have only 32-bit "
+                        "integers\n");
+        exit(1);
+    }
+    primitives = functions;
+    globalnums = mkValenv(NULL, NULL);
+    funnums    = mkValenv(NULL, NULL);
+    globalnum(strtoname("it"));
+    collect(basis, -1, false);
+    collect(xdefs, 0, true);
+    addstep(ENDPROGRAM, 0, true);
+
+    // the functions, tests, and steps are compiled first, to a
+    // temporary file, so that every global has been numbered before
+    // the declarations are written
+    FILE *body = tmpfile();
+    assert(body != NULL);
+    for (i = 0; i < program.nsteps; i++) {
+        Step *s = &program.steps[i];
+        if (s->alt == STEPDEF && s->def->alt == DEFINE)
+            compilefunction(body, s->def, s->version);
+    }
+    for (i = 0; i < program.ntests; i++)
+        compiletest(body, program.tests[i], i);
+    for (i = 0; i < program.nsteps; i++)
+        compilestep(body, &program.steps[i], i);
+
+    fprintf(out, "/* compiled from Impcore by impcore -c */\n");
+    writelines(out, runtime);
+    for (xs = globalnames, k = nglobals - 1; xs; xs = xs->tl, k--) {
+        char *cx = cname(xs->hd);
+        fprintf(out, "static UNUSED Value g%d_%s;\n", k, cx);
+        fprintf(out, "static UNUSED int bound%d;\n", k);
+        free(cx);
+    }
+    fprintf(out, "\n");
+    for (xs = funnames, k = nfuns - 1; xs; xs = xs->tl, k--) {
+        fprintf(out, "static UNUSED int arity%d = -1;\n", k);
+        fprintf(out, "static UNUSED void (*fn%d)(void);\n", k);
+    }
+    for (i = 0; i < program.nsteps; i++) {
+        Step *s = &program.steps[i];
+        if (s->alt == STEPDEF && s->def->alt == DEFINE) {
+            char *header = fundeclarator(s->def->u.define.name, s->version,
+                                         s->def->u.define.userfun.formals);
+            fprintf(out, "%s;\n", header);
+            free(header);
+        }
+    }
+    fprintf(out, "\n");
+    for (i = 0; i < program.ntests; i++)
+        fprintf(out, "static int test%d(void);\n", i);
+    fprintf(out, "static int (*const tests[])(void) = {");
+    for (i = 0; i < program.ntests; i++)
+        fprintf(out, " test%d,", i);
+    fprintf(out, " NULL };\n");
+    fprintf(out, "static int pending[%d], npending;\n", program.ntests + 1);
+    fprintf(out, "static UNUSED int bases[%d];\n\n", program.maxlevel + 2);
+    writelines(out, runtests);
+
+    rewind(body);
+    for (int c; (c = getc(body)) != EOF; )
+        putc(c, out);
+    fclose(body);
+
+    fprintf(out, "#define NSTEPS %d\n", program.nsteps);
+    fprintf(out, "static void (*const steps[])(void) = {\n");
+    for (i = 0; i < program.nsteps; i++)
+        fprintf(out, "    step%d,\n", i);
+    fprintf(out, "};\n");
+    // after an error, resume with the next item from standard input
+    {   int *resume = malloc(program.nsteps * sizeof(*resume));
+        int next = program.nsteps;
+        assert(resume != NULL);
+        for (i = program.nsteps - 1; i >= 0; i--) {
+            resume[i] = next;
+            if (program.steps[i].level == 0)
+                next = i;
+        }
+        fprintf(out, "static const int resume[] = {\n");
+        for (i = 0; i < program.nsteps; i++)
+            fprintf(out, "    %d,\n", resume[i]);
+        fprintf(out, "};\n\n");
+        free(resume);
+    }
+    writelines(out, mainfunction);
+}
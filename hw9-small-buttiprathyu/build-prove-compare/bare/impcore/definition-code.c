@@ -3,7 +3,12 @@ Userfun mkUserfun(Namelist formals, Exp body) {
     Userfun n;
     
     n.formals = formals;
+    n.locals = NULL;
     n.body = body;
+    n.code = NULL;
+    n.nformals = lengthNL(formals);
+    n.nlocals = 0;
+    bindslots(body, formals, NULL);
     return n;
 }
 
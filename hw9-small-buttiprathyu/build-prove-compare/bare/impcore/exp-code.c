@@ -6,6 +6,7 @@ Exp mkLiteral(Value literal) {
     
     n->alt = LITERAL;
     n->u.literal = literal;
+    n->source = NULL;
     return n;
 }
 
@@ -16,6 +17,9 @@ Exp mkVar(Name var) {
     
     n->alt = VAR;
     n->u.var = var;
+    n->slot.val = NULL;
+    n->index = -1;
+    n->source = NULL;
     return n;
 }
 
@@ -27,6 +31,9 @@ Exp mkSet(Name name, Exp exp) {
     n->alt = SET;
     n->u.set.name = name;
     n->u.set.exp = exp;
+    n->slot.val = NULL;
+    n->index = -1;
+    n->source = NULL;
     return n;
 }
 
@@ -39,6 +46,7 @@ Exp mkIfx(Exp cond, Exp truex, Exp falsex) {
     n->u.ifx.cond = cond;
     n->u.ifx.truex = truex;
     n->u.ifx.falsex = falsex;
+    n->source = NULL;
     return n;
 }
 
@@ -50,6 +58,7 @@ Exp mkWhilex(Exp cond, Exp exp) {
     n->alt = WHILEX;
     n->u.whilex.cond = cond;
     n->u.whilex.exp = exp;
+    n->source = NULL;
     return n;
 }
 
@@ -60,6 +69,7 @@ Exp mkBegin(Explist begin) {
     
     n->alt = BEGIN;
     n->u.begin = begin;
+    n->source = NULL;
     return n;
 }
 
@@ -71,6 +81,8 @@ Exp mkApply(Name name, Explist actuals) {
     n->alt = APPLY;
     n->u.apply.name = name;
     n->u.apply.actuals = actuals;
+    n->slot.fun = NULL;
+    n->source = NULL;
     return n;
 }
 
@@ -79,6 +91,7 @@ struct Exp mkLiteralStruct(Value literal) {
     
     n.alt = LITERAL;
     n.u.literal = literal;
+    n.source = NULL;
     return n;
 }
 
@@ -87,6 +100,9 @@ struct Exp mkVarStruct(Name var) {
     
     n.alt = VAR;
     n.u.var = var;
+    n.slot.val = NULL;
+    n.index = -1;
+    n.source = NULL;
     return n;
 }
 
@@ -96,6 +112,9 @@ struct Exp mkSetStruct(Name name, Exp exp) {
     n.alt = SET;
     n.u.set.name = name;
     n.u.set.exp = exp;
+    n.slot.val = NULL;
+    n.index = -1;
+    n.source = NULL;
     return n;
 }
 
@@ -106,6 +125,7 @@ struct Exp mkIfxStruct(Exp cond, Exp truex, Exp falsex) {
     n.u.ifx.cond = cond;
     n.u.ifx.truex = truex;
     n.u.ifx.falsex = falsex;
+    n.source = NULL;
     return n;
 }
 
@@ -115,6 +135,7 @@ struct Exp mkWhilexStruct(Exp cond, Exp exp) {
     n.alt = WHILEX;
     n.u.whilex.cond = cond;
     n.u.whilex.exp = exp;
+    n.source = NULL;
     return n;
 }
 
@@ -123,6 +144,7 @@ struct Exp mkBeginStruct(Explist begin) {
     
     n.alt = BEGIN;
     n.u.begin = begin;
+    n.source = NULL;
     return n;
 }
 
@@ -132,6 +154,8 @@ struct Exp mkApplyStruct(Name name, Explist actuals) {
     n.alt = APPLY;
     n.u.apply.name = name;
     n.u.apply.actuals = actuals;
+    n.slot.fun = NULL;
+    n.source = NULL;
     return n;
 }
 
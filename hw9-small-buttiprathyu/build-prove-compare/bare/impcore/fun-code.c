@@ -7,11 +7,12 @@ Fun mkUserdef(Userfun userdef) {
     return n;
 }
 
-Fun mkPrimitive(Name primitive) {
+Fun mkPrimitive(Name name, Primop op) {
     Fun n;
     
     n.alt = PRIMITIVE;
-    n.u.primitive = primitive;
+    n.u.primitive.name = name;
+    n.u.primitive.op = op;
     return n;
 }
 
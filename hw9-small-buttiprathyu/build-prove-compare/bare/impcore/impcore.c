@@ -1,9 +1,25 @@
 #include "all.h"
 /* impcore.c S10b */
 bool read_tick_as_quote = false;
+/* impcore.c S134c: predefined functions, also compiled by [[-c]] */
+static const char *fundefs = 
+   
+     ";  predefined Impcore functions 24a \n"
+     "(define and (b c) (if b c b))\n"
+     "(define or  (b c) (if b b c))\n"
+     "(define not (b)   (if b 0 1))\n"
+     ";  predefined Impcore functions 24b \n"
+     "(define <= (x y) (not (> x y)))\n"
+     "(define >= (x y) (not (< x y)))\n"
+     "(define != (x y) (not (= x y)))\n"
+     ";  predefined Impcore functions 24c \n"
+     "(define mod (m n) (- m (* n (/ m n))))\n"
+     "(define negated (n) (- 0 n))\n";
 /* impcore.c S133a */
 int main(int argc, char *argv[]) {
-    bool interactive  = (argc <= 1) || (strcmp(argv[1], "-q") != 0);
+    bool compiling    = argc > 2 && strcmp(argv[1], "-c") == 0;
+    bool interactive  = !compiling &&
+                        ((argc <= 1) || (strcmp(argv[1], "-q") != 0));
     Prompts prompts  = interactive ? STD_PROMPTS : NO_PROMPTS;
     set_toplevel_error_format(interactive ? WITHOUT_LOCATIONS : WITH_LOCATIONS);
     if (getenv("NOERRORLOC")) set_toplevel_error_format(WITHOUT_LOCATIONS);
@@ -24,34 +40,27 @@ int main(int argc, char *argv[]) {
     installprinter('v', printvalue);
     installprinter('V', printvaluelist);
     installprinter('%', printpercent);
+    initarithmetic();
 
     Valenv globals   = mkValenv(NULL, NULL);
     Funenv functions = mkFunenv(NULL, NULL);
     /* install the initial basis in [[functions]] S134a */
     {
-        static const char *prims[] = 
-           { "+", "-", "*", "/", "<", ">", "=", "println", "print", "printu", 0
-                                                                              };
-        for (const char **p = prims; *p; p++) {
-            Name x = strtoname(*p);
-            bindfun(x, mkPrimitive(x), functions);
+        static const struct { const char *name; Primop op; } prims[] = {
+            { "+", ADD }, { "-", SUB }, { "*", MUL }, { "/", DIV },
+            { "<", LT }, { ">", GT }, { "=", EQ },
+            { "println", PRINTLN }, { "print", PRINT }, { "printu", PRINTU },
+            { "make-array", MKARRAY }, { "array-at", ARRAYAT },
+            { "array-put", ARRAYPUT }, { "array-size", ARRAYSIZE },
+            { NULL, ADD }
+        };
+        for (int i = 0; prims[i].name; i++) {
+            Name x = strtoname(prims[i].name);
+            bindfun(x, mkPrimitive(x, prims[i].op), functions);
         }
     }
     /* install the initial basis in [[functions]] S134c */
     {
-        const char *fundefs = 
-           
-             ";  predefined Impcore functions 24a \n"
-             "(define and (b c) (if b c b))\n"
-             "(define or  (b c) (if b b c))\n"
-             "(define not (b)   (if b 0 1))\n"
-             ";  predefined Impcore functions 24b \n"
-             "(define <= (x y) (not (> x y)))\n"
-             "(define >= (x y) (not (< x y)))\n"
-             "(define != (x y) (not (= x y)))\n"
-             ";  predefined Impcore functions 24c \n"
-             "(define mod (m n) (- m (* n (/ m n))))\n"
-             "(define negated (n) (- 0 n))\n";
         if (setjmp(errorjmp))
             assert(0); // if error in predefined function, die horribly
         readevalprint(stringxdefs("predefined functions", fundefs), globals,
@@ -59,10 +68,24 @@ int main(int argc, char *argv[]) {
     }
 
     XDefstream xdefs = filexdefs("standard input", stdin, prompts);
+    if (compiling) {
+        FILE *out = fopen(argv[2], "w");
+        if (out == NULL) {
+            fprintf(stderr, "impcore: cannot write %s\n", argv[2]);
+            return 1;
+        }
+        if (setjmp(errorjmp))
+            return 1;  // the error has been reported
+        compileprogram(stringxdefs("predefined functions", fundefs), xdefs,
+                                                                functions, out);
+        fclose(out);
+        return 0;
+    }
     extern void dump_fenv_names(Funenv); /*OMIT*/
     if (argv[1] && !strcmp(argv[1], "-names")) { dump_fenv_names(functions);
                                                              exit(0); } /*OMIT*/
 
+    initprofile();
     while (setjmp(errorjmp))
         ;
     readevalprint(xdefs, globals, functions, ECHOES);
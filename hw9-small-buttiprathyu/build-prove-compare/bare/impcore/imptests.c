@@ -25,8 +25,7 @@ TestResult test_result(UnitTest t, Valenv globals, Funenv functions) {
     switch (t->alt) {
     case CHECK_EXPECT:
         /* run [[check-expect]] test [[t]], returning [[TestResult]] S137b */
-        {   Valenv empty_env = mkValenv(NULL, NULL);
-            if (setjmp(testjmp)) {
+        {   if (setjmp(testjmp)) {
 
 /* report that evaluating [[t->u.check_expect.check]] failed with an error S138d */
                 fprint(stderr,
@@ -39,8 +38,8 @@ TestResult test_result(UnitTest t, Valenv globals, Funenv functions) {
                 bufreset(errorbuf);
                 return TEST_FAILED;
             }
-            Value check = eval(t->u.check_expect.check, globals, functions,
-                                                                     empty_env);
+            Value check = holdnumber(eval(t->u.check_expect.check, globals,
+                                                                   functions));
 
             if (setjmp(testjmp)) {
 
@@ -53,10 +52,11 @@ TestResult test_result(UnitTest t, Valenv globals, Funenv functions) {
                                                                                ,
                                t->u.check_expect.expect, bufcopy(errorbuf));
                 bufreset(errorbuf);
+                releasenumber(check);
                 return TEST_FAILED;
             }
-            Value expect = eval(t->u.check_expect.expect, globals, functions,
-                                                                     empty_env);
+            Value expect = eval(t->u.check_expect.expect, globals, functions);
+            releasenumber(check);
 
             if (check != expect) {
                 /* report failure because the values are not equal S138c */
@@ -74,8 +74,7 @@ TestResult test_result(UnitTest t, Valenv globals, Funenv functions) {
         }
     case CHECK_ASSERT:
         /* run [[check-assert]] test [[t]], returning [[TestResult]] S138a */
-        {   Valenv empty_env = mkValenv(NULL, NULL);
-            if (setjmp(testjmp)) {
+        {   if (setjmp(testjmp)) {
 
    /* report that evaluating [[t->u.check_assert]] failed with an error S139a */
                 fprint(stderr,
@@ -84,7 +83,7 @@ TestResult test_result(UnitTest t, Valenv globals, Funenv functions) {
                 bufreset(errorbuf);
                 return TEST_FAILED;
             }
-            Value v = eval(t->u.check_assert, globals, functions, empty_env);
+            Value v = eval(t->u.check_assert, globals, functions);
 
             if (v == 0) {
                 /* report failure because the value is zero S138f */
@@ -97,12 +96,11 @@ TestResult test_result(UnitTest t, Valenv globals, Funenv functions) {
         }
     case CHECK_ERROR:
         /* run [[check-error]] test [[t]], returning [[TestResult]] S138b */
-        {   Valenv empty_env = mkValenv(NULL, NULL);
-            if (setjmp(testjmp)) {
+        {   if (setjmp(testjmp)) {
                 bufreset(errorbuf);
                 return TEST_PASSED; // error occurred, so the test passed
             }
-            Value check = eval(t->u.check_error, globals, functions, empty_env);
+            Value check = eval(t->u.check_error, globals, functions);
 
       /* report that evaluating [[t->u.check_error]] produced [[check]] S139b */
             fprint(stderr,
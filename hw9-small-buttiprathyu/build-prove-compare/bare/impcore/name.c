@@ -9,14 +9,52 @@ const char* nametostr(Name np) {
     return np->s;
 }
 /* name.c S135c */
+/*
+ * Names are interned in a hash table, so that finding a name costs the
+ * same however many names there are.
+ */
+static struct {
+    Name *names;
+    unsigned size, used;     // size is a power of 2
+} all_names;
+
+static unsigned hashstring(const char *s) {
+    unsigned h = 5381;
+    for ( ; *s; s++)
+        h = 33 * h + (unsigned char)*s;
+    return h;
+}
+
+static void addname(Name np) {  // np is not in all_names
+    unsigned i;
+
+    if (2 * (all_names.used + 1) > all_names.size) {  // grow and rehash
+        Name *names = all_names.names;
+        unsigned j, n = all_names.size;
+        all_names.size  = n ? 2 * n : 1024;
+        all_names.names = calloc(all_names.size, sizeof(*all_names.names));
+        assert(all_names.names != NULL);
+        all_names.used = 0;
+        for (j = 0; j < n; j++)
+            if (names[j] != NULL)
+                addname(names[j]);
+        free(names);
+    }
+    for (i = hashstring(np->s) & (all_names.size - 1);
+         all_names.names[i] != NULL; i = (i + 1) & (all_names.size - 1))
+        ;
+    all_names.names[i] = np;
+    all_names.used++;
+}
+
 Name strtoname(const char *s) {
-    static Namelist all_names;
     assert(s != NULL);
 
-    for (Namelist unsearched = all_names; unsearched; unsearched = unsearched->
-                                                                             tl)
-        if (strcmp(s, unsearched->hd->s) == 0)
-            return unsearched->hd;
+    if (all_names.size > 0)
+        for (unsigned i = hashstring(s) & (all_names.size - 1);
+             all_names.names[i] != NULL; i = (i + 1) & (all_names.size - 1))
+            if (strcmp(s, all_names.names[i]->s) == 0)
+                return all_names.names[i];
 
     /* allocate a new name, add it to [[all_names]], and return it S135d */
     Name np = malloc(sizeof(*np));
@@ -24,6 +62,6 @@ Name strtoname(const char *s) {
     np->s = malloc(strlen(s) + 1);
     assert(np->s != NULL);
     strcpy((char*)np->s, s);
-    all_names = mkNL(np, all_names);
+    addname(np);
     return np;
 }
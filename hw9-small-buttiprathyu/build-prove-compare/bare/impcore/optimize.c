@@ -0,0 +1,493 @@
+#include "all.h"
+/* optimize.c: optimizing function bodies */
+/*
+ * When a function is defined, [[eval]] has [[optimize]] rewrite its
+ * body, and the evaluators run the rewritten body:
+ *
+ *   - A call to an arithmetic or comparison primitive whose actuals are
+ *     literals becomes a literal, unless the primitive would fail, so
+ *     overflow and division by zero are still run-time errors.  An [[if]]
+ *     or [[while]] whose condition is a literal becomes the branch taken.
+ *   - A call to a small function that does not call itself becomes the
+ *     function's body.  The actuals are evaluated in order into new
+ *     slots of the caller's activation record, which stand for the
+ *     callee's formals, but a literal actual is substituted for a formal
+ *     that the body never sets.
+ *   - A call of the function to itself in tail position becomes
+ *     assignments to its formals, and the body becomes a loop, so the
+ *     call uses no C stack.
+ *
+ * Which names denote primitives and small functions is settled when the
+ * body is optimized.  So when such a name is redefined, [[eval]] makes
+ * every optimized body stale, and it optimizes the original again
+ * before the next call.  The original is never changed: a rewritten
+ * node is new, and it remembers the node it was made from, which is
+ * what error messages print.
+ *
+ * If [[BPCOPTIONS]] holds [[nooptimize]], or while profiling, a body is
+ * run as written.
+ */
+#define INLINESIZE  12  /* nodes in the body of a function that is inlined */
+#define INLINEDEPTH 2   /* calls inlined into the body of an inlined call */
+
+typedef struct Optimizer {
+    Name f;             // the function being optimized
+    Userfun *fun;
+    Funenv functions;
+    int nslots;         // size of the activation record, with new slots
+    int depth;          // of inlined calls
+} Optimizer;
+
+static bool useoptimizer(void) {
+    static int use = -1;
+
+    if (use < 0)
+        use = bpcoption("nooptimize") == NULL;
+    return use && !profiling;
+}
+/* optimize.c: making nodes */
+static Exp from(Exp n, Exp e) {  // n, which is made from e
+    n->source = e->source != NULL ? e->source : e;
+    return n;
+}
+
+static Exp copy(Exp e) {
+    Exp n = malloc(sizeof(*n));
+
+    assert(n != NULL);
+    *n = *e;
+    return from(n, e);
+}
+
+static Exp slotvar(Name x, int index) {
+    Exp e = mkVar(x);
+
+    e->index = index;
+    return e;
+}
+
+static Exp slotset(Name x, int index, Exp exp) {
+    Exp e = mkSet(x, exp);
+
+    e->index = index;
+    return e;
+}
+/* optimize.c: what a body does */
+static int size(Exp e, Name f) {  // nodes in e, or more if e calls f
+    int n = 1;
+
+    switch (e->alt) {
+    case LITERAL:
+    case VAR:
+        return 1;
+    case SET:
+        return 1 + size(e->u.set.exp, f);
+    case IFX:
+        return 1 + size(e->u.ifx.cond, f) + size(e->u.ifx.truex, f) +
+                   size(e->u.ifx.falsex, f);
+    case WHILEX:
+        return 1 + size(e->u.whilex.cond, f) + size(e->u.whilex.exp, f);
+    case BEGIN:
+        for (Explist es = e->u.begin; es; es = es->tl)
+            n += size(es->hd, f);
+        return n;
+    case APPLY:
+        if (e->u.apply.name == f)
+            return INLINESIZE + 1;
+        for (Explist es = e->u.apply.actuals; es; es = es->tl)
+            n += size(es->hd, f);
+        return n;
+    }
+    assert(0);
+    return n;
+}
+
+bool inlinable(Name f, Userfun *fun) {
+    return size(fun->body, f) <= INLINESIZE;
+}
+
+static bool touches(Exp e, int index, bool reading) {  // sets, or reads, slot
+    switch (e->alt) {
+    case LITERAL:
+        return false;
+    case VAR:
+        return reading && e->index == index;
+    case SET:
+        return e->index == index || touches(e->u.set.exp, index, reading);
+    case IFX:
+        return touches(e->u.ifx.cond,   index, reading) ||
+               touches(e->u.ifx.truex,  index, reading) ||
+               touches(e->u.ifx.falsex, index, reading);
+    case WHILEX:
+        return touches(e->u.whilex.cond, index, reading) ||
+               touches(e->u.whilex.exp,  index, reading);
+    case BEGIN:
+        for (Explist es = e->u.begin; es; es = es->tl)
+            if (touches(es->hd, index, reading))
+                return true;
+        return false;
+    case APPLY:
+        for (Explist es = e->u.apply.actuals; es; es = es->tl)
+            if (touches(es->hd, index, reading))
+                return true;
+        return false;
+    }
+    assert(0);
+    return false;
+}
+
+static bool touchesany(Explist es, int index) {
+    for ( ; es; es = es->tl)
+        if (touches(es->hd, index, true))
+            return true;
+    return false;
+}
+/* optimize.c: folding constants */
+/*
+ * [[fold]] returns the literal that a primitive computes, or NULL if
+ * the actuals aren't two literals or if the primitive would fail.
+ */
+static Exp fold(Exp e, Primop op, Explist actuals) {
+    Value x, y, z;
+    bool overflow;
+    char operation;
+
+    if (lengthEL(actuals) != 2 || actuals->hd->alt != LITERAL ||
+                                  actuals->tl->hd->alt != LITERAL)
+        return NULL;
+    x = actuals->hd->u.literal;
+    y = actuals->tl->hd->u.literal;
+    switch (op) {
+    case ADD:
+        operation = '+';
+        overflow = __builtin_add_overflow(x, y, &z);
+        break;
+    case SUB:
+        operation = '-';
+        overflow = __builtin_sub_overflow(x, y, &z);
+        break;
+    case MUL:
+        operation = '*';
+        overflow = __builtin_mul_overflow(x, y, &z);
+        break;
+    case DIV:
+        if (y == 0)
+            return NULL;
+        operation = '/';
+        overflow = x == INT64_MIN && y == -1;
+        z = overflow ? 0 : x / y;
+        break;
+    case LT:
+        return from(mkLiteral(compare(x, y) < 0), e);
+    case GT:
+        return from(mkLiteral(compare(x, y) > 0), e);
+    case EQ:
+        return from(mkLiteral(x == y), e);
+    default:
+        return NULL;
+    }
+    if (arithmetic != ARITHBIG && (overflow || z < smallmin || z > smallmax))
+        return NULL;
+    return from(mkLiteral(holdnumber(arith(operation, x, y))), e);
+}
+/* optimize.c: inlining */
+/*
+ * The body of an inlined function is copied, with each of its slots
+ * moved up by [[base]] into the caller's record, and with the literal
+ * in [[subst[i]]], if any, in place of slot [[i]].
+ */
+static Exp relocate(Exp e, int base, Exp *subst);
+
+static Explist relocatelist(Explist es, int base, Exp *subst) {
+    if (es == NULL)
+        return NULL;
+    return mkEL(relocate(es->hd, base, subst),
+                relocatelist(es->tl, base, subst));
+}
+
+static Exp relocate(Exp e, int base, Exp *subst) {
+    Exp n;
+
+    if (e->alt == VAR && e->index >= 0 && subst[e->index] != NULL)
+        return subst[e->index];
+    n = copy(e);
+    switch (e->alt) {
+    case LITERAL:
+        return n;
+    case VAR:
+        if (e->index >= 0)
+            n->index = base + e->index;
+        return n;
+    case SET:
+        if (e->index >= 0)
+            n->index = base + e->index;
+        n->u.set.exp = relocate(e->u.set.exp, base, subst);
+        return n;
+    case IFX:
+        n->u.ifx.cond   = relocate(e->u.ifx.cond,   base, subst);
+        n->u.ifx.truex  = relocate(e->u.ifx.truex,  base, subst);
+        n->u.ifx.falsex = relocate(e->u.ifx.falsex, base, subst);
+        return n;
+    case WHILEX:
+        n->u.whilex.cond = relocate(e->u.whilex.cond, base, subst);
+        n->u.whilex.exp  = relocate(e->u.whilex.exp,  base, subst);
+        return n;
+    case BEGIN:
+        n->u.begin = relocatelist(e->u.begin, base, subst);
+        return n;
+    case APPLY:
+        n->u.apply.actuals = relocatelist(e->u.apply.actuals, base, subst);
+        return n;
+    }
+    assert(0);
+    return n;
+}
+
+static Exp simplify(Optimizer *o, Exp e);
+
+static Explist bindactuals(Namelist xs, Explist actuals, int slot, Exp *subst,
+                                                                Explist rest) {
+    if (actuals == NULL)
+        return rest;
+    rest = bindactuals(xs->tl, actuals->tl, slot + 1, subst + 1, rest);
+    if (*subst != NULL)
+        return rest;
+    return mkEL(slotset(xs->hd, slot, actuals->hd), rest);
+}
+
+static Exp inlinecall(Optimizer *o, Exp e, Userfun *g, Explist actuals) {
+    int base = o->nslots, i;
+    Exp *subst = calloc(g->nformals + g->nlocals + 1, sizeof(*subst));
+    Explist es, body;
+    Namelist xs;
+
+    assert(subst != NULL);
+    o->nslots += g->nformals + g->nlocals;
+    for (i = 0, es = actuals; es; es = es->tl, i++)
+        if (es->hd->alt == LITERAL && !touches(g->body, i, false))
+            subst[i] = es->hd;
+    o->depth++;
+    body = mkEL(simplify(o, relocate(g->body, base, subst)), NULL);
+    o->depth--;
+    for (i = g->nformals, xs = g->locals; xs; xs = xs->tl, i++)
+        body = mkEL(slotset(xs->hd, base + i, mkLiteral(0)), body);
+    body = bindactuals(g->formals, actuals, base, subst, body);
+    free(subst);
+    return from(mkBegin(body), e);
+}
+/* optimize.c: simplifying */
+/*
+ * [[simplify]] folds and inlines.  Where nothing changes, it returns
+ * the expression it was given.
+ */
+static Explist simplifylist(Optimizer *o, Explist es) {
+    Exp hd;
+    Explist tl;
+
+    if (es == NULL)
+        return NULL;
+    hd = simplify(o, es->hd);
+    tl = simplifylist(o, es->tl);
+    return hd == es->hd && tl == es->tl ? es : mkEL(hd, tl);
+}
+
+static Exp simplifycall(Optimizer *o, Exp e) {
+    Explist actuals = simplifylist(o, e->u.apply.actuals);
+    Name g = e->u.apply.name;
+    Fun *f = findfun(g, o->functions);
+    Exp n;
+
+    if (f != NULL && f->alt == PRIMITIVE &&
+                     (n = fold(e, f->u.primitive.op, actuals)) != NULL)
+        return n;
+    if (f != NULL && f->alt == USERDEF && g != o->f &&
+        o->depth < INLINEDEPTH && inlinable(g, &f->u.userdef) &&
+        lengthEL(actuals) == f->u.userdef.nformals)
+        return inlinecall(o, e, &f->u.userdef, actuals);
+    if (actuals == e->u.apply.actuals)
+        return e;
+    n = copy(e);
+    n->u.apply.actuals = actuals;
+    return n;
+}
+
+static Exp simplify(Optimizer *o, Exp e) {
+    Exp n, x, y, z;
+    Explist es;
+
+    switch (e->alt) {
+    case LITERAL:
+    case VAR:
+        return e;
+    case SET:
+        x = simplify(o, e->u.set.exp);
+        if (x == e->u.set.exp)
+            return e;
+        n = copy(e);
+        n->u.set.exp = x;
+        return n;
+    case IFX:
+        x = simplify(o, e->u.ifx.cond);
+        if (x->alt == LITERAL)
+            return simplify(o, x->u.literal != 0 ? e->u.ifx.truex
+                                                 : e->u.ifx.falsex);
+        y = simplify(o, e->u.ifx.truex);
+        z = simplify(o, e->u.ifx.falsex);
+        if (x == e->u.ifx.cond && y == e->u.ifx.truex && z == e->u.ifx.falsex)
+            return e;
+        n = copy(e);
+        n->u.ifx.cond   = x;
+        n->u.ifx.truex  = y;
+        n->u.ifx.falsex = z;
+        return n;
+    case WHILEX:
+        x = simplify(o, e->u.whilex.cond);
+        if (x->alt == LITERAL && x->u.literal == 0)
+            return from(mkLiteral(0), e);
+        y = simplify(o, e->u.whilex.exp);
+        if (x == e->u.whilex.cond && y == e->u.whilex.exp)
+            return e;
+        n = copy(e);
+        n->u.whilex.cond = x;
+        n->u.whilex.exp  = y;
+        return n;
+    case BEGIN:
+        es = simplifylist(o, e->u.begin);
+        if (es == e->u.begin)
+            return e;
+        n = copy(e);
+        n->u.begin = es;
+        return n;
+    case APPLY:
+        return simplifycall(o, e);
+    }
+    assert(0);
+    return e;
+}
+/* optimize.c: self tail calls */
+/*
+ * A body that calls its own function in tail position, with the right
+ * number of actuals, becomes
+ *
+ *   (begin (set again 1)
+ *          (while again (begin (set again 0) (set result body')))
+ *          result)
+ *
+ * where [[again]] and [[result]] are new slots, and in [[body']], each
+ * such call computes its actuals into new slots, then assigns them to
+ * the formals, zeroes the locals, and sets [[again]].
+ */
+static bool tailcalls(Optimizer *o, Exp e) {
+    Explist es;
+
+    switch (e->alt) {
+    case IFX:
+        return tailcalls(o, e->u.ifx.truex) || tailcalls(o, e->u.ifx.falsex);
+    case BEGIN:
+        for (es = e->u.begin; es && es->tl; es = es->tl)
+            ;
+        return es != NULL && tailcalls(o, es->hd);
+    case APPLY:
+        return e->u.apply.name == o->f &&
+               lengthEL(e->u.apply.actuals) == o->fun->nformals;
+    default:
+        return false;
+    }
+}
+
+static void append(Explist **tailp, Exp e) {
+    **tailp = mkEL(e, NULL);
+    *tailp = &(**tailp)->tl;
+}
+/*
+ * An actual is assigned to its formal as soon as it is computed, unless
+ * a later actual uses the formal.  Then it is computed into a new slot,
+ * which is assigned to the formal after the last actual.
+ */
+static Exp jump(Optimizer *o, Exp e, int again) {  // e is a self tail call
+    Explist first = NULL, last = NULL, es;
+    Explist *firstp = &first, *lastp = &last;
+    Namelist xs;
+    int i;
+
+    for (i = 0, xs = o->fun->formals, es = e->u.apply.actuals; es;
+                                       i++, xs = xs->tl, es = es->tl) {
+        Exp x = es->hd;
+        bool later = touchesany(es->tl, i);
+
+        if (x->alt == VAR && x->index == i && !later)
+            continue;  // the formal keeps its value
+        else if (!later)
+            append(&firstp, slotset(xs->hd, i, x));
+        else if (x->alt == LITERAL)
+            append(&lastp, slotset(xs->hd, i, x));
+        else {
+            int t = o->nslots++;
+
+            append(&firstp, slotset(xs->hd, t, x));
+            append(&lastp, slotset(xs->hd, i, slotvar(xs->hd, t)));
+        }
+    }
+    for (i = o->fun->nformals, xs = o->fun->locals; xs; xs = xs->tl, i++)
+        append(&lastp, slotset(xs->hd, i, mkLiteral(0)));
+    append(&lastp, slotset(strtoname("again"), again, mkLiteral(1)));
+    *firstp = last;
+    return from(mkBegin(first), e);
+}
+
+static Exp loop(Optimizer *o, Exp e, int again);  // rewrites tail calls
+
+static Explist looplast(Optimizer *o, Explist es, int again) {
+    if (es->tl == NULL)
+        return mkEL(loop(o, es->hd, again), NULL);
+    return mkEL(es->hd, looplast(o, es->tl, again));
+}
+
+static Exp loop(Optimizer *o, Exp e, int again) {
+    Exp n;
+
+    if (!tailcalls(o, e))
+        return e;
+    switch (e->alt) {
+    case IFX:
+        n = copy(e);
+        n->u.ifx.truex  = loop(o, e->u.ifx.truex,  again);
+        n->u.ifx.falsex = loop(o, e->u.ifx.falsex, again);
+        return n;
+    case BEGIN:
+        n = copy(e);
+        n->u.begin = looplast(o, e->u.begin, again);
+        return n;
+    case APPLY:
+        return jump(o, e, again);
+    default:
+        assert(0);
+        return e;
+    }
+}
+/* optimize.c: optimizing a body */
+/*
+ * [[optimize]] returns the body to run in place of [[fun->body]], and
+ * in [[*nslots]], the size of the activation record it needs.
+ */
+Exp optimize(Name f, Userfun *fun, Funenv functions, int *nslots) {
+    Optimizer o = { f, fun, functions, fun->nformals + fun->nlocals, 0 };
+    Exp body = fun->body;
+
+    if (useoptimizer()) {
+        body = simplify(&o, body);
+        if (tailcalls(&o, body)) {
+            Name again = strtoname("again"), result = strtoname("result");
+            int a = o.nslots++, r = o.nslots++;
+            Exp iterate = mkBegin(mkEL(slotset(again, a, mkLiteral(0)),
+                                  mkEL(slotset(result, r, loop(&o, body, a)),
+                                  NULL)));
+
+            body = from(mkBegin(mkEL(slotset(again, a, mkLiteral(1)),
+                                mkEL(mkWhilex(slotvar(again, a), iterate),
+                                mkEL(slotvar(result, r), NULL)))), fun->body);
+        }
+    }
+    *nslots = o.nslots;
+    return body;
+}
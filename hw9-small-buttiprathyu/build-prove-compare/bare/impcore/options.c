@@ -0,0 +1,31 @@
+#include "all.h"
+/* options.c: reading [[BPCOPTIONS]] */
+/*
+ * [[BPCOPTIONS]] holds options separated by commas or spaces, like
+ * [[bignum,nothrottle,profile=fib.folded]].  [[bpcoption]] returns the
+ * value of the named option---the text after [[=]], or the empty
+ * string if there is none---or [[NULL]] if the option is absent.  Only
+ * a whole option matches, so [[noprofile]] does not turn on
+ * [[profile]].  Each option is read once, so a value is never freed.
+ */
+const char *bpcoption(const char *name) {
+    const char *options = getenv("BPCOPTIONS");
+    size_t n = strlen(name);
+    const char *p, *end;
+
+    if (options == NULL)
+        return NULL;
+    for (p = options; *p != '\0'; p = *end != '\0' ? end + 1 : end) {
+        end = p + strcspn(p, ", ");
+        if ((size_t) (end - p) >= n && strncmp(p, name, n) == 0 &&
+                                       (p + n == end || p[n] == '=')) {
+            const char *v = p + n == end ? end : p + n + 1;
+            char *value = malloc(end - v + 1);
+            assert(value != NULL);
+            memcpy(value, v, end - v);
+            value[end - v] = '\0';
+            return value;
+        }
+    }
+    return NULL;
+}
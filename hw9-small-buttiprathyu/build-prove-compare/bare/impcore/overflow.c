@@ -13,10 +13,7 @@ int checkoverflow(int limit) {
   volatile char c;
   if (!env_checked) {
       env_checked = 1;
-      const char *options = getenv("BPCOPTIONS");
-      if (options == NULL)
-          options = "";
-      throttled = strstr(options, "nothrottle") == NULL;
+      throttled = bpcoption("nothrottle") == NULL;
   }
   if (low_water_mark == NULL) {
     low_water_mark = &c;
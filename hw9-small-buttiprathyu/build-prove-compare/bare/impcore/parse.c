@@ -65,16 +65,16 @@ struct ParserRow exptable[] = {
 Exp exp_of_atom(Sourceloc loc, Name atom) {
     const char *s = nametostr(atom);
     char *t;   // to point to the first non-digit in s
-    long l = strtol(s, &t, 10);
+    Value v;
+    (void) strtol(s, &t, 10);
     if (*t != '\0') // the number is just a prefix
         return mkVar(atom);
-    else if (((l == LONG_MAX || l == LONG_MIN) && errno == ERANGE) ||
-             l > (long)INT32_MAX || l < (long)INT32_MIN)
+    else if (!readnumber(s, &v))
     {
         synerror(loc, "arithmetic overflow in integer literal %s", s);
         return NULL; // unreachable
     } else {  // the number is the whole atom, and not too big
-        return mkLiteral(l);
+        return mkLiteral(holdnumber(v));
     }
 }
 /* parse.c S49c */
@@ -1,39 +1,60 @@
+#define _DEFAULT_SOURCE  /* for MAP_ANONYMOUS */
 #include "all.h"
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
 /* copy.c 315a */
 /* private declarations for copying collection 315b */
-static Value *fromspace, *tospace;    /* used only at GC time */
-static int semispacesize;
-                                     /* # of objects in fromspace and tospace */
+/*
+ * The semispaces belong to the interpreter's heap, which all its
+ * threads share.  Each thread allocates from a buffer of its own, and
+ * when the buffer is used up, it takes the next [[BUFFER]] cells of
+ * from-space under the heap's lock.  Once from-space has all been
+ * taken, the heap is collected.
+ */
+struct Heap {
+    pthread_mutex_t lock;   // guards [[top]]
+    Value *fromspace, *tospace; /* tospace used only at GC time */
+    int semispacesize;      /* # of objects in fromspace and tospace */
+    int fromspacesize;      /* differs only when resizing */
+    Value *top, *limit;     /* cells of fromspace not yet taken */
+    int nalloc;             /* total number of allocations */
+    int ncollections;       /* total number of collections */
+    int ncopied;            /* total number of cells copied */
+    int maxsemispacesize;   /* largest semispace ever used */
+    clock_t gcticks;        /* CPU time spent collecting */
+    int nshrinks;           /* number of times the semispaces shrank */
+};
+static __thread Heap gc;  /* the heap of the current thread */
 /* private declarations for copying collection 315c */
-static Value *hp, *heaplimit;                /* used for every allocation */
+static __thread Value *hp, *heaplimit;      /* used for every allocation */
+#ifndef GCHYPERDEBUG
+#define BUFFER 256      /* cells a thread takes from the heap at a time */
+#else
+#define BUFFER 2
+#endif
 /* private declarations for copying collection 316b */
 static void scanenv      (Env env);
 static void scanexp      (Exp exp);
 static void scanexplist  (Explist es);
-static void scanframe    (Frame *fr);
+static void scanframe    (Frame *fr, void *cl);
 static void scantest     (UnitTest t);
 static void scantests    (UnitTestlist ts);
 static void scanloc      (Value *vp);
 /* private declarations for copying collection 318a */
 #define isinspace(LOC, SPACE) ((SPACE) <= (LOC) && (LOC) < (SPACE) +\
-                                                                  semispacesize)
+                                                              gc->semispacesize)
 static Value *forward(Value *p);
 /* private declarations for copying collection S214e */
 static void collect(void);
-/* copy.c 315d */
-/* representation of [[struct Stack]] S189a */
-struct Stack {
-    int size;
-    Frame *frames;  // memory for 'size' frames
-    Frame *sp;      // points to first unused frame
-};
+static bool takebuffer(void);
 /* copy.c 316a */
-int nalloc;   /* OMIT */
+static __thread int nalloc;  /* allocations not yet added to the heap's */
 Value* allocloc(void) {
-    if (hp == heaplimit)
+    while (hp == heaplimit && !takebuffer())
         collect();
     assert(hp < heaplimit);
-    assert(isinspace(hp, fromspace)); /*runs after spaces are swapped*/ /*OMIT*/
+    assert(isinspace(hp, gc->fromspace)); /*runs after spaces are swapped*/ /*OMIT*/
     nalloc++;   /* OMIT */
     /* tell the debugging interface that [[hp]] is about to be allocated 322c */
     gc_debug_pre_allocate(hp);
@@ -41,10 +62,10 @@ Value* allocloc(void) {
 }
 /* copy.c 316g */
 static void scanenv(Env env) {
-    for (; env; env = env->tl)
+    for (; env && markenv(env); env = env->tl)
       { /*OMIT*/
         env->loc = forward(env->loc);
-        assert(isinspace(env->loc, tospace)); /*OMIT*/
+        assert(isinspace(env->loc, gc->tospace)); /*OMIT*/
       } /*OMIT*/
 }
 /* copy.c 317a */
@@ -64,6 +85,10 @@ static void scanloc(Value *vp) {
         scanenv(vp->u.closure.env);
         return;
     case PRIMITIVE:
+        if (vp->u.primitive.function == continuation)
+            markcontinuation(vp->u.primitive.tag);
+        else if (vp->u.primitive.function == future)
+            markfuture(vp->u.primitive.tag);
         return;
     default:
         assert(0);
@@ -72,24 +97,24 @@ static void scanloc(Value *vp) {
 }
 /* copy.c 317b */
 static Value* forward(Value *p) {
-    if (isinspace(p, tospace)) {
+    if (isinspace(p, gc->tospace)) {
                           /* already in to space; must belong to scanned root */
         return p;
     } else {
-        assert(isinspace(p, fromspace));
+        assert(gc->fromspace <= p && p < gc->fromspace + gc->fromspacesize);
         /* forward pointer [[p]] and return the result 311b */
         if (p->alt == FORWARD) {            /* forwarding pointer */
-            assert(isinspace(p->u.forward, tospace));   /* OMIT */
+            assert(isinspace(p->u.forward, gc->tospace));   /* OMIT */
             return p->u.forward;
         } else {
-            assert(isinspace(hp, tospace)); /* there is room */   /* OMIT */
+            assert(isinspace(hp, gc->tospace)); /* there is room */   /* OMIT */
 
     /* tell the debugging interface that [[hp]] is about to be allocated 322c */
             gc_debug_pre_allocate(hp);
             *hp = *p;
             *p  = mkForward(hp);
                                 /* overwrite *p with a new forwarding pointer */
-            assert(isinspace(p->u.forward, tospace)); /*extra*/   /* OMIT */
+            assert(isinspace(p->u.forward, gc->tospace)); /*extra*/   /* OMIT */
             return hp++;
         }
     }
@@ -159,10 +184,14 @@ static void scanexp(Exp e) {
     assert(0);
 }
 /* copy.c S206b */
-static void scanframe(Frame *fr) {
-    scanexp(&fr->context);
-        if (fr->syntax != NULL)
-            scanexp(fr->syntax);
+static void scanframe(Frame *fr, void *cl) {
+    int i;
+    (void)cl;
+    if (fr->syntax != NULL)
+        scanexp(fr->syntax);
+    scanenv(fr->env);
+    for (i = 0; i < fr->nvalues; i++)
+        scanloc(&framevalues(fr)[i]);
 }
 /* copy.c S206c */
 static void scanexplist(Explist es) {
@@ -190,9 +219,242 @@ static void scantest(UnitTest t) {
     }
     assert(0);
 }
-/* copy.c ((prototype)) S215a */
-/* you need to redefine these functions */
-static void collect(void) { (void)scanframe; (void)scantests; assert(0); }
-void printfinalstats(void) { assert(0); }
-/* you need to initialize this variable */
-int gc_uses_mark_bits;
+/* copy.c S215a */
+/*
+ * The statistics are totals for the lifetime of the interpreter, kept
+ * in its heap.  Time in GC is the CPU time of the thread that collects,
+ * so that one interpreter's statistics do not count work done by
+ * others.
+ */
+static clock_t threadclock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (clock_t) ts.tv_sec * CLOCKS_PER_SEC +
+           (clock_t) (ts.tv_nsec * (double) CLOCKS_PER_SEC / 1e9);
+}
+/* copy.c: acquiring and releasing semispaces */
+#ifndef GCHYPERDEBUG
+#define MINSEMISPACE 256      /* size of the first semispaces, in objects */
+#else
+#define MINSEMISPACE 4
+#endif
+
+/*
+ * Semispaces are mapped directly, not taken from [[malloc]], so that
+ * releasing a space always returns its memory to the operating system.
+ */
+static Value *acquirespace(int nvalues) {
+    Value *space = mmap(NULL, nvalues * sizeof(*space), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(space != MAP_FAILED);
+    gc_debug_post_acquire(space, nvalues);
+    return space;
+}
+
+static void releasespace(Value *space, int nvalues) {
+    gc_debug_pre_release(space, nvalues);
+    munmap(space, nvalues * sizeof(*space));
+}
+/* copy.c: the heap and the threads' buffers */
+/*
+ * The semispaces are acquired with the heap.
+ */
+Heap gcheap(void) {
+    if (gc == NULL) {
+        gc = calloc(1, sizeof(*gc));
+        assert(gc != NULL);
+        pthread_mutex_init(&gc->lock, NULL);
+        gc->semispacesize = gc->fromspacesize = MINSEMISPACE;
+        gc->fromspace = acquirespace(gc->semispacesize);
+        gc->tospace   = acquirespace(gc->semispacesize);
+        gc->top   = gc->fromspace;
+        gc->limit = gc->fromspace + gc->semispacesize;
+        gc->maxsemispacesize = gc->semispacesize;
+    }
+    return gc;
+}
+
+void usegcheap(Heap h) {
+    gc = h;
+}
+
+static bool takebuffer(void) {
+    Heap h = gcheap();
+    int n;
+
+    pthread_mutex_lock(&h->lock);
+    n = h->limit - h->top < BUFFER ? h->limit - h->top : BUFFER;
+    hp = h->top;
+    heaplimit = h->top += n;
+    pthread_mutex_unlock(&h->lock);
+    return n > 0;
+}
+/*
+ * A thread gives back its buffer by filling the rest of it with nil,
+ * so that every cell of from-space that has been taken is allocated,
+ * as the next collection expects.
+ */
+void retirebuffer(void) {
+    for ( ; hp < heaplimit; hp++) {
+        gc_debug_pre_allocate(hp);
+        *hp = mkNil();
+    }
+    hp = heaplimit = NULL;
+    if (gc != NULL)
+        __atomic_add_fetch(&gc->nalloc, nalloc, __ATOMIC_RELAXED);
+    nalloc = 0;
+}
+/* copy.c: the Cheney collection */
+/*
+ * Copy every live object from [[fromspace]] into [[tospace]], then
+ * swap the spaces.  Roots are forwarded first; then the ``scan''
+ * pointer chases [[hp]] through [[tospace]], forwarding the
+ * pointers in each object it passes, until there is nothing left
+ * to scan.  Binding records, continuations, and futures do not move;
+ * each one reached is marked, and the rest are swept.  Returns the number of
+ * objects copied.  The roots are those of every thread that shares the
+ * heap; a worker that is quitting may have no globals left.  The
+ * collecting thread's [[hp]] serves as the allocation pointer in
+ * to-space, and what it has not reached is left for the threads to take.
+ */
+static void scanroots(struct Roots *r) {
+    UnitTestlistlist uss;
+    int i;
+
+    if (r->globals.user != NULL)
+        scanenv(*r->globals.user);
+    for (uss = r->globals.internal.pending_tests; uss; uss = uss->tl)
+        scantests(uss->hd);
+    walkstack(r->stack, 0, INT_MAX, scanframe, NULL);
+    for (i = 0; i < r->registers.sp; i++)
+        scanloc(r->registers.regs[i]);
+}
+
+static int copyheap(void) {
+    Value *scan;
+    Value *oldtop = gc->top;
+    struct Roots **rs;
+    int i, n;
+
+    hp = scan = gc->tospace;
+    /* forward the roots */
+    rs = allroots(&n);
+    for (i = 0; i < n; i++)
+        scanroots(rs[i]);
+    /* scan the copied objects, and the continuations and futures they reach */
+    do {
+        for ( ; scan < hp; scan++)
+            scanloc(scan);
+    } while (tracecontinuations(scanframe, NULL) || tracefutures(scanloc));
+
+    sweepenvs();
+    sweepcontinuations();
+    sweepfutures();
+
+    /* tell the debugging interface that every object in fromspace is dead */
+    gc_debug_post_reclaim_block(gc->fromspace, oldtop - gc->fromspace);
+    {   Value *tmp = gc->fromspace;
+        gc->fromspace = gc->tospace;
+        gc->tospace = tmp;
+    }
+    gc->top   = hp;
+    gc->limit = gc->fromspace + gc->semispacesize;
+    hp = heaplimit = NULL;
+    return gc->top - gc->fromspace;
+}
+/*
+ * Resizing means copying once more, into a new tospace of the new
+ * size; the old spaces are then released and a matching tospace is
+ * acquired.  Returns the number of objects copied.
+ */
+static int resize(int newsize) {
+    int nlive, oldsize = gc->semispacesize;
+
+    releasespace(gc->tospace, oldsize);
+    gc->tospace = acquirespace(newsize);
+    gc->semispacesize = newsize;
+    nlive = copyheap();
+    gc->fromspacesize = newsize;
+    releasespace(gc->tospace, oldsize);
+    gc->tospace = acquirespace(gc->semispacesize);
+    return nlive;
+}
+/*
+ * After each collection, the semispaces are resized so that
+ * semispacesize / live is at least gamma (a percentage).  When live
+ * data drops so that the ratio exceeds [[&gamma-shrink]], the
+ * semispaces shrink back to gamma, but never below [[MINSEMISPACE]].
+ *
+ * The thread that collects first stops every other thread that shares
+ * the heap; if another thread collected while this one waited, and
+ * left cells to take, there is nothing more to do.
+ */
+static void collect(void) {
+    clock_t start;
+    int gamma, shrink, nlive;
+
+    if (!stopworld())
+        return;
+    if (gc->top < gc->limit) {
+        startworld();
+        return;
+    }
+    start  = threadclock();
+    gamma  = gammadesired(200, 110);
+    shrink = gammashrink(2 * gamma, gamma);
+    gc->ncollections++;
+    nlive = copyheap();
+    gc->ncopied += nlive;
+    gcprintf("GC %d: %d of %d cells live\n", gc->ncollections, nlive,
+                                                            gc->semispacesize);
+    if (gc->semispacesize * 100 < nlive * gamma || nlive == gc->semispacesize) {
+        int newsize = (int) (((long) nlive * gamma + 99) / 100);
+        if (newsize <= nlive)
+            newsize = nlive + 1;
+        gc->ncopied += resize(newsize);
+        if (gc->semispacesize > gc->maxsemispacesize)
+            gc->maxsemispacesize = gc->semispacesize;
+    } else if ((long) gc->semispacesize * 100 > (long) nlive * shrink &&
+               gc->semispacesize > MINSEMISPACE) {
+        int newsize = (int) (((long) nlive * gamma + 99) / 100);
+        if (newsize < MINSEMISPACE)
+            newsize = MINSEMISPACE;
+        gc->ncopied += resize(newsize);
+        gc->nshrinks++;
+        gcprintf("GC %d: semispaces shrunk to %d cells\n", gc->ncollections,
+                                                            gc->semispacesize);
+    }
+    gc->gcticks += threadclock() - start;
+    startworld();
+}
+/* copy.c: releasing the heap */
+/*
+ * [[freeheap]] gives back both semispaces, and the statistics with
+ * them; the next interpreter starts a heap of its own.  Every other
+ * thread that shared the heap has quit.  The objects still in
+ * from-space are reclaimed first, as if by one last collection.
+ */
+void freeheap(void) {
+    retirebuffer();
+    if (gc == NULL)
+        return;
+    gc_debug_post_reclaim_block(gc->fromspace, gc->top - gc->fromspace);
+    releasespace(gc->fromspace, gc->semispacesize);
+    releasespace(gc->tospace, gc->semispacesize);
+    pthread_mutex_destroy(&gc->lock);
+    free(gc);
+    gc = NULL;
+}
+void printfinalstats(void) {
+    Heap h = gcheap();
+    fprintf(stderr, "[Copying GC: allocated %d cells; %d collections copied "
+                    "%d cells (%lu bytes); max heap %d cells (%lu bytes); "
+                    "%d shrinks; %.3fs in GC]\n",
+            h->nalloc + nalloc, h->ncollections,
+            h->ncopied, (unsigned long) h->ncopied * sizeof(Value),
+            2 * h->maxsemispacesize,
+            (unsigned long) 2 * h->maxsemispacesize * sizeof(Value),
+            h->nshrinks,
+            (double) h->gcticks / CLOCKS_PER_SEC);
+}
+int gc_uses_mark_bits = 0;
@@ -1,21 +1,42 @@
 #include "all.h"
+#ifndef GCHYPERDEBUG
+#define TIMESLICE 1000  /* default for &time-slice, in steps */
+#else
+#define TIMESLICE 10
+#endif
+
+static __thread Stack mainstack;  // the thread whose value eval returns
+static __thread Stack evalstack;  // the thread now running
+static __thread int nescapes;     // escape continuations captured so far
+static __thread int nthreads = 1; // threads on the ring
+static __thread int nstalled;     // receives failed since a thread ran
+static __thread int slice;        // steps left before the next thread
+static __thread int timeslice;
+
+static void suspend(Stack s, Exp blocked, Env env, Value v);
 /* eval-stack.c 255a */
 Value eval(Exp e, Env env) {
     Value v;
     Frame *fr;
-    /* definition of static [[Exp hole]], which always has a hole S196c */
-    static struct Exp holeExp = { HOLE, { { NIL, { 0 } } } };
-    static Exp hole = &holeExp;
-    static Stack evalstack;
+    Value fn;       // function being applied to vs
+    Valuelist vs;
 
     /* ensure that [[evalstack]] is initialized and empty S190b */
-    if (evalstack == NULL)
-        evalstack = emptystack();
+    if (mainstack == NULL)
+        mainstack = roots.stack;  // the empty stack from initallocate
     else
-        clearstack(evalstack);
+        clearstack(mainstack);
+    /* kill the thread, if any, whose error ended the last evaluation */
+    if (evalstack != NULL && evalstack != mainstack) {
+        leavering(evalstack);
+        freestack(evalstack);
+        nthreads--;
+    }
+    evalstack = mainstack;
+    nstalled = 0;
     /* ensure that [[evalstack]] is initialized and empty S212b */
     assert(topframe(roots.stack) == NULL);
-    roots.stack = evalstack;
+    roots.stack = mainstack;  // walking it walks every thread
     /* use the options in [[env]] to initialize the instrumentation S192d */
     high_stack_mark = 0;
     show_high_stack_mark = 
@@ -27,11 +48,45 @@ Value eval(Exp e, Env env) {
         else
             stack_trace_init(NULL);
     }
+    /* use the options in [[env]] to start or stop the binary trace */
+    {   Value *p = find(strtoname("&trace-ring"), env);
+        Value *f = find(strtoname("&trace-file"), env);
+        const char *file = f && f->alt == SYM ? nametostr(f->u.sym)
+                                              : "stack.trace";
+        char workerfile[1024];
+        if (futureworker() > 0) {  // a worker traces to a file of its own
+            snprintf(workerfile, sizeof(workerfile), "%s.w%d", file,
+                     futureworker());
+            file = workerfile;
+        }
+        stack_trace_ring(p && p->alt == NUM ? p->u.num : 0, file);
+    }
     /* use the options in [[env]] to initialize the instrumentation S195f */
     optimize_tail_calls = 
         istrue(getoption(strtoname("&optimize-tail-calls"), env, truev));
+    /* use the options in [[env]] to limit the depth of the stack */
+    {   Value *p = find(strtoname("&max-stack-depth"), env);
+        max_stack_depth = p && p->alt == NUM && p->u.num > 0 ? p->u.num
+                                                             : MAXSTACKDEPTH;
+    }
+    /* use the options in [[env]] to set the threads' time slice */
+    {   Value *p = find(strtoname("&time-slice"), env);
+        timeslice = p && p->alt == NUM && p->u.num > 0 ? p->u.num : TIMESLICE;
+        if (slice <= 0 || slice > timeslice)
+            slice = timeslice;
+    }
+    /* use the options in [[env]] to size the pool that runs futures */
+    {   Value *p = find(strtoname("&future-threads"), env);
+        setfuturethreads(p && p->alt == NUM ? p->u.num : -1);
+    }
 
     exp: 
+        /* stop here if another thread is waiting to collect */
+        if (collectionpending()) {  // e and env are rooted in a frame
+            pushframe(LETXENV, e, 0, evalstack)->env = env;
+            safepoint();
+            popframe(evalstack);
+        }
         stack_trace_current_expression(e, env, evalstack);
         /* take a step from a state of the form $\seval e$ 256 */
         switch (e->alt) {
@@ -52,27 +107,26 @@ Value eval(Exp e, Env env) {
 /* start evaluating expression [[e->u.set]] and transition to the next state 259a */
             if (find(e->u.set.name, env) == NULL)
                 runerror("set unbound variable %n", e->u.set.name);
-            pushcontext(mkSetStruct(e->u.set.name, hole), evalstack);
+            pushframe(SET, e, 0, evalstack);
             e = e->u.set.exp;
             goto exp;
         case IFX:
 
 /* start evaluating expression [[e->u.ifx]] and transition to the next state 259c */
-            pushcontext(mkIfxStruct(hole, e->u.ifx.truex, e->u.ifx.falsex),
-                                                                     evalstack);
+            pushframe(IFX, e, 0, evalstack);
             e = e->u.ifx.cond;
             goto exp;
         case WHILEX:
 
 /* start evaluating expression [[e->u.whilex]] and transition to the next state 267d */
-            pushcontext(mkWhilexStruct(e->u.whilex.cond, e->u.whilex.body),
-                                                                     evalstack);
+            pushframe(WHILEX, e, 0, evalstack)->env = env;
             e = e->u.whilex.cond;
             goto exp;
         case BEGIN:
 
 /* start evaluating expression [[e->u.begin]] and transition to the next state 267b */
-            pushcontext(mkBeginStruct(e->u.begin), evalstack);
+            fr = pushframe(BEGIN, e, 0, evalstack);
+            fr->es = e->u.begin;
             v = falsev;
             goto value;
         case LETX:
@@ -85,24 +139,22 @@ Value eval(Exp e, Env env) {
                    case LET:
 
 /* start evaluating nonempty [[let]] expression [[e->u.letx]] and transition to the next state 263c */
-                     pushcontext(mkLetxStruct(e->u.letx.let, e->u.letx.xs, 
-                                              copyEL(e->u.letx.es), e->
-                                                                   u.letx.body),
-                                 evalstack);
-                     fr = topframe(evalstack);
-                     e  = head_replaced_with_hole(fr->context.u.letx.es);
+                     fr = pushframe(LETX, e, lengthEL(e->u.letx.es), evalstack);
+                     fr->let = LET;
+                     fr->es  = e->u.letx.es;
+                     e  = nextpending(fr);
                      assert(e);
                      goto exp;
                    case LETSTAR:
 
 /* start evaluating nonempty [[let*]] expression [[e->u.letx]] and transition to the next state 264c */
                       pushenv_opt(env, LETXENV, evalstack);
-                      pushcontext(mkLetxStruct(e->u.letx.let, e->u.letx.xs, e->
-                                                     u.letx.es, e->u.letx.body),
-                                  evalstack);
-                      fr = topframe(evalstack);
-                      assert(fr->context.u.letx.es);
-                      e = fr->context.u.letx.es->hd;
+                      fr = pushframe(LETX, e, 0, evalstack);
+                      fr->let = LETSTAR;
+                      fr->xs  = e->u.letx.xs;
+                      fr->es  = e->u.letx.es;
+                      assert(fr->es);
+                      e = fr->es->hd;
                       assert(e);
                       goto exp;
                    case LETREC:
@@ -119,12 +171,11 @@ Value eval(Exp e, Env env) {
                           for (xs = e->u.letx.xs; xs; xs = xs->tl)    
                               env = bindalloc(xs->hd, unspecified(), env);
                       }
-                      pushcontext(mkLetxStruct(e->u.letx.let, e->u.letx.xs, 
-                                               copyEL(e->u.letx.es), e->
-                                                                   u.letx.body),
-                                  evalstack);
-                      fr = topframe(evalstack);
-                      e  = head_replaced_with_hole(fr->context.u.letx.es);
+                      fr = pushframe(LETX, e, lengthEL(e->u.letx.es),
+                                                                     evalstack);
+                      fr->let = LETREC;
+                      fr->es  = e->u.letx.es;
+                      e  = nextpending(fr);
                       assert(e);
                       goto exp;
                    default:
@@ -139,53 +190,53 @@ Value eval(Exp e, Env env) {
         case APPLY:
 
 /* start evaluating expression [[e->u.apply]] and transition to the next state 261c */
-            pushcontext(mkApplyStruct(mkHole(), copyEL(e->u.apply.actuals)),
+            fr = pushframe(APPLY, e, 1 + lengthEL(e->u.apply.actuals),
                                                                      evalstack);
-            topframe(evalstack)->syntax = e;
+            fr->es = e->u.apply.actuals;
             e = e->u.apply.fn;
             goto exp;
         case BREAKX:
 
         /* start evaluating [[(break)]] and transition to the next state 269a */
-            fr = topframe(evalstack);
+            if (chaindepth(CALL_CHAIN, evalstack) >
+                                           chaindepth(LOOP_CHAIN, evalstack))
+                runerror("(break) in function outside of any loop");
+            fr = unwindto(LOOP_CHAIN, evalstack);
             if (fr == NULL) 
                 runerror("(break) occurred outside any loop");
-            else
-                switch (fr->context.alt) {
-                    case WHILE_RUNNING_BODY:  // Break-Transfer
-                        popframe(evalstack);
-                        v = falsev;
-                        goto value;
-                    case LETXENV:             // Break-Unwind-Letenv
-                        env = fr->context.u.letxenv;
-                        popframe(evalstack);
-                        goto exp;
-                    case CALLENV:
-                        runerror("(break) in function outside of any loop");
-                    default:                  // Break-Unwind
-                        popframe(evalstack);
-                        goto exp;
-                }
+            env = fr->env;                    // Break-Transfer
+            popframe(evalstack);
+            v = falsev;
+            goto value;
         case CONTINUEX:
 
-/* start evaluating [[(continue)]] and transition to the next state ((prototype)) 269b */
-            runerror("The implementation of (continue) is left as an exercise");
+/* start evaluating [[(continue)]] and transition to the next state 269b */
+            if (chaindepth(CALL_CHAIN, evalstack) >
+                                           chaindepth(LOOP_CHAIN, evalstack))
+                runerror("(continue) in function outside of any loop");
+            fr = unwindto(LOOP_CHAIN, evalstack);
+            if (fr == NULL) 
+                runerror("(continue) occurred outside any loop");
+            env = fr->env;
+            retagframe(fr, WHILEX, evalstack);
+            e = fr->syntax->u.whilex.cond;
+            goto exp;
         case RETURNX:
 
 /* start evaluating expression [[e->u.returnx]] and transition to the next state 269c */
-            pushcontext(mkReturnxStruct(hole), evalstack);
+            pushframe(RETURNX, e, 0, evalstack);
             e = e->u.returnx;
             goto exp;
         case THROW:
 
 /* start evaluating expression [[e->u.throw]] and transition to the next state 269e */
-            pushcontext(mkThrowStruct(hole), evalstack);
+            pushframe(THROW, e, 0, evalstack);
             e = e->u.throw;
             goto exp;
         case TRY_CATCH:
 
 /* start evaluating expression [[e->u.try_catch]] and transition to the next state 270a */
-            pushcontext(mkTryCatchStruct(e->u.try_catch.body, hole), evalstack);
+            pushframe(TRY_CATCH, e, 0, evalstack);
             e = e->u.try_catch.handler;
             goto exp;
 
@@ -197,13 +248,37 @@ Value eval(Exp e, Env env) {
             assert(0);
         }
         assert(0);
+    switchthread:   // the running thread is suspended; run the next one
+        evalstack = nextstack(evalstack);
+    resumethread:
+        fr = topframe(evalstack);
+        assert(fr != NULL && fr->alt == LETXENV && fr->nslots == 1);
+        if (fr->syntax == NULL)  // the thread is not retrying a receive
+            nstalled = 0;
+        v   = framevalues(fr)[0];
+        env = fr->env;
+        popframe(evalstack);
+        slice = timeslice;
     value: 
         stack_trace_current_value(v, env, evalstack);
         v = validate(v);
+        if (nthreads > 1 && --slice == 0) {
+            suspend(evalstack, NULL, env, v);
+            goto switchthread;
+        }
 
 /* if [[evalstack]] is empty, return [[v]]; otherwise step from a state of the form $\sevalv {\mathtt{fr} \sconsop S}$ 255b */
         fr = topframe(evalstack);
-        if (fr == NULL) {
+        if (fr == NULL && evalstack != mainstack) {
+
+            /* the thread has finished; remove it and run the next one */
+            Stack done = evalstack;
+            evalstack = nextstack(done);
+            leavering(done);
+            freestack(done);
+            nthreads--;
+            goto resumethread;
+        } else if (fr == NULL) {
 
          /* if [[show_high_stack_mark]] is set, show maximum stack size S192e */
             if (show_high_stack_mark)
@@ -212,29 +287,27 @@ Value eval(Exp e, Env env) {
         } else {
 
 /* take a step from a state of the form $\sevalv {\mathtt{fr} \sconsop S}$ 257 */
-            switch (fr->context.alt) {
+            switch ((Expalt) fr->alt) {
             case SET:
 
-/* fill hole in context [[fr->context.u.set]] and transition to the next state 259b */
-                assert(fr->context.u.set.exp->alt == HOLE);
-                assert(find(fr->context.u.set.name, env) != NULL);
-                *find(fr->context.u.set.name, env) = validate(v);
+/* fill hole in context [[fr->syntax->u.set]] and transition to the next state 259b */
+                assert(find(fr->syntax->u.set.name, env) != NULL);
+                *find(fr->syntax->u.set.name, env) = validate(v);
                 popframe(evalstack);
                 goto value;
             case IFX:
 
-/* fill hole in context [[fr->context.u.ifx]] and transition to the next state 259d */
-                assert(fr->context.u.ifx.cond->alt == HOLE);
-                e = istrue(v) ? fr->context.u.ifx.truex : fr->
-                                                           context.u.ifx.falsex;
+/* fill hole in context [[fr->syntax->u.ifx]] and transition to the next state 259d */
+                e = istrue(v) ? fr->syntax->u.ifx.truex : fr->
+                                                           syntax->u.ifx.falsex;
                 popframe(evalstack);
                 goto exp;
             case WHILEX:
 
-/* if [[v]] is true, continue with body in context [[fr->context.u.whilex]] 268a */
+/* if [[v]] is true, continue with body in context [[fr->syntax->u.whilex]] 268a */
                 if (istrue(validate(v))) {   // Small-Step-While-Condition-True
-                    fr->context.alt = WHILE_RUNNING_BODY;
-                    e = fr->context.u.whilex.body;
+                    retagframe(fr, WHILE_RUNNING_BODY, evalstack);
+                    e = fr->syntax->u.whilex.body;
                     goto exp;
                 } else {                     // Small-Step-While-Condition-False
                     popframe(evalstack);
@@ -243,16 +316,16 @@ Value eval(Exp e, Env env) {
                 }
             case WHILE_RUNNING_BODY:
 
-/* transition to [[WHILEX]] and continue with condition in context [[fr->context.u.whilex]] 268b */
-                fr->context.alt = WHILEX;
-                e = fr->context.u.whilex.cond;
+/* transition to [[WHILEX]] and continue with condition in context [[fr->syntax->u.whilex]] 268b */
+                retagframe(fr, WHILEX, evalstack);
+                e = fr->syntax->u.whilex.cond;
                 goto exp;
             case BEGIN:
 
- /* continue with the next expression in context [[fr->context.u.begin]] 267c */
-                if (fr->context.u.begin) {   // Small-Step-Begin-Next-Expression
-                    e = fr->context.u.begin->hd;
-                    fr->context.u.begin = fr->context.u.begin->tl;
+ /* continue with the next expression in context [[fr->es]] 267c */
+                if (fr->es) {                // Small-Step-Begin-Next-Expression
+                    e = fr->es->hd;
+                    fr->es = fr->es->tl;
                     goto exp;
                 } else {                     // Small-Step-Begin-Exhausted
                     popframe(evalstack);
@@ -260,80 +333,170 @@ Value eval(Exp e, Env env) {
                 }    
             case APPLY:
 
-/* fill hole in context [[fr->context.u.apply]] and transition to the next state 262a */
-                if (fr->context.u.apply.fn->alt == HOLE) {
-                                                   // Small-Step-Apply-First-Arg
-                    *fr->context.u.apply.fn = mkLiteralStruct(v);
-                    e = head_replaced_with_hole(fr->context.u.apply.actuals);
-                    if (e)
-                        goto exp;
-                                                   // Small-Step-Apply-First-Arg
-                    else
-                        goto apply_last_arg;
-                                                      // empty list of arguments
-                } else {                                    
-                    e = transition_explist(fr->context.u.apply.actuals, v); 
-                    if (e)
-                        goto exp;
-                                                    // Small-Step-Apply-Next-Arg
-                    else goto
-                        apply_last_arg;
-                                                    // Small-Step-Apply-Last-Arg
-                }
-                apply_last_arg:   // Small-Step-Apply-Last-Arg (or no arguments)
-
-/* apply [[fr->context]]'s [[fn]] to its [[actuals]]; free memory; transition to next state 262b */
-                    {
-                        Value     fn = asLiteral (fr->context.u.apply.fn);
-                        Valuelist vs = asLiterals(fr->context.u.apply.actuals);
-                        free  (fr->context.u.apply.fn);
-                        freeEL(fr->context.u.apply.actuals);
-
-                        popframe(evalstack);
-                        
-                        switch (fn.alt) {
-                          case PRIMITIVE:
+/* save [[v]] in frame [[fr]] and transition to the next state 262a */
+                pushvalue(fr, v);
+                e = nextpending(fr);
+                if (e)
+                    goto exp;  // Small-Step-Apply-First-Arg or -Next-Arg
+                               // else Small-Step-Apply-Last-Arg (or no arguments)
+
+/* apply [[fr]]'s first value to the rest; free memory; transition to next state 262b */
+                fn = validate(framevalues(fr)[0]);
+                vs = framevaluelist(fr, 1);
+                e  = fr->syntax;
+                popframe(evalstack);
+            apply:          // apply [[fn]] to [[vs]]; [[e]] is the call's syntax
+                switch (fn.alt) {
+                  case PRIMITIVE:
+                      if (fn.u.primitive.function == control) {
+                          Stack t;
+                          Value ch;
+                          bool thrown;
+
+                          checkargc(e, fn.u.primitive.tag == YIELD ? 0 : 1,
+                                    lengthVL(vs));
+                          switch (fn.u.primitive.tag) {
+                          case CALLCC:
+
+/* pass the continuation of [[e]] to the function in [[vs]], and transition to its application */
+                              fn = validate(vs->hd);
+                              pushframe(LETXENV, NULL, 0, evalstack)->env = env;
+                              vs->hd = mkPrimitive(capturestack(evalstack),
+                                                   continuation);
+                              goto apply;
+                          case CALLONECC:
+                              fn = validate(vs->hd);
+                              fr = pushframe(LETXENV, NULL, 1, evalstack);
+                              fr->env = env;
+                              vs->hd = mkPrimitive(++nescapes, escape);
+                              pushvalue(fr, vs->hd);
+                              goto apply;
+                          case SPAWN:
+
+/* start a thread that applies the function in [[vs]] to no arguments, and transition to the next state */
+                              t = emptystack();
+                              pushframe(APPLY, e, 1, t)->es = NULL;
+                              suspend(t, NULL, NULL, vs->hd);
+                              freeVL(vs);
+                              joinring(t, evalstack);
+                              nthreads++;
+                              v = falsev;
+                              goto value;
+                          case YIELD:
+                              v = falsev;
+                              if (nthreads == 1)
+                                  goto value;
+                              suspend(evalstack, NULL, env, v);
+                              goto switchthread;
+                          case RECEIVE:
+
+/* take the oldest message from the channel in [[vs]], or block until there is one */
+                              ch = vs->hd;
+                              freeVL(vs);
+                              if (ch.alt != PAIR)
+                                  runerror("in %e, expected a channel, but got "
+                                           "%v", e, ch);
+                              if (ch.u.pair.car->alt == PAIR) {
+                                  v = *ch.u.pair.car->u.pair.car;
+                                  *ch.u.pair.car = *ch.u.pair.car->u.pair.cdr;
+                                  if (ch.u.pair.car->alt == NIL)
+                                      *ch.u.pair.cdr = *ch.u.pair.car;
+                                  nstalled = 0;
+                                  goto value;
+                              }
+                              if (++nstalled >= nthreads)
+                                  runerror("in %e, deadlock: every thread is "
+                                           "waiting to receive", e);
+                              fr = pushframe(APPLY, e, 2, evalstack);
+                              fr->es = NULL;  // retry when resumed
+                              pushvalue(fr, fn);
+                              suspend(evalstack, e, env, ch);
+                              goto switchthread;
+                          case FUTURE:
+
+/* make a future that applies the function in [[vs]] to no arguments, and transition to the next state */
+                              fn = validate(vs->hd);
+                              freeVL(vs);
+                              if (fn.alt != CLOSURE ||
+                                  fn.u.closure.lambda.formals != NULL)
+                                  runerror("in %e, expected a function of no "
+                                           "arguments, but got %v", e, fn);
+                              pushframe(LETXENV, NULL, 0, evalstack)->env = env;
+                              env = NULL;  // a future may run right here
+                              v = mkfuture(e, fn);
+                              goto value;
+                          case TOUCH:
 
-  /* apply [[fn.u.primitive]] to [[vs]] and transition to the next state 262c */
-                              e = fr->syntax;
-                              pushcontext(mkLetxenvStruct(env), evalstack);
-                              env = NULL;
-                              v = fn.u.primitive.function(e, fn.u.primitive.tag,
-                                                                            vs);
+/* wait for the future in [[vs]], and return its value or throw what it threw */
+                              fn = vs->hd;
                               freeVL(vs);
+                              pushframe(LETXENV, NULL, 0, evalstack)->env = env;
+                              env = NULL;  // the future may run right here
+                              v = touchfuture(e, fn, &thrown);
+                              if (thrown)
+                                  pushframe(THROW, e, 0, evalstack);
                               goto value;
-                          case CLOSURE:
+                          default:
+                              assert(0);
+                          }
+                      } else if (fn.u.primitive.function == continuation ||
+                                 fn.u.primitive.function == escape) {
+
+/* pass the value in [[vs]] to the continuation [[fn]], and transition to the next state */
+                          checkargc(e, 1, lengthVL(vs));
+                          v = vs->hd;
+                          freeVL(vs);
+                          if (fn.u.primitive.function == continuation) {
+                              resumestack(fn.u.primitive.tag, evalstack);
+                          } else {
+                              for (fr = unwindto(ESCAPE_CHAIN, evalstack);
+                                   fr != NULL && framevalues(fr)[0].u.primitive
+                                                .tag != fn.u.primitive.tag;
+                                   fr = unwindto(ESCAPE_CHAIN, evalstack))
+                                  popframe(evalstack);
+                              if (fr == NULL)
+                                  runerror("in %e, escape continuation was "
+                                           "applied after its extent ended", e);
+                          }
+                          goto value;  // the top frame restores the env
+                      }
+
+  /* apply [[fn.u.primitive]] to [[vs]] and transition to the next state 262c */
+                      pushframe(LETXENV, NULL, 0, evalstack)->env = env;
+                      env = NULL;
+                      v = fn.u.primitive.function(e, fn.u.primitive.tag, vs);
+                      freeVL(vs);
+                      goto value;
+                  case CLOSURE:
 
 /* save [[env]], bind [[vs]] to [[fn.u.closure]]'s formals, and transition to evaluation of closure's body 263a */
-                              {
-                                  Namelist xs = fn.u.closure.lambda.formals;
-
-                                  checkargc(e, lengthNL(xs), lengthVL(vs));
-                                  pushenv_opt(env, CALLENV, evalstack);
-                                  env = bindalloclist(xs, vs, fn.u.closure.env);
-                                  e   = fn.u.closure.lambda.body;
-                                  freeVL(vs);
-                                  goto exp;
-                              }
-                          default:
-                              runerror("%e evaluates to non-function %v in %e",
-                                    fr->syntax->u.apply.fn, fn, fr->syntax);
-                        }
-                    }
+                      {
+                          Namelist xs = fn.u.closure.lambda.formals;
+
+                          checkargc(e, lengthNL(xs), lengthVL(vs));
+                          pushenv_opt(env, CALLENV, evalstack);
+                          env = bindalloclist(xs, vs, fn.u.closure.env);
+                          e   = fn.u.closure.lambda.body;
+                          freeVL(vs);
+                          goto exp;
+                      }
+                  default:
+                      runerror("%e evaluates to non-function %v in %e",
+                               e->u.apply.fn, fn, e);
+                }
             case LETX:
-                switch (fr->context.u.letx.let) {
+                switch (fr->let) {
                    case LET:
-                 /* continue with [[let]] context [[fr->context.u.letx]] 265a */
-                                 e = transition_explist(fr->context.u.letx.es, v
-                                                                              );
+                 /* continue with [[let]] context [[fr->syntax->u.letx]] 265a */
+                                 pushvalue(fr, v);
+                                 e = nextpending(fr);
                                  if (e) {         // Small-Step-Next-Let-Exp 
                                      goto exp;
                                  } else {        // Small-Step-Let-Body
-                                     Namelist xs  = fr->context.u.letx.xs;
+                                     Namelist xs  = fr->syntax->u.letx.xs;
                                                   // 1. Remember x's and v's    
-                                     Explist  es  = fr->context.u.letx.es;
-                                     Valuelist vs = asLiterals(es);
-                                     e = fr->context.u.letx.body;
+                                     Valuelist vs = framevaluelist(fr, 0);
+                                     e = fr->syntax->u.letx.body;
                                                   // 2. Update e                
                                      popframe(evalstack);
                                                   // 3. Pop the LET context     
@@ -341,55 +504,49 @@ Value eval(Exp e, Env env) {
                                                   // 4. Push env                
                                      env = bindalloclist(xs, vs, env);
                                                   // 5. Update env              
-                                     freeEL(es);
-                                                  // 6. Recover memory          
                                      freeVL(vs);
+                                                  // 6. Recover memory          
                                      goto exp;
                                                   // 7. Transition to next state
                                  }
                    case LETSTAR:
-                /* continue with [[let*]] context [[fr->context.u.letx]] 266b */
-                                 assert(fr->context.u.letx.xs != NULL && fr->
-                                                     context.u.letx.es != NULL);
-                                 env = bindalloc(fr->context.u.letx.xs->hd, v,
-                                                                           env);
-                                 fr->context.u.letx.xs = fr->context.u.letx.xs->
-                                                                             tl;
-                                 fr->context.u.letx.es = fr->context.u.letx.es->
-                                                                             tl;
-                                 if (fr->context.u.letx.es) {
+                /* continue with [[let*]] context [[fr->xs]] and [[fr->es]] 266b */
+                                 assert(fr->xs != NULL && fr->es != NULL);
+                                 env = bindalloc(fr->xs->hd, v, env);
+                                 fr->xs = fr->xs->tl;
+                                 fr->es = fr->es->tl;
+                                 if (fr->es) {
                                                   // Small-Step-Next-Letstar-Exp
-                                     e = fr->context.u.letx.es->hd;
+                                     e = fr->es->hd;
                                      goto exp;
                                  } else {
                                                       // Small-Step-Letstar-Body
-                                     e = fr->context.u.letx.body;
+                                     e = fr->syntax->u.letx.body;
                                      popframe(evalstack);
                                      goto exp;
                                  }
                    case LETREC:
-              /* continue with [[letrec]] context [[fr->context.u.letx]] 265b */
-                                 e = transition_explist(fr->context.u.letx.es, v
-                                                                              );
+              /* continue with [[letrec]] context [[fr->syntax->u.letx]] 265b */
+                                 pushvalue(fr, v);
+                                 e = nextpending(fr);
                                  if (e) {  // Small-Step-Next-Letrec-Exp
                                      goto exp;
                                  } else {  // Small-Step-Letrec-Body
 
-/* store values in [[fr->context.u.letx.es]] in locations bound to [[fr->context.u.letx.xs]] 266a */
+/* store values in [[fr]] in locations bound to [[fr->syntax->u.letx.xs]] 266a */
                                      {
-                                         Namelist xs = fr->context.u.letx.xs;
-                                         Explist  es = fr->context.u.letx.es;
-                                         while (es || xs) { 
-                                             assert(es && xs);
+                                         Namelist xs = fr->syntax->u.letx.xs;
+                                         Value *vals = framevalues(fr);
+                                         int i;
+                                         for (i = 0; xs; xs = xs->tl, i++) { 
+                                             assert(i < fr->nvalues);
                                              assert(find(xs->hd, env));
-                                             *find(xs->hd, env) = asLiteral(es->
-                                                                            hd);
-                                             es = es->tl;
-                                             xs = xs->tl;
+                                             *find(xs->hd, env) =
+                                                            validate(vals[i]);
                                          }
+                                         assert(i == fr->nvalues);
                                      };
-                                     freeEL(fr->context.u.letx.es);
-                                     e = fr->context.u.letx.body;
+                                     e = fr->syntax->u.letx.body;
                                      popframe(evalstack);
                                      goto exp;
                                  }
@@ -397,43 +554,56 @@ Value eval(Exp e, Env env) {
                 }
             case LETXENV:
 
-/* restore [[env]] from [[fr->context.u.letxenv]], pop the stack, and transition to the next state 266c */
-                env = fr->context.u.letxenv;
+/* restore [[env]] from [[fr->env]], pop the stack, and transition to the next state 266c */
+                env = fr->env;
                 popframe(evalstack);
                 goto value;
             case CALLENV:
 
-/* restore [[env]] from [[fr->context.u.callenv]], pop the stack, and transition to the next state 267a */
-                env = fr->context.u.callenv;
+/* restore [[env]] from [[fr->env]], pop the stack, and transition to the next state 267a */
+                env = fr->env;
                 popframe(evalstack);
                 goto value;
             case TRY_CATCH:
 
 /* if awaiting handler, install [[v]] and evaluate body, otherwise pop stack and transition to the next state 270b */
-                if (fr->context.u.try_catch.handler->alt == HOLE) {
-                                                            // Try-Catch-Handler
+                if (fr->nslots == 0) {                      // Try-Catch-Handler
                     if (v.alt != CLOSURE && v.alt != PRIMITIVE) 
                         runerror(
              "Handler in try-catch is %v, but a handler must be a function", v);
-                    e = fr->context.u.try_catch.body;
+                    e = fr->syntax;
                     popframe(evalstack);
                     pushenv_opt(env, LETXENV, evalstack);
-                    pushcontext(mkTryCatchStruct(hole, mkLiteral(v)), evalstack)
-                                                                               ;
+                    pushvalue(pushframe(TRY_CATCH, e, 1, evalstack), v);
+                    e = e->u.try_catch.body;
                     goto exp;
                 } else {
                                                              // Try-Catch-Finish
-                    assert(fr->context.u.try_catch.body->alt == HOLE);
                     popframe(evalstack);
                     goto value;
                 }
             case RETURNX:
-                /* return [[v]] from the current function ((prototype)) 269d */
-                runerror("Implementation of (return e) is left as an exercise");
+                /* return [[v]] from the current function 269d */
+                fr = unwindto(CALL_CHAIN, evalstack);
+                if (fr == NULL)
+                    runerror("(return) occurred outside any function");
+                env = fr->env;
+                popframe(evalstack);
+                goto value;
             case THROW:
 
-/* throw [[v]] to the nearest [[try-catch]] that has an installed handler ((prototype)) 269f */
-                runerror("Implementation of (throw e) is left as an exercise");
+/* throw [[v]] to the nearest [[try-catch]] that has an installed handler 269f */
+                fr = unwindto(HANDLER_CHAIN, evalstack);
+                if (fr == NULL) {
+                    escapefuture(v);  // returns unless a future is running
+                    runerror("Uncaught exception; evaluated (throw e) "
+                             "with no active try-catch");
+                }
+                fn = framevalues(fr)[0];
+                vs = mkVL(v, NULL);
+                e  = fr->syntax;
+                popframe(evalstack);
+                goto apply;
             case LITERAL:  // syntactic values never appear as contexts
             case VAR:
             case LAMBDAX:
@@ -447,19 +617,119 @@ Value eval(Exp e, Env env) {
         assert(0);
 }
 /* eval-stack.c 271 */
-static int isenv(Exp e) {
-    return e && (e->alt == CALLENV || e->alt == LETXENV);
+static int isenv(Frame *fr) {  // escape targets must not be merged away
+    return fr && fr->nslots == 0 && (fr->alt == CALLENV || fr->alt == LETXENV);
 }
                           
 void pushenv_opt(Env env, Expalt context, Stack s) {
-    if (optimize_tail_calls && topframe(s) && isenv(&topframe(s)->context)) {
-        if (context == CALLENV && topframe(s)->context.alt == LETXENV) 
-            topframe(s)->context = mkCallenvStruct(topframe(s)->
-                                                             context.u.letxenv);
+    Frame *fr = topframe(s);
+    if (optimize_tail_calls && isenv(fr)) {
+        if (context == CALLENV && fr->alt == LETXENV) 
+            retagframe(fr, CALLENV, s);
                            /* subtle and quick to anger */
     } else {
-        struct Exp e = context == CALLENV ? mkCallenvStruct(env) :
-                                                           mkLetxenvStruct(env);
-        pushcontext(e, s);
+        pushframe(context, NULL, 0, s)->env = env;
     }
 }
+/* eval-stack.c: threads */
+/*
+ * A suspended thread is a stack whose top frame holds the environment
+ * and value with which it resumes.  [[blocked]] is the call to
+ * [[receive]] that the thread is waiting to retry, or [[NULL]].
+ */
+static void suspend(Stack s, Exp blocked, Env env, Value v) {
+    Frame *fr = pushframe(LETXENV, blocked, 1, s);
+    fr->env = env;
+    pushvalue(fr, v);
+}
+/* eval-stack.c: evaluating while an evaluation waits */
+/*
+ * A primitive that has to wait may evaluate something else in the
+ * meantime by calling [[eval]] again.  It first sets aside the threads
+ * of the evaluation that is waiting, and when the inner evaluation
+ * ends, normally or by an error, it frees the inner evaluation's
+ * threads and restores the waiting ones.  The waiting threads hang
+ * below the inner evaluation's ring, so the collector still sees their
+ * frames, and the registers pushed by the inner evaluation are
+ * discarded with it.
+ */
+struct Evaluation {
+    Stack mainstack, evalstack;
+    int nthreads, nstalled, slice, timeslice;
+    int sp;  // registers pushed
+};
+
+Evaluation saveeval(void) {
+    Evaluation saved = malloc(sizeof(*saved));
+    assert(saved != NULL);
+    saved->mainstack = mainstack;
+    saved->evalstack = evalstack;
+    saved->nthreads  = nthreads;
+    saved->nstalled  = nstalled;
+    saved->slice     = slice;
+    saved->timeslice = timeslice;
+    saved->sp        = roots.registers.sp;
+    mainstack = emptystack();
+    setwaiting(mainstack, saved->mainstack);
+    evalstack = NULL;
+    roots.stack = mainstack;
+    nthreads  = 1;
+    nstalled  = slice = 0;
+    return saved;
+}
+
+static void freethreads(Stack main) {
+    while (nextstack(main) != main) {
+        Stack t = nextstack(main);
+        leavering(t);
+        freestack(t);
+    }
+    freestack(main);
+}
+
+void restoreeval(Evaluation saved) {
+    if (mainstack != NULL)
+        freethreads(mainstack);
+    mainstack = saved->mainstack;
+    evalstack = saved->evalstack;
+    nthreads  = saved->nthreads;
+    nstalled  = saved->nstalled;
+    slice     = saved->slice;
+    timeslice = saved->timeslice;
+    roots.stack = mainstack;
+    roots.registers.sp = saved->sp;
+    free(saved);
+}
+/* eval-stack.c: releasing the threads */
+void freeeval(void) {
+    if (mainstack == NULL)
+        mainstack = roots.stack;  // nothing was evaluated
+    if (mainstack != NULL)
+        freethreads(mainstack);
+    mainstack = evalstack = NULL;
+    roots.stack = NULL;
+    nescapes = nstalled = slice = 0;
+    nthreads = 1;
+}
+/* eval-stack.c: control primitives */
+/*
+ * [[call/cc]], [[call/1cc]], the continuations they capture, the
+ * thread primitives, [[future]], and [[touch]], which may throw, all
+ * change the stack, so [[eval]] applies them itself; these functions
+ * only identify them.  A continuation's tag is its index in the table
+ * kept by [[capturestack]]; an escape continuation's tag is matched
+ * against the value in its frame on the [[ESCAPE_CHAIN]].
+ */
+Value control(Exp e, int tag, Valuelist vs) {
+    (void)tag; (void)vs;
+    runerror("in %e, control primitive applied outside eval", e);
+    return falsev;
+}
+
+Value continuation(Exp e, int tag, Valuelist vs) {
+    return control(e, tag, vs);
+}
+
+Value escape(Exp e, int tag, Valuelist vs) {
+    return control(e, tag, vs);
+}
@@ -152,7 +152,9 @@ static Name strntoname(const char *s, int n) {
     assert(t != NULL);
     strncpy(t, s, n);
     t[n] = '\0';
-    return strtoname(t);
+    Name x = strtoname(t);   /* [[strtoname]] keeps its own copy */
+    free(t);
+    return x;
 }
 /* lex.c S15c */
 static bool brackets_match(char left, char right) {
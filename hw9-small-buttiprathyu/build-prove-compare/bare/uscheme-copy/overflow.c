@@ -1,13 +1,13 @@
 #include "all.h"
 /* overflow.c S29a */
-static volatile char *low_water_mark = NULL;
+static __thread volatile char *low_water_mark = NULL;
 
 #define N 600 /* fuel in units of 10,000 */
 
-static int default_eval_fuel = N * 10000;
-static int eval_fuel         = N * 10000;
-static bool throttled = 1;
-static bool env_checked = 0;
+static __thread int default_eval_fuel = N * 10000;
+static __thread int eval_fuel         = N * 10000;
+static __thread bool throttled = 1;
+static __thread bool env_checked = 0;
 
 int checkoverflow(int limit) {
   volatile char c;
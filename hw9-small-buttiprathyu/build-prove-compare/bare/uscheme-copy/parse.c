@@ -25,6 +25,7 @@ struct Usage usage_table[] = {
     { ANEXP(RETURNX),    "(return exp)" },
     { ANEXP(THROW),      "(throw exp)" },
     { ANEXP(TRY_CATCH),  "(try-catch body handler)" },
+    { SUGAR(FUTUREX),    "(future exp)" },
     { -1, NULL }
 };
 /* parse.c S167c */
@@ -61,10 +62,11 @@ struct ParserRow exptable[] = {
   { "return",    RETURNX,   returnshifts },
   { "throw",     THROW,     returnshifts },
   { "try-catch", TRY_CATCH, tcshifts },
+  { "future",    SUGAR(FUTUREX), returnshifts },
   { NULL,     ANEXP(APPLY),   applyshifts }  // must come last
 };
 /* parse.c S168a */
-bool read_tick_as_quote = true;
+__thread bool read_tick_as_quote = true;
 /* parse.c S168b */
 Exp reduce_to_exp(int code, struct Component *comps) {
     switch(code) {
@@ -82,7 +84,7 @@ Exp reduce_to_exp(int code, struct Component *comps) {
     case ANEXP(APPLY):   return mkApply(comps[0].exp, comps[1].exps);
     case ANEXP(LITERAL):
     { Exp e = mkLiteral(comps[0].value);
-      pushcontext(mkBeginStruct(mkEL(e, NULL)), roots.stack);
+      pushframe(BEGIN, e, 0, roots.stack);
       return e;
     }
     /* cases for \uscheme's [[reduce_to_exp]] added in exercises S169b */
@@ -93,6 +95,9 @@ Exp reduce_to_exp(int code, struct Component *comps) {
     case ANEXP(RETURNX):   return mkReturnx(comps[0].exp);
     case ANEXP(THROW):     return mkThrow(comps[0].exp);
     case ANEXP(TRY_CATCH): return mkTryCatch(comps[0].exp, comps[1].exp);
+    case SUGAR(FUTUREX):   return mkApply(mkLiteral(mkPrimitive(FUTURE, control)),
+                                          mkEL(mkLambdax(mkLambda(NULL,
+                                                         comps[0].exp)), NULL));
     }
     assert(0);
 }
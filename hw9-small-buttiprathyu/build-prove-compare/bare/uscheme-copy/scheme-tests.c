@@ -40,6 +40,7 @@ TestResult test_result(UnitTest t, Env rho) {
             }
             Value check = eval(t->u.check_expect.check,  rho);
             if (setjmp(testjmp)) {
+                popreg(&check);  // the error cut off the popreg below
 
 /* report that evaluating [[t->u.check_expect.expect]] failed with an error S181c */
                 fprint(stderr,
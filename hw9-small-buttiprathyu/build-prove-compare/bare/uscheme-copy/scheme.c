@@ -1,14 +1,6 @@
 #include "all.h"
-/* scheme.c S154b */
-int main(int argc, char *argv[]) {
-    bool interactive = (argc <= 1) || (strcmp(argv[1], "-q") != 0);
-    Prompts prompts = interactive ? STD_PROMPTS : NO_PROMPTS;
-    set_toplevel_error_format(interactive ? WITHOUT_LOCATIONS : WITH_LOCATIONS);
-    if (getenv("NOERRORLOC")) set_toplevel_error_format(WITHOUT_LOCATIONS);
-                                                            /*testing*/ /*OMIT*/
-
-    initvalue();
-    
+/* scheme.c: installing printers in a thread */
+void installprinters(void) {
     /* install printers S155a */
     installprinter('c', printchar);
     installprinter('d', printdecimal);
@@ -25,8 +17,21 @@ int main(int argc, char *argv[]) {
     installprinter('v', printvalue);
     installprinter('V', printvaluelist);
     installprinter('%', printpercent);
+}
+/* scheme.c: initializing an interpreter */
+/*
+ * Every piece of the interpreter's state is thread-local, so a thread
+ * that calls [[initscheme]] gets an interpreter of its own, independent
+ * of those in other threads.  The result points to the thread's global
+ * environment, with the primitives and predefined functions installed.
+ */
+Env *initscheme(void) {
+    static __thread Env env;
+
+    initvalue();
+    installprinters();
 
-    Env env = NULL;
+    env = NULL;
     initallocate(&env);
     /* install primitive functions into [[env]] S151b */
     #define xx(NAME, TAG, FUNCTION) \
@@ -202,19 +207,59 @@ int main(int argc, char *argv[]) {
 
                "(define list7 (x y z a b c d)   (cons x (list6 y z a b c d)))\n"
 
-            "(define list8 (x y z a b c d e) (cons x (list7 y z a b c d e)))\n";
+            "(define list8 (x y z a b c d e) (cons x (list7 y z a b c d e)))\n"
+                            ";  predefined functions on futures \n"
+                            "(define pmap (f xs)\n"
+                            "  (map touch (map (lambda (x) (future (f x))) xs)))\n";
     if (setjmp(errorjmp))
         assert(0);  // fail if error occurs in predefined functions
     readevalprint(stringxdefs("predefined functions", fundefs), &env, NO_ECHOES)
                                                                                ;
+    return &env;
+}
+/* scheme.c: releasing an interpreter */
+/*
+ * [[freescheme]] undoes [[initscheme]]: it stops the threads that run
+ * futures, reports the collector's statistics, and gives back what the
+ * calling thread's interpreter holds, so a thread can start and release
+ * interpreters for as long as it runs.  A worker thread keeps only what
+ * [[eval]] needs, which it releases with [[freeevaluator]] as it quits.
+ */
+void freeevaluator(void) {
+    freeeval();
+    freecontinuations();
+    stack_trace_ring(0, "");  // finishes any binary trace
+    freenames();
+    freeprint();
+    if (errorbuf != NULL)
+        freebuf(&errorbuf);
+}
+
+void freescheme(void) {
+    freefutures();
+    freeallocate();
+    freeevaluator();
+}
+/* scheme.c S154b */
+#ifndef NOMAIN  /* a program that embeds the interpreter has its own main */
+int main(int argc, char *argv[]) {
+    bool interactive = (argc <= 1) || (strcmp(argv[1], "-q") != 0);
+    Prompts prompts = interactive ? STD_PROMPTS : NO_PROMPTS;
+    set_toplevel_error_format(interactive ? WITHOUT_LOCATIONS : WITH_LOCATIONS);
+    if (getenv("NOERRORLOC")) set_toplevel_error_format(WITHOUT_LOCATIONS);
+                                                            /*testing*/ /*OMIT*/
+
+    Env *envp = initscheme();
     extern void dump_env_names(Env); /*OMIT*/
-    if (argv[1] && !strcmp(argv[1], "-names")) { dump_env_names(env); exit(0); }
+    if (argv[1] && !strcmp(argv[1], "-names")) { dump_env_names(*envp); exit(0); }
                                                                         /*OMIT*/
 
     XDefstream xdefs = filexdefs("standard input", stdin, prompts);
 
     while (setjmp(errorjmp))
         ;
-    readevalprint(xdefs, &env, ECHOES);
+    readevalprint(xdefs, envp, ECHOES);
+    freescheme();
     return 0;
 }
+#endif
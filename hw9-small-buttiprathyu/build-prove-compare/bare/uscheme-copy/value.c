@@ -4,7 +4,7 @@ bool istrue(Value v) {
     return v.alt != BOOLV || v.u.boolv;
 }
 
-Value truev, falsev;
+__thread Value truev, falsev;
 
 void initvalue(void) {
     truev  = mkBoolv(true);
@@ -0,0 +1,807 @@
+/* {\Tt all.h} for \uschemeplus 251a */
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __GNUC__
+#define __noreturn __attribute__((noreturn))
+#else
+#define __noreturn
+#endif
+
+/* early type definitions for \uscheme S147c */
+typedef struct Valuelist *Valuelist;     // list of Value
+/* type definitions for \uschemeplus (generated by a script) */
+typedef struct Lambda Lambda; 
+typedef struct Value Value;
+typedef enum {
+    NIL, BOOLV, NUM, SYM, PAIR, CLOSURE, PRIMITIVE, FORWARD, INVALID
+} Valuealt;
+
+/* type definitions for \uschemeplus (generated by a script) */
+typedef struct Def *Def;
+typedef enum { VAL, EXP, DEFINE, DEFS } Defalt; 
+typedef struct XDef *XDef;
+typedef enum { DEF, USE, TEST } XDefalt; 
+typedef struct UnitTest *UnitTest;
+typedef enum { CHECK_EXPECT, CHECK_ASSERT, CHECK_ERROR } UnitTestalt;
+
+typedef struct Exp *Exp;
+typedef enum {
+    LITERAL, VAR, SET, IFX, WHILEX, BEGIN, LETX, LAMBDAX, APPLY, BREAKX,
+    CONTINUEX, RETURNX, THROW, TRY_CATCH, HOLE, WHILE_RUNNING_BODY,
+    CALLENV, LETXENV
+} Expalt;
+
+/* type definitions for \uschemeplus 251b */
+typedef struct Stack *Stack;
+typedef struct Evaluation *Evaluation;  // an evaluation set aside
+typedef struct Conttable *Conttable;    // the continuations of one interpreter
+typedef struct Frame Frame;
+/* type definitions for \uschemeplus 303a */
+typedef Value *Register;  /* pointer to a local variable or a parameter
+                             of a C function that could allocate */
+typedef struct Registerlist *Registerlist;   /* list of Register */
+typedef struct UnitTestlistlist *UnitTestlistlist;
+                                               /* list of UnitTestlist (list) */
+typedef struct Heap *Heap;             // what a collector keeps
+typedef struct Envtable *Envtable;     // the binding records of one interpreter
+typedef struct Sharedheap *Sharedheap; // a heap and the threads that share it
+/* type definitions for \uscheme 151b */
+typedef enum Letkeyword { LET, LETSTAR, LETREC } Letkeyword;
+/* type definitions for \uscheme 151d */
+typedef Value (Primitive)(Exp e, int tag, Valuelist vs);
+/* type definitions for \uscheme 162a */
+typedef struct Env *Env;
+/* type definitions for \uscheme S147b */
+typedef struct UnitTestlist  *UnitTestlist;  // list of UnitTest 
+typedef struct Explist  *Explist;            // list of Exp 
+typedef struct Deflist  *Deflist;            // list of Def    /*OMIT*/
+/* type definitions for \uscheme S151a */
+enum {
+  #define xx(NAME, TAG, FUNCTION) TAG,
+  #include "prim.h"
+  #undef xx
+  UNUSED_TAG
+};
+/* shared type definitions 42b */
+typedef struct Name *Name;
+typedef struct Namelist *Namelist;   // list of Name
+typedef struct Nametable *Nametable; // the names of one interpreter
+/* shared type definitions S39b */
+typedef struct ParserState *ParserState;
+typedef struct ParsingContext *ParsingContext;
+/* shared type definitions S40a */
+typedef enum ParserResult {
+  PARSED,            /* some input was parsed without any errors */
+  INPUT_EXHAUSTED,   /* there aren't enough inputs */
+  INPUT_LEFTOVER,    /* there are too many inputs */
+  BAD_INPUT,         /* an input wasn't what it should have been */
+  STOP_PARSING       /* all the inputs have been parsed; it's time to stop */
+} ParserResult;
+/* shared type definitions S40b */
+typedef ParserResult (*ShiftFun)(ParserState);
+/* shared type definitions S44c */
+typedef struct ParserRow *ParserTable;
+/* shared type definitions S52a */
+enum Sugar {
+  CAND, COR,    /* short-circuit Boolean operators */
+
+  WHILESTAR, DO_WHILE, FOR,     /* bonus loop forms */
+
+  WHEN, UNLESS,       /* single-sided conditionals */
+
+  RECORD,             /* record-type definition */
+
+  COND,               /* McCarthy's conditional from Lisp */
+
+  FUTUREX             /* (future e), which applies future to a thunk */
+
+};
+/* shared type definitions (generated by a script) */
+typedef struct Par *Par;
+typedef enum { ATOM, LIST } Paralt; 
+/* shared type definitions S6a */
+typedef struct Linestream *Linestream;
+/* shared type definitions S9c */
+typedef struct Parlist *Parlist; /* list of Par */
+/* shared type definitions S9d */
+typedef struct Parstream *Parstream;
+/* shared type definitions S16b */
+typedef struct Printbuf *Printbuf;
+/* shared type definitions S19c */
+/* definition of [[va_list_box]] S19d */
+typedef struct va_list_box {
+  va_list ap;
+} va_list_box;
+typedef void Printer(Printbuf output, va_list_box *args);
+/* shared type definitions S128d */
+typedef struct XDefstream *XDefstream;
+/* shared type definitions S128g */
+typedef enum Prompts { NO_PROMPTS, STD_PROMPTS } Prompts;
+/* shared type definitions S129b */
+typedef enum Echo { NO_ECHOES, ECHOES } Echo;
+/* shared type definitions S129d */
+typedef struct Sourceloc *Sourceloc;
+/* shared type definitions S129e */
+typedef enum ErrorFormat { WITH_LOCATIONS, WITHOUT_LOCATIONS } ErrorFormat;
+/* shared type definitions S136d */
+typedef enum TestResult { TEST_PASSED, TEST_FAILED } TestResult;
+
+/* structure definitions for \uschemeplus (generated by a script) */
+struct Lambda { Namelist formals; Exp body; }; 
+struct Value {
+    Valuealt alt;
+    union {
+        bool boolv;
+        int num;
+        Name sym;
+        struct { Value *car; Value *cdr; } pair;
+        struct { Lambda lambda; Env env; } closure;
+        struct { int tag; Primitive *function; } primitive;
+        Value *forward;
+        const char *invalid;
+    } u;
+};
+
+/* structure definitions for \uschemeplus (generated by a script) */
+struct Def {
+    Defalt alt;
+    union {
+        struct { Name name; Exp exp; } val;
+        Exp exp;
+        struct { Name name; Lambda lambda; } define;
+        Deflist defs;
+    } u;
+};
+
+struct XDef {
+    XDefalt alt; union { Def def; Name use; UnitTest test; } u;
+};
+
+struct UnitTest {
+    UnitTestalt alt;
+    union {
+        struct { Exp check; Exp expect; } check_expect;
+        Exp check_assert;
+        Exp check_error;
+    } u;
+};
+
+struct Exp {
+    Expalt alt;
+    union {
+        Value literal;
+        Name var;
+        struct { Name name; Exp exp; } set;
+        struct { Exp cond; Exp truex; Exp falsex; } ifx;
+        struct { Exp cond; Exp body; } whilex;
+        Explist begin;
+        struct { Letkeyword let; Namelist xs; Explist es; Exp body; } letx;
+        Lambda lambdax;
+        struct { Exp fn; Explist actuals; } apply;
+        Exp returnx;
+        Exp throw;
+        struct { Exp body; Exp handler; } try_catch;
+        Env callenv;
+        Env letxenv;
+    } u;
+};
+
+/* structure definitions for \uschemeplus (generated by a script) */
+struct Parlist {
+   Par hd;
+   struct Parlist *tl;
+};
+
+struct Namelist {
+   Name hd;
+   struct Namelist *tl;
+};
+
+struct UnitTestlist {
+   UnitTest hd;
+   struct UnitTestlist *tl;
+};
+
+struct Explist {
+   Exp hd;
+   struct Explist *tl;
+};
+
+struct Deflist {
+   Def    /*OMIT*/ hd;
+   struct Deflist *tl;
+};
+
+struct Valuelist {
+   Value hd;
+   struct Valuelist *tl;
+};
+
+struct Registerlist {
+   Register hd;
+   struct Registerlist *tl;
+};
+
+struct UnitTestlistlist {
+   UnitTestlist hd;
+   struct UnitTestlistlist *tl;
+};
+
+/* structure definitions for \uschemeplus 252a */
+typedef enum {
+    HANDLER_CHAIN, CALL_CHAIN, LOOP_CHAIN, ESCAPE_CHAIN, NCHAINS
+} Framechain;
+/*
+ * A frame records what kind of context it is, its depth, the
+ * expression that pushed it, at most three operand words, and a link
+ * along its chain; there is no embedded [[struct Exp]].  A frame that
+ * collects values has [[nslots]] of them laid out directly below it on
+ * the stack.
+ */
+struct Frame {
+    unsigned char alt;      // an Expalt: the kind of context
+    unsigned char let;      // a Letkeyword, for a LETX context
+    unsigned short nslots;  // room for values below the frame
+    unsigned short nvalues; // values saved so far
+    int depth;              // frames on the stack, counting this one
+    Exp syntax;             // the expression that pushed the frame, or NULL
+    Explist es;             // expressions not yet evaluated
+    Namelist xs;            // names not yet bound (let* only)
+    Env env;                // the saved environment (LETXENV and CALLENV)
+    Frame *link;            // next older frame on the same chain
+};
+/* structure definitions for \uschemeplus 307c */
+struct Env {
+    Name name;
+    Value *loc;
+    Env tl;
+    unsigned live;  /* mark bit, set by the garbage collector */
+};
+/* structure definitions for \uscheme S166d */
+struct Component {
+    Exp exp;
+    Explist exps;
+    Name name;
+    Namelist names;
+    Value value;
+    /* fields of \uscheme\ [[Component]] added in exercises S168d */
+    /* if implementing COND, add a question-answer field here */
+    /* fields of \uscheme\ [[Component]] added in exercises S507b */
+    // for COND:
+    struct qa_pairs { Explist questions; Explist answers; } qa_pairs;
+};
+/* shared structure definitions S39a */
+#define MAXCOMPS 4 /* max # of components in any syntactic form */
+struct ParserState {
+    int nparsed;           /* number of components parsed so far */
+    struct Component components[MAXCOMPS];  /* those components */
+    Parlist input;         /* the part of the input not yet parsed */
+
+    struct ParsingContext {   /* context of this parse */
+        Par par;       /* the original thing we are parsing */
+        struct Sourceloc {
+            int line;                /* current line number */
+            const char *sourcename;  /* where the line came from */
+        } *source;
+        Name name;     /* a keyword, or name of a function being defined */
+    } context;
+};
+/* shared structure definitions S43d */
+struct ParserRow {
+    const char *keyword;
+    int code;
+    ShiftFun *shifts;  /* points to array of shift functions */
+};
+/* shared structure definitions (generated by a script) */
+struct Par { Paralt alt; union { Name atom; Parlist list; } u; }; 
+/* shared structure definitions S7a */
+struct Linestream {
+    char *buf;               /* holds the last line read */
+    int bufsize;                /* size of buf */
+
+    struct Sourceloc source; /* where the last line came from */
+    FILE *fin;               /* non-NULL if filelines */
+    const char *s;           /* non-NULL if stringlines */
+};
+
+/* function prototypes for \uschemeplus S214a */
+void cyclecheck(Value *l);
+/* function prototypes for \uschemeplus (generated by a script) */
+Lambda mkLambda(Namelist formals, Exp body);
+Value mkNil(void);
+Value mkBoolv(bool boolv);
+Value mkNum(int num);
+Value mkSym(Name sym);
+Value mkPair(Value *car, Value *cdr);
+Value mkClosure(Lambda lambda, Env env);
+Value mkPrimitive(int tag, Primitive *function);
+Value mkForward(Value *forward);
+Value mkInvalid(const char *invalid);
+/* function prototypes for \uschemeplus (generated by a script) */
+Def mkVal(Name name, Exp exp);
+Def mkExp(Exp exp);
+Def mkDefine(Name name, Lambda lambda);
+Def mkDefs(Deflist defs);
+struct Def mkValStruct(Name name, Exp exp);
+struct Def mkExpStruct(Exp exp);
+struct Def mkDefineStruct(Name name, Lambda lambda);
+struct Def mkDefsStruct(Deflist defs);
+XDef mkDef(Def def);
+XDef mkUse(Name use);
+XDef mkTest(UnitTest test);
+struct XDef mkDefStruct(Def def);
+struct XDef mkUseStruct(Name use);
+struct XDef mkTestStruct(UnitTest test);
+UnitTest mkCheckExpect(Exp check, Exp expect);
+UnitTest mkCheckAssert(Exp check_assert);
+UnitTest mkCheckError(Exp check_error);
+struct UnitTest mkCheckExpectStruct(Exp check, Exp expect);
+struct UnitTest mkCheckAssertStruct(Exp check_assert);
+struct UnitTest mkCheckErrorStruct(Exp check_error);
+Exp mkLiteral(Value literal);
+Exp mkVar(Name var);
+Exp mkSet(Name name, Exp exp);
+Exp mkIfx(Exp cond, Exp truex, Exp falsex);
+Exp mkWhilex(Exp cond, Exp body);
+Exp mkBegin(Explist begin);
+Exp mkLetx(Letkeyword let, Namelist xs, Explist es, Exp body);
+Exp mkLambdax(Lambda lambdax);
+Exp mkApply(Exp fn, Explist actuals);
+Exp mkBreakx(void);
+Exp mkContinuex(void);
+Exp mkReturnx(Exp returnx);
+Exp mkThrow(Exp throw);
+Exp mkTryCatch(Exp body, Exp handler);
+Exp mkHole(void);
+Exp mkWhileRunningBody(void);
+Exp mkCallenv(Env callenv);
+Exp mkLetxenv(Env letxenv);
+struct Exp mkLiteralStruct(Value literal);
+struct Exp mkVarStruct(Name var);
+struct Exp mkSetStruct(Name name, Exp exp);
+struct Exp mkIfxStruct(Exp cond, Exp truex, Exp falsex);
+struct Exp mkWhilexStruct(Exp cond, Exp body);
+struct Exp mkBeginStruct(Explist begin);
+struct Exp mkLetxStruct(Letkeyword let, Namelist xs, Explist es, Exp body);
+struct Exp mkLambdaxStruct(Lambda lambdax);
+struct Exp mkApplyStruct(Exp fn, Explist actuals);
+struct Exp mkBreakxStruct(void);
+struct Exp mkContinuexStruct(void);
+struct Exp mkReturnxStruct(Exp returnx);
+struct Exp mkThrowStruct(Exp throw);
+struct Exp mkTryCatchStruct(Exp body, Exp handler);
+struct Exp mkHoleStruct(void);
+struct Exp mkWhileRunningBodyStruct(void);
+struct Exp mkCallenvStruct(Env callenv);
+struct Exp mkLetxenvStruct(Env letxenv);
+/* function prototypes for \uschemeplus (generated by a script) */
+int     lengthPL(Parlist ps);
+Par     nthPL   (Parlist ps, unsigned n);
+Parlist mkPL    (Par p, Parlist ps);
+Parlist popPL   (Parlist ps);
+Printer printparlist;
+
+int      lengthNL(Namelist ns);
+Name     nthNL   (Namelist ns, unsigned n);
+Namelist mkNL    (Name n, Namelist ns);
+Namelist popNL   (Namelist ns);
+Printer  printnamelist;
+
+int          lengthUL(UnitTestlist us);
+UnitTest     nthUL   (UnitTestlist us, unsigned n);
+UnitTestlist mkUL    (UnitTest u, UnitTestlist us);
+UnitTestlist popUL   (UnitTestlist us);
+Printer      printunittestlist;
+
+int     lengthEL(Explist es);
+Exp     nthEL   (Explist es, unsigned n);
+Explist mkEL    (Exp e, Explist es);
+Explist popEL   (Explist es);
+Printer printexplist;
+
+int     lengthDL(Deflist ds);
+Def    /*OMIT*/ nthDL   (Deflist ds, unsigned n);
+Deflist mkDL    (Def    /*OMIT*/ d, Deflist ds);
+Deflist popDL   (Deflist ds);
+Printer printdeflist;
+
+int       lengthVL(Valuelist vs);
+Value     nthVL   (Valuelist vs, unsigned n);
+Valuelist mkVL    (Value v, Valuelist vs);
+Valuelist popVL   (Valuelist vs);
+Printer   printvaluelist;
+
+int          lengthRL(Registerlist rs);
+Register     nthRL   (Registerlist rs, unsigned n);
+Registerlist mkRL    (Register r, Registerlist rs);
+Registerlist popRL   (Registerlist rs);
+Printer      printregisterlist;
+
+int              lengthULL(UnitTestlistlist uss);
+UnitTestlist     nthULL   (UnitTestlistlist uss, unsigned n);
+UnitTestlistlist mkULL    (UnitTestlist us, UnitTestlistlist uss);
+UnitTestlistlist popULL   (UnitTestlistlist uss);
+Printer          printunittestlistlist;
+
+/* function prototypes for \uschemeplus 252b */
+Stack  emptystack  (void);
+Frame *pushframe   (Expalt alt, Exp syntax, int nslots, Stack s);
+void   popframe    (Stack s);
+void   clearstack  (Stack s);
+void   freestack   (Stack s);  // s must have left the ring
+void   joinring    (Stack s, Stack ring);  // s runs just before ring
+void   leavering   (Stack s);
+Stack  nextstack   (Stack s);  // next thread on the ring
+void   setwaiting  (Stack s, Stack waiting);  // walking s walks waiting too
+void   retagframe  (Frame *fr, Expalt alt, Stack s);  // fr must be on top
+int    chaindepth  (Framechain k, Stack s);  // depth of nearest frame, or 0
+int    stackdepth  (Stack s);  // frames on s
+Frame *unwindto    (Framechain k, Stack s);  // pops frames above nearest
+int    stacksegments(Stack s);  // segments holding frames, over the rings
+void   walkstack   (Stack s, int lo, int hi, void (*visit)(Frame *, void *),
+                    void *cl);  // frames in segments [lo, hi) of the rings
+int    capturestack(Stack s);   // seals s's frames; returns a continuation
+void   resumestack (int k, Stack s);  // s's frames become k's
+void   markcontinuation  (int k);
+bool   tracecontinuations(void (*visit)(Frame *, void *), void *cl);
+int    sweepcontinuations(void);  // free unmarked ones; return # live
+Conttable conttable   (void);         // the current interpreter's continuations
+void      useconttable(Conttable t);  // share another thread's continuations
+/* function prototypes for \uschemeplus 252c */
+Frame *topframe (Stack s);  // NULL if empty
+/* function prototypes for \uschemeplus 252d */
+void   pushenv_opt (Env env, Expalt context, Stack s);  // may optimize
+/* function prototypes for \uschemeplus 253a */
+void stack_trace_init(int *countp);  // how many steps to show
+void stack_trace_ring(int capacity, const char *filename);  // binary trace
+/* function prototypes for futures */
+extern bool heap_is_shared;   // may threads allocate and read at once?
+void  setfuturethreads(int n);  // workers wanted; negative for one per CPU
+int   futurethreads   (void);   // workers wanted; 0 runs futures at once
+Value mkfuture        (Exp source, Value thunk);  // queues (thunk) on the pool
+Value touchfuture     (Exp e, Value v, bool *thrown);  // waits for v
+void  escapefuture    (Value v);  // ends a running future by throwing v
+int   futureworker    (void);   // number of this worker, 0 if not one
+void  markfuture      (int k);
+bool  tracefutures    (void (*visit)(Value *));
+int   sweepfutures    (void);   // recycle unmarked ones; return # live
+/* function prototypes for sharing the heap */
+Sharedheap sharedheap   (void);  // the calling thread's heap, for its workers
+void       joinheap     (Sharedheap h);  // a worker starts to allocate from h
+void       quitheap     (void);  // a worker stops, before it quits
+void       beginblocking(void);  // the thread waits; collections need not
+void       endblocking  (void);  // the thread runs again, after any collection
+void stack_trace_current_expression(Exp e,   Env rho, Stack s);
+void stack_trace_current_value     (Value v, Env rho, Stack s);
+/* function prototypes for \uschemeplus 253b */
+Value getoption(Name name, Env env, Value defaultval);
+/* function prototypes for \uschemeplus 253c */
+Value validate(Value v);
+/* function prototypes for \uschemeplus 260a */
+Exp       nextpending    (Frame *fr);         // NULL when none are pending
+void      pushvalue      (Frame *fr, Value v);
+Value    *framevalues    (Frame *fr);
+Valuelist framevaluelist (Frame *fr, int first);
+/* function prototypes for \uschemeplus 261b */
+void freeVL(Valuelist vs);
+/* function prototypes for \uschemeplus S191c */
+void printstack   (FILE *, va_list_box*);
+void printoneframe(FILE *, va_list_box*);
+void printframe   (FILE *, Frame *fr);
+void printnoenv   (FILE *, va_list_box*);
+/* function prototypes for \uschemeplus 304b */
+#ifndef DEBUG_GC_REGISTERS    /*OMIT*/
+void pushreg(Value *reg);
+void popreg (Value *reg);
+#endif  /*OMIT*/
+/* function prototypes for \uschemeplus 304c */
+void pushregs(Valuelist regs);
+void popregs (Valuelist regs);
+/* function prototypes for \uschemeplus 321a */
+void gc_debug_post_acquire(Value *mem, unsigned nvalues); 
+/* function prototypes for \uschemeplus 321b */
+void gc_debug_pre_release(Value *mem, unsigned nvalues); 
+/* function prototypes for \uschemeplus 321c */
+void gc_debug_pre_allocate(Value *mem); 
+/* function prototypes for \uschemeplus 321d */
+void gc_debug_post_reclaim(Value *mem); 
+/* function prototypes for \uschemeplus 321e */
+void gc_debug_post_reclaim_block(Value *mem, unsigned nvalues); 
+/* function prototypes for \uschemeplus 321f */
+Value validate(Value v);
+/* function prototypes for \uschemeplus 321g */
+void gcprint (const char *fmt, ...);  /* print GC debugging info */
+void gcprintf(const char *fmt, ...);
+/* function prototypes for \uschemeplus 321h */
+void gc_debug_init(void);
+/* function prototypes for \uscheme S207b */
+int gammadesired(int defaultval, int minimum);
+int gammashrink (int defaultval, int minimum);
+/* function prototypes for \uscheme 162b */
+Value *find(Name name, Env env);
+/* function prototypes for \uscheme 163a */
+Env bindalloc    (Name name,   Value v,      Env env);
+Env bindalloclist(Namelist xs, Valuelist vs, Env env);
+/* function prototypes for collecting binding records */
+bool markenv  (Env env);    /* true if env was not already marked */
+int  sweepenvs(void);       /* free unmarked records; return # live */
+void updateenvlocs(Value *(*update)(Value *loc)); /* for each live record */
+Envtable envtable      (void);        /* the current interpreter's records */
+void     useenvtable   (Envtable t);  /* share another thread's records */
+void     retirebindings(void);        /* forget the records taken, unused */
+/* function prototypes for stopping the world */
+bool  collectionpending(void);   /* is a thread waiting to collect? */
+void  safepoint   (void);        /* waits here for a pending collection */
+bool  stopworld   (void);        /* false if another thread collected instead */
+void  startworld  (void);
+struct Roots **allroots(int *n); /* every thread's roots, while stopped */
+Heap  gcheap      (void);        /* the current interpreter's heap */
+void  usegcheap   (Heap h);      /* share another thread's heap */
+void  retirebuffer(void);        /* give back the thread's allocation buffer */
+/* function prototypes for \uscheme 163b */
+Value *allocate(Value v);
+/* function prototypes for \uscheme 163c */
+extern __thread Value truev, falsev;
+/* function prototypes for \uscheme 163d */
+bool istrue(Value v);
+/* function prototypes for \uscheme 163e */
+Value unspecified(void);
+/* function prototypes for \uscheme 164 */
+Value eval   (Exp e, Env rho);
+Env   evaldef(Def d, Env rho, Echo echo);
+Evaluation saveeval   (void);  // lets eval be called from a primitive
+void       restoreeval(Evaluation saved);
+/* function prototypes for \uscheme ((elided)) (THIS CAN'T HAPPEN -- claimed code was not used) */
+Exp desugarLetStar(Namelist xs, Explist es, Exp body);
+Exp desugarLet    (Namelist xs, Explist es, Exp body);
+/* function prototypes for \uscheme S148b */
+void initallocate(Env *globals);
+/* function prototypes for \uscheme S148c */
+void initvalue(void);
+Env *initscheme(void);  // a fresh interpreter for the calling thread
+void installprinters(void);
+void freescheme(void);     // releases the calling thread's interpreter
+void freeevaluator(void);  // releases what eval keeps in the calling thread
+/* function prototypes for releasing an interpreter */
+void freeallocate     (void);  // undoes initallocate
+void freeheap         (void);  // the collector's memory
+void freebindings     (void);  // every binding record
+void freeeval         (void);  // every thread's stack
+void freecontinuations(void);
+void freefutures      (void);  // joins the workers
+void freenames        (void);
+void freeprint        (void);
+/* function prototypes for \uscheme S149a */
+void readevalprint(XDefstream xdefs, Env *envp, Echo echo);
+/* function prototypes for \uscheme S149b */
+void addprimitives(Env *envp);
+/* function prototypes for \uscheme S149c */
+void printenv    (Printbuf, va_list_box*);
+void printvalue  (Printbuf, va_list_box*);
+void printexp    (Printbuf, va_list_box*);
+void printdef    (Printbuf, va_list_box*);
+void printlambda (Printbuf, va_list_box*);
+/* function prototypes for \uscheme S150c */
+void process_tests(UnitTestlist tests, Env rho);
+/* function prototypes for \uscheme S152c */
+Value cons(Value v, Value w);
+Value equalatoms(Value v, Value w);
+/* function prototypes for \uscheme S170a */
+Value parsesx(Par p, Sourceloc source);
+struct Component parseletbindings(ParsingContext context, Parlist input);
+/* function prototypes for \uscheme S179b */
+int number_of_good_tests(UnitTestlist tests, Env rho);
+/* function prototypes for \uscheme S179d */
+TestResult test_result(UnitTest t, Env rho);
+/* function prototypes for \uscheme S181g */
+bool equalpairs(Value v, Value w);
+/* function prototypes for \uscheme S183a */
+Name namecat(Name n1, Name n2);
+/* function prototypes for \uscheme 304d */
+Value *allocloc(void);
+/* function prototypes for \uscheme 304e */
+void initallocate(Env *globals);
+/* function prototypes for \uscheme S505g */
+Exp desugarAnd(Explist args);
+/* function prototypes for \uscheme S506b */
+Namelist freevars(Exp e, Namelist bound, Namelist free);
+/* function prototypes for \uscheme S506f */
+Exp desugarOr(Explist args);
+/* function prototypes for \uscheme S507d */
+Exp desugarCond(Explist questions, Explist answers);
+/* function prototypes for \uscheme S509f */
+Deflist desugarRecord(Name recname, Namelist fieldnames);
+/* shared function prototypes 42c */
+Name strtoname(const char *s);
+const char *nametostr(Name x);
+Nametable nametable   (void);         // the current interpreter's names
+void      usenametable(Nametable t);  // share another thread's names
+/* shared function prototypes 46b */
+void print (const char *fmt, ...);  // print to standard output
+void fprint(FILE *output, const char *fmt, ...);  // print to given file
+/* shared function prototypes 47a */
+__noreturn // OMIT
+void runerror (const char *fmt, ...);
+extern __thread jmp_buf errorjmp;        // longjmp here on error
+/* shared function prototypes 47b */
+__noreturn // OMIT
+void synerror (Sourceloc src, const char *fmt, ...);
+/* shared function prototypes 48a */
+void checkargc(Exp e, int expected, int actual);
+/* shared function prototypes 48b */
+Name duplicatename(Namelist names);
+/* shared function prototypes S34a */
+Exp  parseexp (Par p, Sourceloc source);
+XDef parsexdef(Par p, Sourceloc source);
+/* shared function prototypes S34b */
+Exp exp_of_atom(Sourceloc loc, Name atom);
+/* shared function prototypes S37b */
+Exp  reduce_to_exp (int alt, struct Component *components);
+XDef reduce_to_xdef(int alt, struct Component *components);
+/* shared function prototypes S39d */
+struct ParserState mkParserState(Par p, Sourceloc source);
+/* shared function prototypes S40c */
+ParserResult sExp     (ParserState state);  /* shift 1 input into Exp */
+ParserResult sExps    (ParserState state);  /* shift all inputs into Explist */
+ParserResult sName    (ParserState state);  /* shift 1 input into Name */
+ParserResult sNamelist(ParserState state);  /* shift 1 input into Namelist */
+/* shared function prototypes S40e */
+void halfshift(ParserState state); /* advance input, check for room in output */
+/* shared function prototypes S41c */
+Explist parseexplist(Parlist p, Sourceloc source);
+/* shared function prototypes S41e */
+Name parsename(Par p, ParsingContext context);
+/* shared function prototypes S42d */
+ParserResult stop(ParserState state);
+/* shared function prototypes S42f */
+ParserResult setcontextname(ParserState state);
+/* shared function prototypes S43c */
+ParserResult sLocals(ParserState state);  // shift locals if (locals x y z ...)
+/* shared function prototypes S44b */
+void rowparse(struct ParserRow *table, ParserState s);
+void usage_error(int alt, ParserResult r, ParsingContext context);
+/* shared function prototypes S44e */
+struct ParserRow *tableparse(ParserState state, ParserTable t);
+/* shared function prototypes S47d */
+ParserResult use_exp_parser(ParserState state);
+/* shared function prototypes S51c */
+int code_of_name(Name n);
+/* shared function prototypes S51d */
+void check_exp_duplicates(Sourceloc source, Exp e);
+void check_def_duplicates(Sourceloc source, Def d);
+/* shared function prototypes (generated by a script) */
+Par mkAtom(Name atom);
+Par mkList(Parlist list);
+struct Par mkAtomStruct(Name atom);
+struct Par mkListStruct(Parlist list);
+/* shared function prototypes S6b */
+char *getline_(Linestream r, const char *prompt);
+/* shared function prototypes S6c */
+Linestream stringlines(const char *stringname, const char *s);
+Linestream filelines  (const char *filename,   FILE *fin);
+/* shared function prototypes S9e */
+Parstream parstream(Linestream lines, Prompts prompts);
+Par       getpar   (Parstream r);
+Sourceloc parsource(Parstream pars);
+/* shared function prototypes S10a */
+extern __thread bool read_tick_as_quote;
+/* shared function prototypes S16c */
+Printbuf printbuf(void);
+void freebuf(Printbuf *);
+/* shared function prototypes S16d */
+void bufput(Printbuf, char);
+void bufputs(Printbuf, const char*);
+void bufreset(Printbuf);
+/* shared function prototypes S16e */
+char *bufcopy(Printbuf);
+void fwritebuf(Printbuf buf, FILE *output);
+/* shared function prototypes S19a */
+void print (const char *fmt, ...);                /* print to standard output */
+void fprint(FILE *output, const char *fmt, ...);     /* print to given file */
+void bprint(Printbuf output, const char *fmt, ...);  /* print to given buffer */
+/* shared function prototypes S19b */
+void installprinter(unsigned char specifier, Printer *take_and_print);
+/* shared function prototypes S20a */
+void vbprint(Printbuf output, const char *fmt, va_list_box *box);
+/* shared function prototypes S22c */
+Printer printpercent, printstring, printdecimal, printchar, printname;
+/* shared function prototypes S23d */
+Printer printpar;
+/* shared function prototypes S24a */
+typedef enum ErrorMode { NORMAL, TESTING } ErrorMode;
+void set_error_mode(ErrorMode mode);
+ErrorMode error_mode(void);
+extern __thread jmp_buf testjmp;    /* longjmp here on error in a test */
+extern __thread Printbuf errorbuf;   /* message of an error in a test */
+/* shared function prototypes S28 */
+extern int  checkoverflow(int limit);
+extern void reset_overflow_check(void);
+/* shared function prototypes S30a */
+extern void checkarith(char operation, int32_t n, int32_t m, int precision);
+/* shared function prototypes S31a */
+void fprint_utf8(FILE *output, unsigned code_point);
+void print_utf8 (unsigned u);
+/* shared function prototypes S128e */
+XDef getxdef(XDefstream xdefs);
+/* shared function prototypes S128f */
+XDefstream stringxdefs(const char *stringname, const char *input);
+XDefstream filexdefs  (const char *filename, FILE *input, Prompts prompts);
+/* shared function prototypes S129c */
+void installprinter(unsigned char c, Printer *take_and_print);
+/* shared function prototypes S129f */
+void set_toplevel_error_format(ErrorFormat format);
+/* shared function prototypes S136b */
+void report_test_results(int npassed, int ntests);
+/* shared function prototypes S139d */
+Printer printexp, printdef, printvalue, printfun;
+/* shared function prototypes S150d */
+Primitive arith, binary, unary, channel;
+Primitive control, continuation, escape;  // applied by eval itself
+Primitive future;  // a future's value, which only touch may take
+/* shared function prototypes S167b */
+ParserResult sSexp    (ParserState state);
+ParserResult sBindings(ParserState state);
+
+/* global variables for \uschemeplus 252e */
+extern __thread int high_stack_mark;
+/* global variables for \uschemeplus 252f */
+extern __thread int optimize_tail_calls;
+extern __thread int show_high_stack_mark;
+extern __thread int max_stack_depth;     // frames allowed on the stack
+#define MAXSTACKDEPTH 1000000  /* default for &max-stack-depth */
+
+/* macro definitions used in parsing S38a */
+#define ANEXP(ALT)  (  0+(ALT))
+#define ADEF(ALT)   (100+(ALT))
+#define ATEST(ALT)  (200+(ALT))
+#define ANXDEF(ALT) (300+(ALT))
+#define ALET(ALT)   (400+(ALT))
+#define SUGAR(CODE) (500+(CODE))
+#define LATER       1000
+#define EXERCISE    1001
+/* declarations of global variables used in lexical analysis and parsing S45b */
+extern struct ParserRow exptable[];
+extern struct ParserRow xdeftable[];
+/* declarations of global variables used in lexical analysis and parsing S49b */
+extern struct Usage {
+    int code;
+                         /* codes for form in reduce_to_exp or reduce_to_xdef */
+    const char *expected;  /* shows the expected usage of the identified form */
+} usage_table[];
+/* {\Tt all.h} for \uschemeplus 304a */
+/* structure definitions used in garbage collection */
+/*
+ * The registers form a shadow stack kept in one growable array,
+ * so [[pushreg]] and [[popreg]] never allocate.
+ */
+struct Registerstack {
+    Register *regs;  // memory for 'size' registers
+    int size;
+    int sp;          // number of registers pushed
+};
+/* structure definitions used in garbage collection 303b */
+struct Roots {
+    struct {
+        Env *user;              // global variables from the user's program 
+        struct {
+            UnitTestlistlist pending_tests; // unit tests waiting to be run
+        } internal;             // the interpreter's internal variables
+    } globals;                  // all the global variables
+    Stack stack;
+                           // the uscheme+ stack, with all parameters and locals
+    struct Registerstack registers; // pointers to 'machine registers'
+};
+/* global variables used in garbage collection S208c */
+extern int gc_uses_mark_bits;
+/* global variables used in garbage collection 303c */
+extern __thread struct Roots roots;
@@ -0,0 +1,42 @@
+#include "all.h"
+/* context-lists.c S193e */
+/*
+ * While the actual parameters of an [[APPLY]], or the right-hand sides
+ * of a [[LET]] or [[LETREC]], are being evaluated, the frame shares its
+ * [[Explist]] with the abstract syntax, which is never mutated.  The
+ * frame instead records the expressions still pending, and it saves
+ * each value in one of the slots reserved below it when it was pushed.
+ */
+/* context-lists.c: values in frames */
+Exp nextpending(Frame *fr) {
+  Explist es = fr->es;
+  if (es == NULL)
+    return NULL;
+  fr->es = es->tl;
+  return es->hd;
+}
+
+void pushvalue(Frame *fr, Value v) {
+  assert(fr->nvalues < fr->nslots);
+  framevalues(fr)[fr->nvalues++] = v;
+}
+
+Value *framevalues(Frame *fr) {
+  return (Value *)fr - fr->nslots;
+}
+
+Valuelist framevaluelist(Frame *fr, int first) {
+  Value *vals = framevalues(fr);
+  Valuelist vs = NULL;
+  int i;
+  for (i = fr->nvalues - 1; i >= first; i--)
+    vs = mkVL(validate(vals[i]), vs);
+  return vs;
+}
+/* context-lists.c S195b */
+void freeVL(Valuelist vs) {
+  if (vs != NULL) {
+    freeVL(vs->tl);
+    free(vs);
+  }
+}
@@ -0,0 +1,703 @@
+#include "all.h"
+#include <pthread.h>
+/* context-stack.c S189b */
+/*
+ * The stack grows in linked segments, so enlarging it never copies a
+ * frame.  Within a segment, each frame sits directly above the value
+ * slots it reserves, and the top frame always ends at [[seg->top]].
+ * When the stack shrinks out of a segment, that segment is kept as a
+ * spare, so a computation that hovers near a segment boundary does not
+ * allocate on every call.
+ *
+ * Installed handlers, CALLENV frames, loops whose bodies are running,
+ * and the targets of escape continuations are each on a chain, linked
+ * newest first through the frames themselves.  Each frame records its
+ * depth, so [[throw]], [[return]], [[break]], and [[continue]] cut the
+ * stack back to their target in one step, without visiting the frames
+ * in between.
+ *
+ * Capturing a continuation copies nothing: the segments in use are
+ * sealed, and the stack carries on in a fresh segment above them.
+ * A sealed segment is never written again, so it can be shared by any
+ * number of continuations and stacks, and it is freed when the last of
+ * them lets go.  Only when the stack returns into a sealed frame is
+ * that one frame copied back into the active segment; resuming a
+ * continuation costs no more than capturing one.
+ *
+ * The stacks of all threads form a ring.  Walking any stack in the
+ * ring walks them all, so a collector that walks [[roots.stack]]
+ * reaches the frames of every thread.  When [[eval]] is called while
+ * another evaluation waits, the new ring's first stack points to the
+ * waiting ring, and walking it walks the waiting ring too.
+ */
+#ifndef GCHYPERDEBUG
+#define SEGMENTSIZE 65536       /* bytes of frames in a typical segment */
+#define SMALLSEGMENT 1024       /* bytes in a new stack's first segment,
+                                   and in the segment begun by a capture */
+#else
+#define SEGMENTSIZE 256
+#define SMALLSEGMENT 256
+#endif
+
+typedef struct Segment *Segment;
+struct Segment {
+    Segment prev;   // older segment, or NULL
+    Segment next;   // a spare newer segment, or NULL (active segments only)
+    char *top;      // first unused byte
+    char *limit;    // end of this segment's memory
+    char *prevtop;  // where the frames continue in prev (sealed only)
+    int refs;       // number of references to a sealed segment
+    unsigned visited;   // last collection to visit a sealed segment
+    char *visitedtop;   // end of the frames it visited
+};                  // the frames follow the header
+
+typedef struct Region {
+    Segment seg;    // sealed segment holding the newest frame, or NULL
+    char *top;      // end of the newest frame
+} Region;           // sealed frames, from top down through seg->prev
+/* representation of [[struct Stack]] S189a */
+struct Stack {
+    Segment seg;    // segment holding the top frame, or the first segment
+    Region sealed;  // sealed frames below the active ones
+    int depth;      // number of frames on the stack
+    Frame *chains[NCHAINS];  // newest frame on each chain, or NULL
+    Stack next, prev;        // neighbors on the ring of threads
+    Stack waiting;           // ring of the evaluation waiting, or NULL
+};
+
+__thread int optimize_tail_calls = 1;
+__thread int high_stack_mark;
+                      // maximum number of frames used in the current evaluation
+__thread int show_high_stack_mark;
+__thread int max_stack_depth = MAXSTACKDEPTH;
+/* context-stack.c: segments */
+static char *segmentbase(Segment seg) {
+    return (char *)(seg + 1);
+}
+
+static Segment newsegment(Segment prev, size_t size) {
+    Segment seg = malloc(sizeof(*seg) + size);
+    assert(seg);
+    seg->prev    = prev;
+    seg->next    = NULL;
+    seg->top     = segmentbase(seg);
+    seg->limit   = seg->top + size;
+    seg->prevtop = NULL;
+    seg->refs    = 0;
+    seg->visited = 0;
+    seg->visitedtop = NULL;
+    return seg;
+}
+
+static void freesegments(Segment seg) {
+    while (seg != NULL) {
+        Segment next = seg->next;
+        free(seg);
+        seg = next;
+    }
+}
+
+static void keeponespare(Segment seg) {
+    if (seg->next != NULL) {
+        freesegments(seg->next->next);
+        seg->next->next = NULL;
+    }
+}
+
+static bool holdsframe(Segment seg, char *top, Frame *fr) {
+    return segmentbase(seg) <= (char *)fr && (char *)fr < top;
+}
+/* context-stack.c: sealed segments */
+/*
+ * A continuation made on one thread may be resumed on another, so two
+ * threads may hold the same sealed segment.
+ */
+static void holdsegment(Segment seg) {
+    if (seg != NULL)
+        __atomic_add_fetch(&seg->refs, 1, __ATOMIC_RELAXED);
+}
+
+static void releasesegment(Segment seg) {
+    while (seg != NULL &&
+           __atomic_sub_fetch(&seg->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        Segment prev = seg->prev;
+        free(seg);
+        seg = prev;
+    }
+}
+/*
+ * Make [[r]] start at [[seg]], just below [[top]], skipping any
+ * sealed segment that has no frames left.
+ */
+static void moveregion(Region *r, Segment seg, char *top) {
+    while (seg != NULL && top == segmentbase(seg)) {
+        top = seg->prevtop;
+        seg = seg->prev;
+    }
+    holdsegment(seg);
+    releasesegment(r->seg);
+    r->seg = seg;
+    r->top = seg ? top : NULL;
+}
+/* context-stack.c: chains */
+static int chainof(Frame *fr) {  // -1 if the frame is on no chain
+    switch (fr->alt) {
+    case TRY_CATCH:          return fr->nslots > 0 ? HANDLER_CHAIN : -1;
+    case CALLENV:            return CALL_CHAIN;
+    case WHILE_RUNNING_BODY: return LOOP_CHAIN;
+    case LETXENV:            return fr->nslots > 0 ? ESCAPE_CHAIN : -1;
+    default:                 return -1;
+    }
+}
+
+static void linkframe(Stack s, Frame *fr) {
+    int k = chainof(fr);
+    if (k < 0) {
+        fr->link = NULL;
+    } else {
+        fr->link = s->chains[k];
+        s->chains[k] = fr;
+    }
+}
+
+static void unlinkframe(Stack s, Frame *fr) {
+    int k = chainof(fr);
+    if (k >= 0) {
+        assert(s->chains[k] == fr);
+        s->chains[k] = fr->link;
+    }
+}
+
+static void trimchains(Stack s, int depth) {
+    int k;
+    for (k = 0; k < NCHAINS; k++)
+        while (s->chains[k] != NULL && s->chains[k]->depth > depth)
+            s->chains[k] = s->chains[k]->link;
+}
+/* context-stack.c S189c */
+Stack emptystack(void) {
+    Stack s;
+    s = malloc(sizeof *s);
+    assert(s);
+    s->seg = newsegment(NULL, SMALLSEGMENT);
+    s->sealed.seg = NULL;
+    s->sealed.top = NULL;
+    s->depth = 0;
+    memset(s->chains, 0, sizeof(s->chains));
+    s->next = s->prev = s;
+    s->waiting = NULL;
+    return s;
+}
+
+void freestack(Stack s) {
+    assert(s->next == s);
+    clearstack(s);
+    freesegments(s->seg);
+    free(s);
+}
+/* context-stack.c S190a */
+void clearstack (Stack s) {
+    while (s->seg->prev != NULL)
+        s->seg = s->seg->prev;
+    keeponespare(s->seg);
+    s->seg->top = segmentbase(s->seg);
+    moveregion(&s->sealed, NULL, NULL);
+    s->depth = 0;
+    memset(s->chains, 0, sizeof(s->chains));
+}
+/* context-stack.c: copying a sealed frame */
+/*
+ * When every active frame has been popped, the newest sealed frame is
+ * copied into the (empty) active segment.  Frames below it on a chain
+ * stay where they are; the copy replaces the sealed frame only as the
+ * head of its chain.
+ */
+static void unsealframe(Stack s) {
+    Segment seg = s->seg;
+    Frame *fr = (Frame *)(s->sealed.top - sizeof(Frame));
+    char *lo = (char *)framevalues(fr);
+    size_t size = s->sealed.top - lo;
+    Frame *copy;
+    int k;
+
+    assert(seg->prev == NULL && seg->top == segmentbase(seg));
+    if ((size_t)(seg->limit - seg->top) < size) {
+        freesegments(seg);
+        s->seg = seg = newsegment(NULL, size > SEGMENTSIZE ? size
+                                                           : SEGMENTSIZE);
+    }
+    memcpy(seg->top, lo, size);
+    copy = (Frame *)(seg->top + (size - sizeof(Frame)));
+    seg->top += size;
+    k = chainof(copy);
+    if (k >= 0) {
+        assert(s->chains[k] == fr);
+        s->chains[k] = copy;
+    }
+    moveregion(&s->sealed, s->sealed.seg, lo);
+}
+/* context-stack.c S190c */
+Frame *topframe (Stack s) {
+    assert(s);
+    if (s->depth == 0)
+        return NULL;
+    if (s->seg->top == segmentbase(s->seg))
+        unsealframe(s);
+    return (Frame *)(s->seg->top - sizeof(Frame));
+}
+/* context-stack.c S190d */
+/*
+ * A new frame's value slots are reserved, but only its header is
+ * initialized.
+ */
+Frame *pushframe (Expalt alt, Exp syntax, int nslots, Stack s) {
+    size_t need = nslots * sizeof(Value) + sizeof(Frame);
+    Segment seg;
+    Frame *fr;
+
+    assert(s);
+    if (s->depth >= max_stack_depth) {
+        clearstack(s);
+        runerror("recursion too deep");
+    }
+    if (nslots > USHRT_MAX)
+        runerror("too many values (%d) in one expression", nslots);
+    /* if segment [[s->seg]] is full, move to a newer segment */
+    seg = s->seg;
+    if ((size_t)(seg->limit - seg->top) < need) {
+        Segment next = seg->next;
+        if (next == NULL || (size_t)(next->limit - segmentbase(next)) < need) {
+            freesegments(next);
+            next = newsegment(seg, need > SEGMENTSIZE ? need : SEGMENTSIZE);
+            seg->next = next;
+        }
+        next->top = segmentbase(next);
+        s->seg = seg = next;
+    }
+    fr = (Frame *)(seg->top + nslots * sizeof(Value));
+    seg->top += need;
+    s->depth++;
+
+    fr->alt     = alt;
+    fr->let     = 0;
+    fr->nslots  = nslots;
+    fr->nvalues = 0;
+    fr->depth   = s->depth;
+    fr->syntax  = syntax;
+    fr->es      = NULL;
+    fr->xs      = NULL;
+    fr->env     = NULL;
+    linkframe(s, fr);
+    /* set [[high_stack_mark]] from stack [[s]] S192f */
+    if (s->depth > high_stack_mark)
+        high_stack_mark = s->depth;
+    return fr;
+}
+/* context-stack.c S191a */
+void popframe (Stack s) {
+    Frame *fr = topframe(s);
+    Segment seg = s->seg;
+
+    assert(fr != NULL);
+    unlinkframe(s, fr);
+    seg->top = (char *)framevalues(fr);
+    s->depth--;
+    if (seg->top == segmentbase(seg) && seg->prev != NULL) {
+        freesegments(seg->next);    // keep only [[seg]] as a spare
+        seg->next = NULL;
+        s->seg = seg->prev;
+    }
+}
+/* context-stack.c: changing the kind of the top frame */
+void retagframe(Frame *fr, Expalt alt, Stack s) {
+    assert(fr == topframe(s));
+    unlinkframe(s, fr);
+    fr->alt = alt;
+    linkframe(s, fr);
+}
+/* context-stack.c: unwinding */
+int chaindepth(Framechain k, Stack s) {
+    return s->chains[k] != NULL ? s->chains[k]->depth : 0;
+}
+
+int stackdepth(Stack s) {
+    return s->depth;
+}
+/*
+ * If the target is sealed, every active frame is dropped, and the
+ * target itself is copied only when [[topframe]] finds it.
+ */
+Frame *unwindto(Framechain k, Stack s) {
+    Frame *target = s->chains[k];
+    Segment seg;
+
+    if (target == NULL)
+        return NULL;
+    trimchains(s, target->depth);
+    s->depth = target->depth;
+    for (seg = s->seg; seg != NULL; seg = seg->prev)
+        if (holdsframe(seg, seg->top, target)) {
+            s->seg = seg;
+            seg->top = (char *)(target + 1);
+            keeponespare(seg);
+            return target;
+        }
+    while (s->seg->prev != NULL)
+        s->seg = s->seg->prev;
+    s->seg->top = segmentbase(s->seg);
+    keeponespare(s->seg);
+    for (seg = s->sealed.seg; !holdsframe(seg, seg->top, target);
+         seg = seg->prev)
+        assert(seg->prev != NULL);
+    moveregion(&s->sealed, seg, (char *)(target + 1));
+    return topframe(s);
+}
+/* context-stack.c: continuations */
+/*
+ * A continuation is an index into its interpreter's table of
+ * continuations.  Its frames are a sealed region; the heads of its
+ * chains point into that region.  The interpreter's future workers
+ * share the table, so a thread that captures or resumes a continuation
+ * takes the table's lock, in case another thread is growing the table.
+ */
+typedef struct Continuation {
+    Region frames;          // NULL seg if this entry is free
+    Frame *chains[NCHAINS];
+    int depth;
+    bool live, traced;      // set by the garbage collector
+    int nextfree;
+} Continuation;
+
+struct Conttable {
+    pthread_mutex_t lock;   // guards captures and resumes
+    Continuation *conts;
+    int nconts, size;
+    int freeconts;          // first free entry, or -1
+    unsigned collections;
+};
+static __thread Conttable table;  /* continuations of the current interpreter */
+
+Conttable conttable(void) {
+    if (table == NULL) {
+        table = calloc(1, sizeof(*table));
+        assert(table != NULL);
+        pthread_mutex_init(&table->lock, NULL);
+        table->freeconts = -1;
+        table->collections = 1;
+    }
+    return table;
+}
+
+void useconttable(Conttable t) {
+    table = t;
+}
+
+int capturestack(Stack s) {
+    Segment seg, spare;
+    Conttable t;
+    Continuation *c;
+    int k;
+
+    assert(s->depth > 0);
+    /* seal the active segments, if any of them holds a frame */
+    seg = s->seg;
+    if (seg->top != segmentbase(seg)) {
+        keeponespare(seg);
+        spare = seg->next;
+        for ( ; seg->prev != NULL; seg = seg->prev) {
+            seg->next    = NULL;
+            seg->prevtop = seg->prev->top;
+            seg->prev->refs = 1;
+        }
+        seg->next    = NULL;
+        seg->prev    = s->sealed.seg;   // the stack's reference moves here
+        seg->prevtop = s->sealed.top;
+        s->sealed.seg = NULL;
+        moveregion(&s->sealed, s->seg, s->seg->top);
+        if (spare == NULL || (size_t)(spare->limit - segmentbase(spare))
+                                                               > SMALLSEGMENT) {
+            free(spare);
+            spare = newsegment(NULL, SMALLSEGMENT);
+        }
+        spare->prev = NULL;
+        spare->top  = segmentbase(spare);
+        s->seg = spare;
+    }
+    /* record the sealed frames in a free entry */
+    t = conttable();
+    pthread_mutex_lock(&t->lock);
+    if (t->freeconts < 0) {
+        if (t->nconts == t->size) {
+            t->size = t->size ? 2 * t->size : 16;
+            t->conts = realloc(t->conts, t->size * sizeof(*t->conts));
+            assert(t->conts);
+        }
+        t->conts[t->nconts].nextfree = t->freeconts;
+        t->freeconts = t->nconts++;
+    }
+    k = t->freeconts;
+    c = &t->conts[k];
+    t->freeconts = c->nextfree;
+    c->frames.seg = NULL;
+    moveregion(&c->frames, s->sealed.seg, s->sealed.top);
+    memcpy(c->chains, s->chains, sizeof(c->chains));
+    c->depth = s->depth;
+    c->live = c->traced = false;
+    pthread_mutex_unlock(&t->lock);
+    return k;
+}
+
+void resumestack(int k, Stack s) {
+    Conttable t = conttable();
+    Continuation *c;
+
+    pthread_mutex_lock(&t->lock);
+    c = &t->conts[k];
+    assert(0 <= k && k < t->nconts && c->frames.seg != NULL);
+    clearstack(s);
+    moveregion(&s->sealed, c->frames.seg, c->frames.top);
+    memcpy(s->chains, c->chains, sizeof(s->chains));
+    s->depth = c->depth;
+    pthread_mutex_unlock(&t->lock);
+}
+/* context-stack.c: the ring of threads */
+void joinring(Stack s, Stack ring) {  // s goes just before ring
+    assert(s->next == s);
+    s->next = ring;
+    s->prev = ring->prev;
+    ring->prev->next = s;
+    ring->prev = s;
+}
+
+void leavering(Stack s) {
+    s->prev->next = s->next;
+    s->next->prev = s->prev;
+    s->next = s->prev = s;
+}
+
+Stack nextstack(Stack s) {
+    return s->next;
+}
+
+void setwaiting(Stack s, Stack waiting) {
+    s->waiting = waiting;
+}
+/* context-stack.c: walking the stack */
+static void walkframes(char *top, char *bottom,
+                       void (*visit)(Frame *, void *), void *cl) {
+    while (top > bottom) {
+        Frame *fr = (Frame *)(top - sizeof(Frame));
+        visit(fr, cl);
+        top = (char *)framevalues(fr);
+    }
+}
+
+/*
+ * Segments are numbered across the ring, starting with [[s]], and then
+ * across the rings waiting below it; [[*ip]] is the number of the first
+ * segment of one stack.
+ */
+static void walkone(Stack s, int *ip, int lo, int hi,
+                    void (*visit)(Frame *, void *), void *cl) {
+    Segment seg;
+    char *top;
+    int i = *ip;
+
+    if (s->depth == 0)
+        return;
+    for (seg = s->seg; seg != NULL; seg = seg->prev, i++)
+        if (i >= lo && i < hi)
+            walkframes(seg->top, segmentbase(seg), visit, cl);
+    for (seg = s->sealed.seg, top = s->sealed.top; seg != NULL;
+         top = seg->prevtop, seg = seg->prev, i++)
+        if (i >= lo && i < hi)
+            walkframes(top, segmentbase(seg), visit, cl);
+    *ip = i;
+}
+
+int stacksegments(Stack s) {
+    Stack t;
+    int n = 0;
+    for (; s != NULL; s = s->waiting) {
+        t = s;
+        do {
+            walkone(t, &n, 0, 0, NULL, NULL);  // visits nothing, counts
+            t = t->next;
+        } while (t != s);
+    }
+    return n;
+}
+
+void walkstack(Stack s, int lo, int hi, void (*visit)(Frame *, void *),
+               void *cl) {
+    Stack t;
+    int i = 0;
+    for (; s != NULL && i < hi; s = s->waiting) {
+        t = s;
+        do {
+            walkone(t, &i, lo, hi, visit, cl);
+            t = t->next;
+        } while (t != s && i < hi);
+    }
+}
+/* context-stack.c: continuations and the garbage collector */
+/*
+ * A collector calls [[markcontinuation]] for each continuation it
+ * reaches, then calls [[tracecontinuations]] until it returns false,
+ * draining its marks in between.  A frame in a sealed segment is
+ * visited at most once per collection, however many continuations
+ * share it.  Frames above every continuation's part of a segment are
+ * dead and may point to reclaimed objects, so they are never visited.
+ * Finally [[sweepcontinuations]] frees the continuations not reached.
+ */
+void markcontinuation(int k) {
+    assert(table != NULL && 0 <= k && k < table->nconts);
+    __atomic_store_n(&table->conts[k].live, true, __ATOMIC_RELAXED);
+}
+
+bool tracecontinuations(void (*visit)(Frame *, void *), void *cl) {
+    bool traced = false;
+    Segment seg;
+    char *top;
+    int k;
+
+    if (table == NULL)
+        return false;
+    for (k = 0; k < table->nconts; k++) {
+        Continuation *c = &table->conts[k];
+        if (c->live && !c->traced) {
+            c->traced = traced = true;
+            for (seg = c->frames.seg, top = c->frames.top;
+                 seg != NULL; top = seg->prevtop, seg = seg->prev) {
+                if (seg->visited == table->collections) {  // and all below it
+                    if (top > seg->visitedtop) {
+                        walkframes(top, seg->visitedtop, visit, cl);
+                        seg->visitedtop = top;
+                    }
+                    break;
+                }
+                seg->visited    = table->collections;
+                seg->visitedtop = top;
+                walkframes(top, segmentbase(seg), visit, cl);
+            }
+        }
+    }
+    return traced;
+}
+
+int sweepcontinuations(void) {
+    int k, nlive = 0;
+    if (table == NULL)
+        return 0;
+    for (k = 0; k < table->nconts; k++) {
+        Continuation *c = &table->conts[k];
+        if (c->frames.seg == NULL)
+            continue;
+        if (c->live) {
+            c->live = c->traced = false;
+            nlive++;
+        } else {
+            moveregion(&c->frames, NULL, NULL);
+            c->nextfree = table->freeconts;
+            table->freeconts = k;
+        }
+    }
+    table->collections++;
+    return nlive;
+}
+/* context-stack.c: releasing the continuations */
+void freecontinuations(void) {
+    int k;
+    if (table == NULL)
+        return;
+    for (k = 0; k < table->nconts; k++)
+        if (table->conts[k].frames.seg != NULL)
+            moveregion(&table->conts[k].frames, NULL, NULL);
+    free(table->conts);
+    pthread_mutex_destroy(&table->lock);
+    free(table);
+    table = NULL;
+}
+/* context-stack.c S191e */
+void printnoenv(FILE *output, va_list_box* box) {
+    Env env = va_arg(box->ap, Env);
+    fprintf(output, "@%p", (void *)env);
+}
+/* context-stack.c S192a */
+static void printstackframe(Frame *fr, void *output) {
+    fprint(output, "  ");
+    printframe(output, fr);
+    fprint(output, ";\n");
+}
+
+void printstack(FILE *output, va_list_box *box) {
+    Stack s = va_arg(box->ap, Stack);
+    int i = 0;
+    walkone(s, &i, 0, INT_MAX, printstackframe, output);
+}
+/* context-stack.c S192b */
+void printoneframe(FILE *output, va_list_box *box) {
+    Frame *fr = va_arg(box->ap, Frame*);
+    printframe(output, fr);
+}
+/* context-stack.c S192c */
+/*
+ * To be printed, a frame is shown as the context it stands for,
+ * with a hole where the value being computed will go.
+ */
+void printframe (FILE *output, Frame *fr) {
+    struct Exp hole = mkHoleStruct();
+    struct Exp handler, context;
+    Exp e = fr->syntax;
+
+    switch (fr->alt) {
+    case SET:
+        context = mkSetStruct(e->u.set.name, &hole);
+        break;
+    case IFX:
+        context = mkIfxStruct(&hole, e->u.ifx.truex, e->u.ifx.falsex);
+        break;
+    case WHILEX:
+    case WHILE_RUNNING_BODY:
+        context = mkWhilexStruct(e->u.whilex.cond, e->u.whilex.body);
+        context.alt = fr->alt;
+        break;
+    case BEGIN:
+        context = mkBeginStruct(fr->es);
+        break;
+    case LETX:
+        if (fr->let == LETSTAR)
+            context = mkLetxStruct(LETSTAR, fr->xs, fr->es, e->u.letx.body);
+        else
+            context = mkLetxStruct(fr->let, e->u.letx.xs, e->u.letx.es,
+                                                                e->u.letx.body);
+        break;
+    case APPLY:
+        context = mkApplyStruct(&hole, e->u.apply.actuals);
+        break;
+    case LETXENV:
+        context = mkLetxenvStruct(fr->env);
+        break;
+    case CALLENV:
+        context = mkCallenvStruct(fr->env);
+        break;
+    case RETURNX:
+        context = mkReturnxStruct(&hole);
+        break;
+    case THROW:
+        context = mkThrowStruct(&hole);
+        break;
+    case TRY_CATCH:
+        if (fr->nslots == 0) {
+            context = mkTryCatchStruct(e->u.try_catch.body, &hole);
+        } else {
+            handler = mkLiteralStruct(framevalues(fr)[0]);
+            context = mkTryCatchStruct(&hole, &handler);
+        }
+        break;
+    default:
+        assert(0);
+    }
+    fprintf(output, "%p: ", (void *) fr);
+    fprint(output, "[%e]", &context);
+}
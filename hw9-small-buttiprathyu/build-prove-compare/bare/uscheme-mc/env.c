@@ -0,0 +1,191 @@
+#include "all.h"
+#include <pthread.h>
+/* env.c S165b */
+Value* find(Name name, Env env) {
+    for (; env; env = env->tl)
+        if (env->name == name)
+            return env->loc;
+    return NULL;
+}
+/* env.c S165c */
+void printenv(Printbuf output, va_list_box *box) {
+    char *prefix = " ";
+
+    bprint(output, "{");
+    for (Env env = va_arg(box->ap, Env); env; env = env->tl) {
+        bprint(output, "%s%n -> %v", prefix, env->name, *env->loc);
+        prefix = ", ";
+    }
+    bprint(output, " }");
+}
+/* env.c S165d */
+void dump_env_names(Env env) {
+    for ( ; env; env = env->tl)
+        fprint(stdout, "%n\n", env->name);
+}
+/* env.c: binding records */
+/*
+ * Binding records are allocated from pages of their own and are
+ * reclaimed by the garbage collector.  Records never move, so an
+ * [[Env]] held in a C variable stays valid as long as it is also
+ * reachable from the roots.  During a collection, the collector
+ * calls [[markenv]] on each record it reaches, then calls
+ * [[sweepenvs]], which puts every unmarked record on the free list
+ * and clears the marks for the next collection.
+ *
+ * The pages belong to the interpreter, and its future workers share
+ * them.  A thread takes free records a page's worth at a time, under
+ * the table's lock, and allocates from the ones it has taken without
+ * locking.  The records a thread has taken but not used are unmarked,
+ * so the next sweep frees them again; a thread forgets them with
+ * [[retirebindings]] before a collection can run.
+ */
+#ifndef GCHYPERDEBUG
+#define ENVPAGE 256             /* records per page */
+#else
+#define ENVPAGE 2
+#endif
+struct Envtable {
+    pthread_mutex_t lock;  // guards everything below
+    struct Env **pages;    // every page of records
+    int npages;
+    Env free;              // records no thread has taken
+};
+static __thread Envtable envs;      /* records of the current interpreter */
+static __thread Env freeenvs;       /* records this thread has taken */
+
+Envtable envtable(void) {
+    if (envs == NULL) {
+        envs = calloc(1, sizeof(*envs));
+        assert(envs != NULL);
+        pthread_mutex_init(&envs->lock, NULL);
+    }
+    return envs;
+}
+
+void useenvtable(Envtable t) {
+    envs = t;
+}
+
+static void takeenvs(void) {
+    Envtable t = envtable();
+    Env last;
+    int i;
+
+    pthread_mutex_lock(&t->lock);
+    if (t->free == NULL) {
+        struct Env *page = calloc(ENVPAGE, sizeof(*page));
+        assert(page != NULL);
+        if ((t->npages & (t->npages - 1)) == 0) {
+            t->pages = realloc(t->pages, (t->npages ? 2 * t->npages : 1) *
+                                                          sizeof(*t->pages));
+            assert(t->pages != NULL);
+        }
+        t->pages[t->npages++] = page;
+        for (i = ENVPAGE - 1; i >= 0; i--) {
+            page[i].tl = t->free;
+            t->free = &page[i];
+        }
+    }
+    last = t->free;
+    for (i = 1; i < ENVPAGE && last->tl != NULL; i++)
+        last = last->tl;
+    freeenvs = t->free;
+    t->free = last->tl;
+    last->tl = NULL;
+    pthread_mutex_unlock(&t->lock);
+}
+
+static Env allocenv(void) {
+    Env env;
+    if (freeenvs == NULL)
+        takeenvs();
+    env = freeenvs;
+    freeenvs = env->tl;
+    return env;
+}
+
+void retirebindings(void) {
+    freeenvs = NULL;
+}
+
+bool markenv(Env env) {
+    return !__atomic_load_n(&env->live, __ATOMIC_RELAXED) &&
+           !__atomic_exchange_n(&env->live, 1, __ATOMIC_RELAXED);
+}
+
+int sweepenvs(void) {
+    Envtable t = envtable();
+    int i, j, nlive = 0;
+    freeenvs = NULL;
+    t->free = NULL;
+    for (i = t->npages - 1; i >= 0; i--)
+        for (j = ENVPAGE - 1; j >= 0; j--) {
+            Env env = &t->pages[i][j];
+            if (env->live) {
+                env->live = 0;
+                nlive++;
+            } else {
+                env->name = NULL;
+                env->loc  = NULL;
+                env->tl   = t->free;
+                t->free   = env;
+            }
+        }
+    return nlive;
+}
+
+/*
+ * A collector that moves locations calls [[updateenvlocs]] after
+ * [[sweepenvs]], which has cleared the location of every free record,
+ * so that it need not remember where each live record was reached.
+ */
+void updateenvlocs(Value *(*update)(Value *loc)) {
+    Envtable t = envtable();
+    int i, j;
+    for (i = 0; i < t->npages; i++)
+        for (j = 0; j < ENVPAGE; j++)
+            if (t->pages[i][j].loc != NULL)
+                t->pages[i][j].loc = update(t->pages[i][j].loc);
+}
+
+void freebindings(void) {
+    int i;
+    freeenvs = NULL;
+    if (envs == NULL)
+        return;
+    for (i = 0; i < envs->npages; i++)
+        free(envs->pages[i]);
+    free(envs->pages);
+    pthread_mutex_destroy(&envs->lock);
+    free(envs);
+    envs = NULL;
+}
+/* env.c S211b */
+/*
+ * The location is allocated before the record, because allocating
+ * the location may trigger a collection, and a record that is not
+ * yet reachable would be swept.
+ */
+Env bindalloc(Name name, Value val, Env env) {
+    Value *loc;
+    Env newenv;
+
+    pushframe(LETXENV, NULL, 0, roots.stack)->env = env;
+    loc = allocate(val);
+    popframe(roots.stack);
+    newenv = allocenv();
+    newenv->name = name;
+    newenv->loc  = loc;
+    newenv->tl   = env;
+    return newenv;
+}
+/* env.c S212a */
+Env bindalloclist(Namelist xs, Valuelist vs, Env env) {
+    Valuelist oldvals = vs;
+    pushregs(oldvals);
+    for (; xs && vs; xs = xs->tl, vs = vs->tl)
+        env = bindalloc(xs->hd, vs->hd, env);
+    popregs(oldvals);
+    return env;
+}
@@ -0,0 +1,571 @@
+#define _GNU_SOURCE  /* for MAP_ANONYMOUS and mremap */
+#include "all.h"
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+/* mc.c: a sliding mark-compact collector */
+/*
+ * The heap is a single contiguous array of [[Value]]s, allocated
+ * with a bump pointer exactly as in the copying collector, but
+ * without a second semispace.  A collection has four phases:
+ *
+ *   1. Mark live objects, using a side bitmap with one bit per object.
+ *   2. Compute, for each block of 64 objects, how many live objects
+ *      precede the block.  An object's new address is its block's
+ *      offset plus the number of live objects before it in the block.
+ *   3. Update every pointer into the heap: pointers in live objects
+ *      are found by scanning the heap, and pointers in binding
+ *      records by scanning the pages of records; other pointers
+ *      outside the heap (in expressions, frames, and registers) are
+ *      recorded during marking in a set of ``slots.''
+ *   4. Slide each live object down to its new address.
+ *
+ * The bitmap and offsets cost about 1/50 of the heap, and the heap
+ * itself is sized from [[&gamma-desired]], so with [[&gamma-desired]]
+ * near 110 the collector needs little more memory than the live data.
+ * The heap changes size without a second copy: it grows by [[mremap]],
+ * which moves pages rather than their contents, and it shrinks by
+ * unmapping its tail after the objects slide down.  When live data
+ * falls so that the heap exceeds [[&gamma-shrink]] percent of it, the
+ * heap shrinks.
+ *
+ * The heap belongs to the interpreter, and all its threads share it.
+ * Each thread allocates from a buffer of its own, and when the buffer
+ * is used up, it takes the next [[BUFFER]] objects of the heap under
+ * the heap's lock.  Once the heap has all been taken, it is collected,
+ * by whichever thread needs it, so the collector's tables are kept
+ * with the heap.
+ */
+/* private declarations for mark-compact collection */
+#ifndef GCHYPERDEBUG
+#define MINHEAP 256             /* size of the first heap, in objects */
+#define BUFFER  256             /* objects a thread takes at a time */
+#else
+#define MINHEAP 4
+#define BUFFER  2
+#endif
+#define BLOCK 64                /* objects per word of the mark bitmap */
+
+struct Heap {
+    pthread_mutex_t lock;       // guards [[top]]
+    Value *heap;                /* the one and only space */
+    Value *markedheap;          /* where heap was while it was marked */
+    int heapsize;               /* # of objects in heap */
+    Value *top, *limit;         /* objects not yet taken */
+
+    uint64_t *markbits;         /* one bit per object in the heap */
+    int *blockoffset;           /* live objects before each block */
+    int nblocks;
+
+    Value **markstack;          /* objects marked but not yet visited */
+    int markdepth, marksize;
+
+    Value ***slots;             /* pointers into the heap from outside it */
+    int nslots, slotsize;       /* slotsize is 0 or a power of 2 */
+
+    int nalloc;                 /* total number of allocations */
+    int ncollections;           /* total number of collections */
+    int nmoved;                 /* total number of objects moved */
+    int maxheapsize;            /* largest heap ever used */
+    clock_t gcticks;            /* CPU time spent collecting */
+    int nshrinks;               /* number of times the heap shrank */
+};
+static __thread Heap gc;               /* the heap of the current thread */
+static __thread Value *hp, *heaplimit; /* used for every allocation */
+/* private declarations for mark-compact collection */
+static void visitloc          (Value *loc);
+static void visitvalue        (Value *vp);
+static void visitenv          (Env env);
+static void visitexp          (Exp exp);
+static void visitexplist      (Explist es);
+static void visitframe        (Frame *fr, void *cl);
+static void visittest         (UnitTest t);
+static void visittestlists    (UnitTestlistlist uss);
+static void visitroots        (void);
+static void collect           (void);
+static bool takebuffer        (void);
+/* private declarations for mark-compact collection */
+#define isinheap(LOC) (gc->heap <= (LOC) && (LOC) < gc->heap + gc->heapsize)
+static __thread int nalloc;  /* allocations not yet added to the heap's */
+/*
+ * Time in GC is the CPU time of the thread that collects, so that
+ * one interpreter's statistics do not count work done by others.
+ */
+static clock_t threadclock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (clock_t) ts.tv_sec * CLOCKS_PER_SEC +
+           (clock_t) (ts.tv_nsec * (double) CLOCKS_PER_SEC / 1e9);
+}
+/* mc.c: allocation */
+Value* allocloc(void) {
+    while (hp == heaplimit && !takebuffer())
+        collect();
+    assert(hp < heaplimit);
+    nalloc++;
+    /* tell the debugging interface that [[hp]] is about to be allocated 322c */
+    gc_debug_pre_allocate(hp);
+    return hp++;
+}
+/* mc.c: mark bits */
+static bool ismarked(Value *p) {
+    int i = p - gc->heap;
+    return (gc->markbits[i / BLOCK] >> (i % BLOCK)) & 1;
+}
+
+static void setmark(Value *p) {
+    int i = p - gc->heap;
+    gc->markbits[i / BLOCK] |= (uint64_t)1 << (i % BLOCK);
+}
+/* mc.c: forwarding addresses */
+/*
+ * A pointer still holds the address that its object had when it was
+ * marked, which is not the same as the object's current address if
+ * the heap has grown since.
+ */
+static Value *newaddress(Value *p) {
+    int i = p - gc->markedheap;
+    uint64_t below = ((uint64_t)1 << (i % BLOCK)) - 1;
+    uint64_t before = gc->markbits[i / BLOCK] & below;
+    assert(i >= 0 && i < gc->heapsize && ismarked(gc->heap + i));
+    return gc->heap + gc->blockoffset[i / BLOCK] + __builtin_popcountll(before);
+}
+/* mc.c: slots */
+/*
+ * Slots live in an open-addressing hash set, so a slot reached
+ * along many paths is updated exactly once.  Returns false if the
+ * slot was already recorded.
+ */
+static bool recordslot(Value **slot) {
+    unsigned h;
+    if (2 * (gc->nslots + 1) > gc->slotsize) {
+        Value ***old = gc->slots;
+        int i, oldsize = gc->slotsize;
+        gc->slotsize = gc->slotsize ? 2 * gc->slotsize : 1024;
+        gc->slots = calloc(gc->slotsize, sizeof(*gc->slots));
+        assert(gc->slots != NULL);
+        gc->nslots = 0;
+        for (i = 0; i < oldsize; i++)
+            if (old[i])
+                recordslot(old[i]);
+        free(old);
+    }
+    h = ((uintptr_t)slot >> 3) * 2654435761u;
+    for (h &= gc->slotsize - 1; gc->slots[h] != NULL;
+                                            h = (h + 1) & (gc->slotsize - 1))
+        if (gc->slots[h] == slot)
+            return false;
+    gc->slots[h] = slot;
+    gc->nslots++;
+    return true;
+}
+/* mc.c: marking */
+static void visitloc(Value *loc) {
+    assert(isinheap(loc));
+    if (!ismarked(loc)) {
+        setmark(loc);
+        if (gc->markdepth == gc->marksize) {
+            gc->marksize = gc->marksize ? 2 * gc->marksize : 256;
+            gc->markstack = realloc(gc->markstack,
+                                    gc->marksize * sizeof(*gc->markstack));
+            assert(gc->markstack != NULL);
+        }
+        gc->markstack[gc->markdepth++] = loc;
+    }
+}
+/*
+ * [[visitvalue]] visits a value that might be inside the heap or
+ * outside it.  Pointers held outside the heap are recorded as slots.
+ */
+static void visitvalue(Value *vp) {
+    switch (vp->alt) {
+    case NIL:
+    case BOOLV:
+    case NUM:
+    case SYM:
+        return;
+    case PRIMITIVE:
+        if (vp->u.primitive.function == continuation)
+            markcontinuation(vp->u.primitive.tag);
+        else if (vp->u.primitive.function == future)
+            markfuture(vp->u.primitive.tag);
+        return;
+    case PAIR:
+        if (!isinheap(vp)) {
+            recordslot(&vp->u.pair.car);
+            recordslot(&vp->u.pair.cdr);
+        }
+        visitloc(vp->u.pair.car);
+        visitloc(vp->u.pair.cdr);
+        return;
+    case CLOSURE:
+        visitexp(vp->u.closure.lambda.body);
+        visitenv(vp->u.closure.env);
+        return;
+    default:
+        assert(0);
+        return;
+    }
+}
+/*
+ * Whenever an environment is visited, its whole spine is visited,
+ * so if a binding record is already marked, so is every record
+ * after it.
+ */
+static void visitenv(Env env) {
+    for (; env && markenv(env); env = env->tl)
+        visitloc(env->loc);
+}
+
+static void visitexp(Exp e) {
+    switch (e->alt) {
+    case LITERAL:
+        visitvalue(&e->u.literal);
+        return;
+    case VAR:
+        return;
+    case IFX:
+        visitexp(e->u.ifx.cond);
+        visitexp(e->u.ifx.truex);
+        visitexp(e->u.ifx.falsex);
+        return;
+    case WHILEX:
+    case WHILE_RUNNING_BODY:
+        visitexp(e->u.whilex.cond);
+        visitexp(e->u.whilex.body);
+        return;
+    case BEGIN:
+        visitexplist(e->u.begin);
+        return;
+    case SET:
+        visitexp(e->u.set.exp);
+        return;
+    case LETX:
+        visitexplist(e->u.letx.es);
+        visitexp(e->u.letx.body);
+        return;
+    case LAMBDAX:
+        visitexp(e->u.lambdax.body);
+        return;
+    case APPLY:
+        visitexp(e->u.apply.fn);
+        visitexplist(e->u.apply.actuals);
+        return;
+    case BREAKX:
+    case CONTINUEX:
+    case HOLE:
+        return;
+    case RETURNX:
+        visitexp(e->u.returnx);
+        return;
+    case THROW:
+        visitexp(e->u.throw);
+        return;
+    case TRY_CATCH:
+        visitexp(e->u.try_catch.handler);
+        visitexp(e->u.try_catch.body);
+        return;
+    case LETXENV:
+        visitenv(e->u.letxenv);
+        return;
+    case CALLENV:
+        visitenv(e->u.callenv);
+        return;
+    }
+    assert(0);
+}
+
+static void visitexplist(Explist es) {
+    for (; es; es = es->tl)
+        visitexp(es->hd);
+}
+
+static void visitframe(Frame *fr, void *cl) {
+    int i;
+    (void)cl;
+    if (fr->syntax != NULL)
+        visitexp(fr->syntax);
+    visitenv(fr->env);
+    for (i = 0; i < fr->nvalues; i++)
+        visitvalue(&framevalues(fr)[i]);
+}
+
+static void visittestlists(UnitTestlistlist uss) {
+    UnitTestlist ul;
+
+    for ( ; uss != NULL; uss = uss->tl)
+        for (ul = uss->hd; ul; ul = ul->tl)
+            visittest(ul->hd);
+}
+
+static void visittest(UnitTest t) {
+    switch (t->alt) {
+    case CHECK_EXPECT:
+        visitexp(t->u.check_expect.check);
+        visitexp(t->u.check_expect.expect);
+        return;
+    case CHECK_ASSERT:
+        visitexp(t->u.check_assert);
+        return;
+    case CHECK_ERROR:
+        visitexp(t->u.check_error);
+        return;
+    }
+    assert(0);
+}
+
+/*
+ * The roots are those of every thread that shares the heap; a worker
+ * that is quitting may have no globals left.
+ */
+static void visitroots(void) {
+    struct Roots **rs;
+    int i, j, n;
+
+    rs = allroots(&n);
+    for (j = 0; j < n; j++) {
+        if (rs[j]->globals.user != NULL)
+            visitenv(*rs[j]->globals.user);
+        visittestlists(rs[j]->globals.internal.pending_tests);
+        walkstack(rs[j]->stack, 0, INT_MAX, visitframe, NULL);
+        for (i = 0; i < rs[j]->registers.sp; i++)
+            visitvalue(rs[j]->registers.regs[i]);
+    }
+}
+/* mc.c: sizing the side tables */
+static void resizetables(int nvalues) {
+    gc->nblocks = (nvalues + BLOCK - 1) / BLOCK;
+    gc->markbits    = realloc(gc->markbits,
+                              gc->nblocks * sizeof(*gc->markbits));
+    gc->blockoffset = realloc(gc->blockoffset,
+                              gc->nblocks * sizeof(*gc->blockoffset));
+    assert(gc->markbits != NULL && gc->blockoffset != NULL);
+}
+/* mc.c: acquiring, resizing, and releasing heaps */
+static Value *acquireheap(int nvalues) {
+    Value *space = mmap(NULL, nvalues * sizeof(*space), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(space != MAP_FAILED);
+    gc_debug_post_acquire(space, nvalues);
+    return space;
+}
+
+static void releaseheap(Value *space, int nvalues) {
+    gc_debug_pre_release(space, nvalues);
+    munmap(space, nvalues * sizeof(*space));
+}
+
+/*
+ * Growing keeps every object at its offset, but the heap may move.
+ */
+static void growheap(int nvalues) {
+    Value *space = mremap(gc->heap, gc->heapsize * sizeof(*gc->heap),
+                          nvalues * sizeof(*gc->heap), MREMAP_MAYMOVE);
+    assert(space != MAP_FAILED);
+    gc_debug_post_acquire(space + gc->heapsize, nvalues - gc->heapsize);
+    gc->heap = space;
+    gc->heapsize = nvalues;
+}
+
+/*
+ * Shrinking gives back the whole pages past the first [[nvalues]]
+ * objects, which must already have been reclaimed.
+ */
+static void shrinkheap(int nvalues) {
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t keep = (uintptr_t)(gc->heap + nvalues);
+    uintptr_t end  = (uintptr_t)(gc->heap + gc->heapsize);
+
+    gc_debug_pre_release(gc->heap + nvalues, gc->heapsize - nvalues);
+    keep = (keep + page - 1) & ~(uintptr_t)(page - 1);
+    end  = (end  + page - 1) & ~(uintptr_t)(page - 1);
+    if (keep < end)
+        munmap((void *)keep, end - keep);
+    gc->heapsize = nvalues;
+}
+/* mc.c: the heap and the threads' buffers */
+/*
+ * The first heap is acquired with the interpreter's [[Heap]].
+ */
+Heap gcheap(void) {
+    if (gc == NULL) {
+        gc = calloc(1, sizeof(*gc));
+        assert(gc != NULL);
+        pthread_mutex_init(&gc->lock, NULL);
+        gc->heapsize = MINHEAP;
+        gc->heap = acquireheap(gc->heapsize);
+        resizetables(gc->heapsize);
+        gc->top = gc->heap;
+        gc->limit = gc->heap + gc->heapsize;
+        gc->maxheapsize = gc->heapsize;
+    }
+    return gc;
+}
+
+void usegcheap(Heap h) {
+    gc = h;
+}
+
+static bool takebuffer(void) {
+    Heap h = gcheap();
+    int n;
+
+    pthread_mutex_lock(&h->lock);
+    n = h->limit - h->top < BUFFER ? h->limit - h->top : BUFFER;
+    hp = h->top;
+    heaplimit = h->top += n;
+    pthread_mutex_unlock(&h->lock);
+    return n > 0;
+}
+/*
+ * A thread gives back its buffer by filling the rest of it with nil,
+ * so that every object of the heap that has been taken is allocated,
+ * as the next collection expects.
+ */
+void retirebuffer(void) {
+    for ( ; hp < heaplimit; hp++) {
+        gc_debug_pre_allocate(hp);
+        *hp = mkNil();
+    }
+    hp = heaplimit = NULL;
+    if (gc != NULL)
+        __atomic_add_fetch(&gc->nalloc, nalloc, __ATOMIC_RELAXED);
+    nalloc = 0;
+}
+/* mc.c: collection */
+/*
+ * Slide the [[nlive]] live objects to the bottom of the heap.
+ */
+static void compact(int nlive) {
+    int i, b;
+    Value *p;
+
+    /* phase 3: update pointers, then phase 4: slide */
+    for (i = 0; i < gc->slotsize; i++)
+        if (gc->slots[i] != NULL)
+            *gc->slots[i] = newaddress(*gc->slots[i]);
+    updateenvlocs(newaddress);
+    for (b = 0; b < gc->nblocks; b++)
+        for (uint64_t bits = gc->markbits[b]; bits; bits &= bits - 1) {
+            p = gc->heap + b * BLOCK + __builtin_ctzll(bits);
+            if (p->alt == PAIR) {
+                p->u.pair.car = newaddress(p->u.pair.car);
+                p->u.pair.cdr = newaddress(p->u.pair.cdr);
+            }
+        }
+    for (b = 0; b < gc->nblocks; b++)
+        for (uint64_t bits = gc->markbits[b]; bits; bits &= bits - 1) {
+            p = gc->heap + b * BLOCK + __builtin_ctzll(bits);
+            Value *q = newaddress(gc->markedheap + (p - gc->heap));
+            if (q != p)
+                *q = *p;
+        }
+    gc->nmoved += nlive;
+}
+
+/*
+ * The thread that collects first stops every other thread that shares
+ * the heap; if another thread collected while this one waited, and
+ * left objects to take, there is nothing more to do.
+ */
+static void collect(void) {
+    clock_t start;
+    int gamma, shrink;
+    int b, nlive, newsize, oldsize;
+
+    if (!stopworld())
+        return;
+    if (gc->top < gc->limit) {
+        startworld();
+        return;
+    }
+    start   = threadclock();
+    gamma   = gammadesired(200, 110);
+    shrink  = gammashrink(2 * gamma, gamma);
+    oldsize = gc->heapsize;
+    gc->ncollections++;
+
+    /* phase 1: mark */
+    memset(gc->markbits, 0, gc->nblocks * sizeof(*gc->markbits));
+    if (gc->slots != NULL)
+        memset(gc->slots, 0, gc->slotsize * sizeof(*gc->slots));
+    gc->nslots = 0;
+    visitroots();
+    do {
+        while (gc->markdepth > 0)
+            visitvalue(gc->markstack[--gc->markdepth]);
+    } while (tracecontinuations(visitframe, NULL) || tracefutures(visitvalue));
+    sweepenvs();
+    sweepcontinuations();
+    sweepfutures();
+
+    /* phase 2: compute block offsets */
+    for (b = 0, nlive = 0; b < gc->nblocks; b++) {
+        gc->blockoffset[b] = nlive;
+        nlive += __builtin_popcountll(gc->markbits[b]);
+    }
+    gcprintf("GC %d: %d of %d cells live\n", gc->ncollections, nlive,
+             gc->heapsize);
+
+    /* phases 3 and 4, possibly into a larger or smaller heap */
+    newsize = gc->heapsize;
+    if (gc->heapsize * 100 < nlive * gamma || nlive == gc->heapsize) {
+        newsize = (int) (((long) nlive * gamma + 99) / 100);
+        if (newsize <= nlive)
+            newsize = nlive + 1;
+    } else if ((long) gc->heapsize * 100 > (long) nlive * shrink &&
+               gc->heapsize > MINHEAP) {
+        newsize = (int) (((long) nlive * gamma + 99) / 100);
+        if (newsize < MINHEAP)
+            newsize = MINHEAP;
+        gc->nshrinks++;
+    }
+    gc->markedheap = gc->heap;
+    if (newsize > gc->heapsize)
+        growheap(newsize);
+    compact(nlive);
+    gc_debug_post_reclaim_block(gc->heap + nlive, oldsize - nlive);
+    if (newsize < gc->heapsize)
+        shrinkheap(newsize);
+    if (gc->heapsize != oldsize)
+        resizetables(gc->heapsize);
+    if (gc->heapsize > gc->maxheapsize)
+        gc->maxheapsize = gc->heapsize;
+    gc->top = gc->heap + nlive;
+    gc->limit = gc->heap + gc->heapsize;
+    gc->gcticks += threadclock() - start;
+    startworld();
+}
+/* mc.c: releasing the heap */
+/*
+ * [[freeheap]] gives back the heap and its side tables, and the
+ * statistics with them; the next interpreter starts a heap of its own.
+ * Every other thread that shared the heap has quit.  The objects still
+ * in the heap are reclaimed first, as if by one last collection.
+ */
+void freeheap(void) {
+    retirebuffer();
+    if (gc == NULL)
+        return;
+    gc_debug_post_reclaim_block(gc->heap, gc->top - gc->heap);
+    releaseheap(gc->heap, gc->heapsize);
+    free(gc->markbits);
+    free(gc->blockoffset);
+    free(gc->markstack);
+    free(gc->slots);
+    pthread_mutex_destroy(&gc->lock);
+    free(gc);
+    gc = NULL;
+}
+/* mc.c: statistics */
+void printfinalstats(void) {
+    Heap h = gcheap();
+    fprintf(stderr, "[Mark-compact GC: allocated %d cells; %d collections "
+                    "moved %d cells; max heap %d cells (%lu bytes); "
+                    "%d shrinks; %.3fs in GC]\n",
+            h->nalloc + nalloc, h->ncollections, h->nmoved, h->maxheapsize,
+            (unsigned long) h->maxheapsize * sizeof(Value), h->nshrinks,
+            (double) h->gcticks / CLOCKS_PER_SEC);
+}
+int gc_uses_mark_bits = 0;
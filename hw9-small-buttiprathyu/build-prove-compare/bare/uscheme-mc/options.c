@@ -0,0 +1,9 @@
+#include "all.h"
+/* options.c S195e */
+Value getoption(Name name, Env env, Value defaultval) {
+    Value *p = find(name, env);
+    if (p)
+        return *p;
+    else
+        return defaultval;
+}
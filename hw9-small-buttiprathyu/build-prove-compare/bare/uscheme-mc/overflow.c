@@ -0,0 +1,38 @@
+#include "all.h"
+/* overflow.c S29a */
+static __thread volatile char *low_water_mark = NULL;
+
+#define N 600 /* fuel in units of 10,000 */
+
+static __thread int default_eval_fuel = N * 10000;
+static __thread int eval_fuel         = N * 10000;
+static __thread bool throttled = 1;
+static __thread bool env_checked = 0;
+
+int checkoverflow(int limit) {
+  volatile char c;
+  if (!env_checked) {
+      env_checked = 1;
+      const char *options = getenv("BPCOPTIONS");
+      if (options == NULL)
+          options = "";
+      throttled = strstr(options, "nothrottle") == NULL;
+  }
+  if (low_water_mark == NULL) {
+    low_water_mark = &c;
+    return 0;
+  } else if (low_water_mark - &c >= limit) {
+    runerror("recursion too deep");
+    return -1; /* not reachable, but the compiler can't tell */
+  } else if (throttled && eval_fuel-- <= 0) {
+    eval_fuel = default_eval_fuel;
+    runerror("CPU time exhausted");
+    return -1;
+  } else {
+    return (low_water_mark - &c);
+  }
+}
+
+extern void reset_overflow_check(void) {
+  eval_fuel = default_eval_fuel;
+}
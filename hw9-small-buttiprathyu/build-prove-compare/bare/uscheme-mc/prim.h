@@ -0,0 +1,35 @@
+/* prim.h S151d */
+xx("+", PLUS,  arith)
+xx("-", MINUS, arith)
+xx("*", TIMES, arith)
+xx("/", DIV,   arith)
+xx("<", LT,    arith)
+xx(">", GT,    arith)
+/* prim.h S152b */
+xx("cons", CONS, binary)
+xx("=",    EQ,   binary)
+/* prim.h S153b */
+xx("boolean?",   BOOLEANP,   unary)
+xx("null?",      NULLP,      unary)
+xx("number?",    NUMBERP,    unary)
+xx("pair?",      PAIRP,      unary)
+xx("procedure?", PROCEDUREP, unary)
+xx("symbol?",    SYMBOLP,    unary)
+xx("car",        CAR,        unary)
+xx("cdr",        CDR,        unary)
+xx("println",    PRINTLN,    unary)
+xx("print",      PRINT,      unary)
+xx("printu",     PRINTU,     unary)
+xx("error",      ERROR,      unary)
+/* prim.h: control */
+xx("call/cc",  CALLCC,    control)
+xx("call/1cc", CALLONECC, control)
+/* prim.h: threads */
+xx("spawn",        SPAWN,     control)
+xx("yield",        YIELD,     control)
+xx("receive",      RECEIVE,   control)
+xx("make-channel", MKCHANNEL, channel)
+xx("send",         SEND,      channel)
+/* prim.h: futures */
+xx("future", FUTURE, control)
+xx("touch",  TOUCH,  control)
@@ -0,0 +1,35 @@
+#include "all.h"
+/* root.c S207c */
+__thread struct Roots roots = { { NULL, { NULL } }, NULL, { NULL, 0, 0 } };
+/* root.c S207d */
+#ifndef DEBUG_GC_REGISTERS    /*OMIT*/
+void pushreg(Value *reg) {
+    struct Registerstack *rs = &roots.registers;
+    if (rs->sp == rs->size) {
+        rs->size = rs->size ? 2 * rs->size : 64;
+        rs->regs = realloc(rs->regs, rs->size * sizeof(*rs->regs));
+        assert(rs->regs != NULL);
+    }
+    rs->regs[rs->sp++] = reg;
+}
+/* root.c S207e */
+void popreg(Value *reg) {
+    struct Registerstack *rs = &roots.registers;
+    assert(rs->sp > 0);
+    assert(reg == rs->regs[rs->sp - 1]);
+    (void) reg;
+    rs->sp--;
+}
+#endif /*OMIT*/
+/* root.c S207f */
+void pushregs(Valuelist regs) {
+    for (; regs; regs = regs->tl)
+        pushreg(&regs->hd);
+}
+
+void popregs (Valuelist regs) {
+    if (regs != NULL) {
+        popregs(regs->tl);
+        popreg(&regs->hd);
+    }
+}
@@ -0,0 +1,203 @@
+#define _DEFAULT_SOURCE  /* for ftruncate */
+#include "all.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+/* stack-debug.c S192g */
+static __thread int etick, vtick;  // number of times saw a current expression or value
+static __thread int *trace_countp; // if not NULL, points to value of &trace-stack
+/* stack-debug.c: binary trace */
+/*
+ * When [[&trace-ring]] is set, every step also writes one fixed-size
+ * record into a ring buffer mapped from a file, so a long run can be
+ * traced at little cost and the newest records survive a crash.  Each
+ * evaluation checks the options, and a change starts a new trace.  The
+ * file starts with a header; the newest record is at index
+ * [[(nrecords - 1) % capacity]].  Expressions are identified by number;
+ * the first time one is traced, its number and text are appended to a
+ * key file, which also names the tags.  Program [[tracedump]] decodes
+ * the two files.  The layout is shared with tracedump.c.  A thread that
+ * runs futures has a trace of its own: worker [[N]] writes to the
+ * trace file's name followed by [[.wN]].
+ */
+#define TRACEMAGIC "USTRACE1"
+#define MAXTRACERING (1 << 24)  /* records */
+
+struct Traceheader {
+    char     magic[8];
+    uint32_t recordsize;
+    uint32_t capacity;    // records in the ring
+    uint64_t nrecords;    // records ever written
+};
+
+struct Tracerecord {
+    uint32_t step;        // number of the step, counting from 1
+    uint32_t exp;         // expression, or context of value; 0 if none
+    uint32_t depth;       // frames on the stack
+    uint8_t  kind;        // 'e' for an expression, 'v' for a value
+    uint8_t  tag;         // Expalt of the expression, or Valuealt of the value
+    uint16_t unused;
+};
+
+static __thread struct Traceheader *ring;  // NULL unless tracing to a ring
+static __thread struct Tracerecord *records;
+static __thread char ringname[1024];
+static __thread FILE *tracekey;
+static __thread uint32_t tracesteps;
+
+static __thread struct {           // expression numbers, hashed on address
+    Exp *exps;
+    uint32_t *ids;
+    uint32_t size, used;           // size is a power of 2
+} expids;
+
+static const char *expalts[] = {
+    [LITERAL] = "LITERAL", [VAR] = "VAR", [SET] = "SET", [IFX] = "IFX",
+    [WHILEX] = "WHILEX", [BEGIN] = "BEGIN", [LETX] = "LETX",
+    [LAMBDAX] = "LAMBDAX", [APPLY] = "APPLY", [BREAKX] = "BREAKX",
+    [CONTINUEX] = "CONTINUEX", [RETURNX] = "RETURNX", [THROW] = "THROW",
+    [TRY_CATCH] = "TRY_CATCH", [HOLE] = "HOLE",
+    [WHILE_RUNNING_BODY] = "WHILE_RUNNING_BODY", [CALLENV] = "CALLENV",
+    [LETXENV] = "LETXENV",
+};
+
+static const char *valuealts[] = {
+    [SYM] = "SYM", [NUM] = "NUM", [BOOLV] = "BOOLV", [NIL] = "NIL",
+    [PAIR] = "PAIR", [CLOSURE] = "CLOSURE", [PRIMITIVE] = "PRIMITIVE",
+};
+
+void stack_trace_ring(int capacity, const char *filename) {
+    size_t size;
+    char keyname[1024];
+    unsigned i;
+    int fd;
+
+    if (capacity > MAXTRACERING)
+        capacity = MAXTRACERING;
+    if (ring != NULL && (uint32_t)capacity == ring->capacity &&
+        strcmp(filename, ringname) == 0)
+        return;
+    if (ring != NULL) {  // finish the old trace
+        munmap(ring, sizeof(*ring) + ring->capacity * sizeof(*records));
+        ring = NULL;
+        fclose(tracekey);
+        free(expids.exps);
+        free(expids.ids);
+        expids.exps = NULL;
+        expids.ids  = NULL;
+        expids.size = expids.used = 0;
+        tracesteps = 0;
+    }
+    if (capacity <= 0)
+        return;
+    size = sizeof(*ring) + (size_t)capacity * sizeof(*records);
+    fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0 || ftruncate(fd, size) != 0)
+        runerror("cannot create trace file %s", filename);
+    ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        ring = NULL;
+        runerror("cannot map trace file %s", filename);
+    }
+    snprintf(keyname, sizeof(keyname), "%s.key", filename);
+    tracekey = fopen(keyname, "w");
+    if (tracekey == NULL) {
+        munmap(ring, size);
+        ring = NULL;
+        runerror("cannot create trace key %s", keyname);
+    }
+    snprintf(ringname, sizeof(ringname), "%s", filename);
+    memcpy(ring->magic, TRACEMAGIC, sizeof(ring->magic));
+    ring->recordsize = sizeof(*records);
+    ring->capacity = capacity;
+    ring->nrecords = 0;
+    records = (struct Tracerecord *)(ring + 1);
+    for (i = 0; i < sizeof(expalts) / sizeof(expalts[0]); i++)
+        if (expalts[i])
+            fprintf(tracekey, "x %u %s\n", i, expalts[i]);
+    for (i = 0; i < sizeof(valuealts) / sizeof(valuealts[0]); i++)
+        if (valuealts[i])
+            fprintf(tracekey, "v %u %s\n", i, valuealts[i]);
+    fflush(tracekey);
+}
+
+static uint32_t expid(Exp e) {
+    uint32_t i;
+
+    if (e == NULL)
+        return 0;
+    if (2 * (expids.used + 1) > expids.size) {  // grow and rehash
+        Exp *exps = expids.exps;
+        uint32_t *ids = expids.ids, n = expids.size, j;
+        expids.size = n ? 2 * n : 1024;
+        expids.exps = calloc(expids.size, sizeof(*expids.exps));
+        expids.ids  = calloc(expids.size, sizeof(*expids.ids));
+        assert(expids.exps && expids.ids);
+        for (j = 0; j < n; j++)
+            if (exps[j] != NULL) {
+                for (i = ((uintptr_t)exps[j] >> 4) & (expids.size - 1);
+                     expids.exps[i] != NULL; i = (i + 1) & (expids.size - 1))
+                    ;
+                expids.exps[i] = exps[j];
+                expids.ids[i]  = ids[j];
+            }
+        free(exps);
+        free(ids);
+    }
+    for (i = ((uintptr_t)e >> 4) & (expids.size - 1); expids.exps[i] != NULL;
+         i = (i + 1) & (expids.size - 1))
+        if (expids.exps[i] == e)
+            return expids.ids[i];
+    expids.exps[i] = e;
+    expids.ids[i]  = ++expids.used;
+    fprint(tracekey, "e %d %e\n", expids.used, e);
+    fflush(tracekey);
+    return expids.used;
+}
+
+static void tracerecord(int kind, int tag, Exp e, Stack s) {
+    struct Tracerecord *r = &records[ring->nrecords % ring->capacity];
+    r->step   = ++tracesteps;
+    r->exp    = expid(e);
+    r->depth  = stackdepth(s);
+    r->kind   = kind;
+    r->tag    = tag;
+    r->unused = 0;
+    ring->nrecords++;
+}
+/* stack-debug.c S193a */
+void stack_trace_init(int *countp) { 
+    etick = vtick = 0; 
+    trace_countp = countp;
+}
+/* stack-debug.c S193c */
+void stack_trace_current_expression(Exp e, Env rho, Stack s) {
+    if (ring)
+        tracerecord('e', e->alt, e, s);
+    if (trace_countp && *trace_countp != 0) {
+        (*trace_countp)--;
+        etick++;
+        fprint(stderr, "exp  %d = %e\n", etick, e);
+        fprint(stderr, "env  %R\n", rho);
+        fprint(stderr, "stack\n%S\n", s);
+    }
+}
+/* stack-debug.c S193d */
+void stack_trace_current_value(Value v, Env rho, Stack s) {
+    if (ring) {
+        Frame *fr = topframe(s);
+        tracerecord('v', v.alt, fr ? fr->syntax : NULL, s);
+    }
+    if (trace_countp && *trace_countp != 0) {
+        (*trace_countp)--;
+        vtick++;
+        fprint(stderr, "val  %d = %v\n", vtick, v);
+        fprint(stderr, "env  %R\n", rho);
+        if (topframe(s)) 
+            fprint(stderr, "stack\n%S\n", s);
+        else 
+            fprint(stderr, " (final answer from stack-based eval)\n");
+    }
+}
@@ -0,0 +1,182 @@
+/* tracedump.c: decode a binary trace written under &trace-ring */
+/*
+ * Usage: tracedump [-s] [-n count] [file]
+ *
+ * Reads the ring buffer in [[file]] (default stack.trace) and its key
+ * in file.key.  By default, prints the retained records, oldest first,
+ * one step per line; [[-n]] limits the output to the newest [[count]].
+ * With [[-s]], prints a summary instead: steps by tag, and the
+ * expressions at which the most steps were taken.  The layout of the
+ * records is shared with stack-debug.c.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACEMAGIC "USTRACE1"
+
+struct Traceheader {
+    char     magic[8];
+    uint32_t recordsize;
+    uint32_t capacity;    // records in the ring
+    uint64_t nrecords;    // records ever written
+};
+
+struct Tracerecord {
+    uint32_t step;        // number of the step, counting from 1
+    uint32_t exp;         // expression, or context of value; 0 if none
+    uint32_t depth;       // frames on the stack
+    uint8_t  kind;        // 'e' for an expression, 'v' for a value
+    uint8_t  tag;         // Expalt of the expression, or Valuealt of the value
+    uint16_t unused;
+};
+
+static char *expalts[256], *valuealts[256];
+static char **exps;       // text of each expression, by number
+static uint32_t nexps;
+
+static void fail(const char *msg, const char *name) {
+    fprintf(stderr, "tracedump: %s %s\n", msg, name);
+    exit(1);
+}
+
+static char *copy(const char *s) {
+    char *t = malloc(strlen(s) + 1);
+    if (t == NULL)
+        fail("out of memory reading", "key");
+    return strcpy(t, s);
+}
+
+static const char *tagname(int kind, unsigned tag) {
+    const char *name = kind == 'e' ? expalts[tag] : valuealts[tag];
+    return name ? name : "?";
+}
+
+static const char *exptext(uint32_t id) {
+    return id > 0 && id <= nexps && exps[id] ? exps[id] : "";
+}
+/* tracedump.c: reading the key */
+static void readkey(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    static char line[8192];
+
+    if (fp == NULL)
+        fail("cannot open", filename);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char kind;
+        unsigned n;
+        int len;
+
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "%c %u %n", &kind, &n, &len) < 2)
+            continue;
+        if (kind == 'x' && n < 256)
+            expalts[n] = copy(line + len);
+        else if (kind == 'v' && n < 256)
+            valuealts[n] = copy(line + len);
+        else if (kind == 'e') {
+            if (n > nexps) {
+                uint32_t size = n > 2 * nexps ? n : 2 * nexps;
+                exps = realloc(exps, (size + 1) * sizeof(*exps));
+                if (exps == NULL)
+                    fail("out of memory reading", filename);
+                memset(exps + nexps + 1, 0, (size - nexps) * sizeof(*exps));
+                nexps = size;
+            }
+            exps[n] = copy(line + len);
+        }
+    }
+    fclose(fp);
+}
+/* tracedump.c: summarizing */
+struct Count { uint32_t exp; uint64_t n; };
+
+static int morefirst(const void *p, const void *q) {
+    const struct Count *a = p, *b = q;
+    return a->n < b->n ? 1 : a->n > b->n ? -1 : 0;
+}
+
+static void summarize(struct Tracerecord *rs, uint64_t first, uint64_t last,
+                      uint32_t capacity) {
+    uint64_t bytag[2][256] = { { 0 } }, i;
+    struct Count *counts = calloc(nexps + 1, sizeof(*counts));
+    uint32_t maxdepth = 0, k;
+
+    if (counts == NULL)
+        fail("out of memory summarizing", "trace");
+    for (k = 0; k <= nexps; k++)
+        counts[k].exp = k;
+    for (i = first; i < last; i++) {
+        struct Tracerecord *r = &rs[i % capacity];
+        bytag[r->kind == 'v'][r->tag]++;
+        if (r->exp <= nexps)
+            counts[r->exp].n++;
+        if (r->depth > maxdepth)
+            maxdepth = r->depth;
+    }
+    printf("%llu steps retained, deepest stack %u frames\n",
+           (unsigned long long)(last - first), maxdepth);
+    for (k = 0; k < 2 * 256; k++)
+        if (bytag[k / 256][k % 256])
+            printf("  %-5s %-20s %12llu\n", k / 256 ? "value" : "exp",
+                   tagname(k / 256 ? 'v' : 'e', k % 256),
+                   (unsigned long long)bytag[k / 256][k % 256]);
+    qsort(counts + 1, nexps, sizeof(*counts), morefirst);
+    printf("busiest expressions:\n");
+    for (k = 1; k <= nexps && k <= 20 && counts[k].n > 0; k++)
+        printf("  %12llu  %.60s\n", (unsigned long long)counts[k].n,
+               exptext(counts[k].exp));
+    free(counts);
+}
+/* tracedump.c: main */
+int main(int argc, char *argv[]) {
+    const char *filename = "stack.trace";
+    char keyname[1024];
+    uint64_t count = UINT64_MAX, first, last, i;
+    int summary = 0, a;
+    struct Traceheader h;
+    struct Tracerecord *rs;
+    FILE *fp;
+
+    for (a = 1; a < argc; a++)
+        if (strcmp(argv[a], "-s") == 0)
+            summary = 1;
+        else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+            count = strtoull(argv[++a], NULL, 10);
+        else if (argv[a][0] == '-') {
+            fprintf(stderr, "Usage: %s [-s] [-n count] [file]\n", argv[0]);
+            return 1;
+        } else
+            filename = argv[a];
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL)
+        fail("cannot open", filename);
+    if (fread(&h, sizeof(h), 1, fp) != 1 ||
+        memcmp(h.magic, TRACEMAGIC, sizeof(h.magic)) != 0 ||
+        h.recordsize != sizeof(*rs) || h.capacity == 0)
+        fail("not a trace:", filename);
+    rs = malloc((size_t)h.capacity * sizeof(*rs));
+    if (rs == NULL || fread(rs, sizeof(*rs), h.capacity, fp) != h.capacity)
+        fail("cannot read records from", filename);
+    fclose(fp);
+    snprintf(keyname, sizeof(keyname), "%s.key", filename);
+    readkey(keyname);
+
+    last  = h.nrecords;
+    first = last > h.capacity ? last - h.capacity : 0;
+    if (last - first > count)
+        first = last - count;
+    if (summary)
+        summarize(rs, first, last, h.capacity);
+    else
+        for (i = first; i < last; i++) {
+            struct Tracerecord *r = &rs[i % h.capacity];
+            printf("%10u %-5s %6u %-10s %.50s\n", r->step,
+                   r->kind == 'v' ? "value" : "exp", r->depth,
+                   tagname(r->kind, r->tag), exptext(r->exp));
+        }
+    free(rs);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#include "all.h"
+/* validate.c S210c */
+Value validate(Value v) {
+    assert(v.alt != INVALID);
+    return v;
+}
@@ -1,53 +1,37 @@
 #include "all.h"
 /* context-lists.c S193e */
-/* private functions for updating lists of expressions in contexts S194b */
-static void fill_hole(Exp e, Value v) {
-  assert(e->alt == HOLE);
-  e->alt = LITERAL;
-  e->u.literal = v;
-}
-/* private functions for updating lists of expressions in contexts S194c */
-static Explist find_explist_hole(Explist es) {
-  while (es && es->hd->alt != HOLE)
-    es = es->tl;
-  return es;
-}
-/* context-lists.c S194a */
-Exp transition_explist(Explist es, Value v) {
-  Explist p = find_explist_hole(es);
-  assert(p);
-  fill_hole(p->hd, v);
-  return head_replaced_with_hole(p->tl);
-}
-/* context-lists.c S194d */
-Exp head_replaced_with_hole(Explist es) {
-  static struct Exp a_copy; // overwritten by subsequent calls
-  if (es) {
-    a_copy = *es->hd;
-    *es->hd = mkHoleStruct();
-    return &a_copy;
-  } else {
-    return NULL;
-  }
-}
-/* context-lists.c S194e */
-Explist copyEL(Explist es) {
+/*
+ * While the actual parameters of an [[APPLY]], or the right-hand sides
+ * of a [[LET]] or [[LETREC]], are being evaluated, the frame shares its
+ * [[Explist]] with the abstract syntax, which is never mutated.  The
+ * frame instead records the expressions still pending, and it saves
+ * each value in one of the slots reserved below it when it was pushed.
+ */
+/* context-lists.c: values in frames */
+Exp nextpending(Frame *fr) {
+  Explist es = fr->es;
   if (es == NULL)
     return NULL;
-  else {
-    Exp e = malloc(sizeof(*e));
-    assert(e);
-    *e = *es->hd;
-    return mkEL(e, copyEL(es->tl));
-  }
+  fr->es = es->tl;
+  return es->hd;
 }
-/* context-lists.c S195a */
-void freeEL(Explist es) {
-  if (es != NULL) {
-    freeEL(es->tl);
-    free(es->hd);
-    free(es);
-  }
+
+void pushvalue(Frame *fr, Value v) {
+  assert(fr->nvalues < fr->nslots);
+  framevalues(fr)[fr->nvalues++] = v;
+}
+
+Value *framevalues(Frame *fr) {
+  return (Value *)fr - fr->nslots;
+}
+
+Valuelist framevaluelist(Frame *fr, int first) {
+  Value *vals = framevalues(fr);
+  Valuelist vs = NULL;
+  int i;
+  for (i = fr->nvalues - 1; i >= first; i--)
+    vs = mkVL(validate(vals[i]), vs);
+  return vs;
 }
 /* context-lists.c S195b */
 void freeVL(Valuelist vs) {
@@ -56,16 +40,3 @@ void freeVL(Valuelist vs) {
     free(vs);
   }
 }
-/* context-lists.c S195c */
-Valuelist asLiterals(Explist es) {
-  if (es == NULL)
-    return NULL;
-  else
-    return mkVL(asLiteral(es->hd), asLiterals(es->tl));
-
-}
-/* context-lists.c S195d */
-Value asLiteral(Exp e) {
-  assert(e->alt == LITERAL);
-  return validate(e->u.literal);
-}
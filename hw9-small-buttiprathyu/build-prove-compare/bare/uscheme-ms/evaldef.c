@@ -5,10 +5,9 @@ Env evaldef(Def d, Env env, Echo echo) {
     case VAL:
         /* evaluate [[val]] binding and return new environment 170c */
         {
-            pushcontext(*d->u.val.exp, roots.stack);
+            pushframe(BEGIN, d->u.val.exp, 0, roots.stack);
             if (find(d->u.val.name, env) == NULL)
                 env = bindalloc(d->u.val.name, unspecified(), env);
-            *d->u.val.exp = topframe(roots.stack)->context;
             popframe(roots.stack);
             Value v = eval(d->u.val.exp, env);
             *find(d->u.val.name, env) = v;
@@ -54,7 +53,7 @@ Env evaldef(Def d, Env env, Echo echo) {
 void readevalprint(XDefstream xdefs, Env *envp, Echo echo) {
     roots.globals.internal.pending_tests =
                               mkULL(NULL, roots.globals.internal.pending_tests);
-    roots.registers = NULL;  // clean up after syntax error
+    roots.registers.sp = 0;  // clean up after syntax error
 
     for (XDef d = getxdef(xdefs); d; d = getxdef(xdefs))
         switch (d->alt) {
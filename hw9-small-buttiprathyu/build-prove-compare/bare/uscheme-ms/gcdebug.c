@@ -17,7 +17,7 @@
 /* gcdebug.c S208d */
 static int gc_pool_object;
 static void *gc_pool = &gc_pool_object;  /* valgrind needs this */
-static int gcverbose;  /* GCVERBOSE tells gcprintf & gcprint to make noise */
+static __thread int gcverbose;  /* GCVERBOSE tells gcprintf & gcprint to make noise */
 
 void gc_debug_init(void) {
     VALGRIND_CREATE_MEMPOOL(gc_pool, 0, gc_uses_mark_bits);
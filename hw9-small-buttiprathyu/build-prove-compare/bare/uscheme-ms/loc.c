@@ -1,9 +1,11 @@
 #include "all.h"
+#include <pthread.h>
 /* loc.c 304f */
 Value* allocate(Value v) {
     Value *loc;
 
     pushreg(&v);
+    safepoint();
     loc = allocloc();
     popreg(&v);
     assert(loc != NULL);
@@ -19,6 +21,20 @@ int gammadesired(int defaultval, int minimum) {
     else
         return defaultval;
 }
+/* loc.c: heap shrinking */
+/*
+ * When the heap grows past [[&gamma-shrink]] percent of live data,
+ * a collector gives memory back to the operating system until the
+ * ratio is back near [[&gamma-desired]].
+ */
+int gammashrink(int defaultval, int minimum) {
+    assert(roots.globals.user != NULL);
+    Value *shrinkloc = find(strtoname("&gamma-shrink"), *roots.globals.user);
+    if (shrinkloc && shrinkloc->alt == NUM)
+        return shrinkloc->u.num > minimum ? shrinkloc->u.num : minimum;
+    else
+        return defaultval;
+}
 /* loc.c S210d */
 extern void printfinalstats(void);
 void initallocate(Env *globals) {
@@ -26,6 +42,218 @@ void initallocate(Env *globals) {
     roots.globals.user                   = globals;
     roots.globals.internal.pending_tests = NULL;
     roots.stack     = emptystack();
-    roots.registers = NULL;
-    atexit(printfinalstats);
+    roots.registers.sp = 0;
+}
+/* loc.c: releasing the heap */
+/*
+ * [[freeallocate]] reports the statistics of the calling thread's
+ * collector, then gives back its heap, its binding records, and its
+ * registers.  The workers that shared the heap have already quit.
+ */
+static void freesharedheap(void);
+
+void freeallocate(void) {
+    printfinalstats();
+    freeheap();
+    freebindings();
+    freesharedheap();
+    free(roots.registers.regs);
+    roots.registers.regs = NULL;
+    roots.registers.size = roots.registers.sp = 0;
+    roots.globals.user = NULL;
+}
+/* loc.c: sharing the heap */
+/*
+ * The threads of one interpreter share its heap: its own thread and
+ * the workers that run its futures.  Each thread allocates from a
+ * buffer of its own, which the collector hands out under a lock, so a
+ * thread takes no lock until its buffer runs out.  Binding records and
+ * continuations are kept in tables that the threads share.
+ *
+ * Objects move or die only while every other thread is stopped.  A
+ * thread that must collect sets [[stopping]] and waits until no other
+ * thread is running; each of the others stops at its next safepoint,
+ * which comes at every allocation and at every step [[eval]] takes
+ * toward a new expression, and waits there until the collection is
+ * over.  A thread that waits for another, in [[touch]], for work, or
+ * to join the workers, counts as stopped for as long as it waits.  A
+ * stopped thread has given back its buffer, and every pointer into
+ * the heap that it holds is in its roots, so the collector can find
+ * and update them all.  A thread that waits for input is not stopped,
+ * so a collection that a worker needs waits for the input too.
+ */
+struct Sharedheap {
+    pthread_mutex_t lock;      // guards everything below
+    pthread_cond_t stopped;    // signaled when a thread stops or quits
+    pthread_cond_t resumed;    // broadcast when a collection is over
+    struct Roots **roots;      // the roots of every thread sharing the heap
+    int nthreads, size;
+    int nrunning;              // threads that are not stopped
+    bool stopping;             // a thread waits to collect
+    Env *globals;              // the interpreter's global variables
+    Heap heap;                 // what the collector keeps
+    Envtable envs;
+    Conttable conts;
+};
+static __thread Sharedheap shared;  /* NULL until the heap is shared */
+
+bool heap_is_shared = true;
+
+static void addthread(Sharedheap h) {  // called with h locked
+    if (h->nthreads == h->size) {
+        h->size = h->size ? 2 * h->size : 8;
+        h->roots = realloc(h->roots, h->size * sizeof(*h->roots));
+        assert(h->roots != NULL);
+    }
+    h->roots[h->nthreads++] = &roots;
+    h->nrunning++;
+}
+
+Sharedheap sharedheap(void) {
+    if (shared == NULL) {
+        shared = calloc(1, sizeof(*shared));
+        assert(shared != NULL);
+        pthread_mutex_init(&shared->lock, NULL);
+        pthread_cond_init(&shared->stopped, NULL);
+        pthread_cond_init(&shared->resumed, NULL);
+        shared->globals = roots.globals.user;
+        shared->heap    = gcheap();
+        shared->envs    = envtable();
+        shared->conts   = conttable();
+        addthread(shared);
+    }
+    return shared;
+}
+/*
+ * A worker that joins while a collection is under way waits for it
+ * to finish.  It sees the interpreter's global variables, so that its
+ * collections see the interpreter's options.
+ */
+void joinheap(Sharedheap h) {
+    shared = h;
+    usegcheap(h->heap);
+    useenvtable(h->envs);
+    useconttable(h->conts);
+    roots.globals.user = h->globals;
+    pthread_mutex_lock(&h->lock);
+    while (h->stopping)
+        pthread_cond_wait(&h->resumed, &h->lock);
+    addthread(h);
+    pthread_mutex_unlock(&h->lock);
+}
+
+void quitheap(void) {
+    int i;
+
+    retirebuffer();
+    retirebindings();
+    pthread_mutex_lock(&shared->lock);
+    for (i = 0; shared->roots[i] != &roots; i++)
+        assert(i < shared->nthreads);
+    shared->roots[i] = shared->roots[--shared->nthreads];
+    shared->nrunning--;
+    pthread_cond_signal(&shared->stopped);
+    pthread_mutex_unlock(&shared->lock);
+    shared = NULL;
+    usegcheap(NULL);
+    useenvtable(NULL);
+    useconttable(NULL);
+    roots.globals.user = NULL;
+    free(roots.registers.regs);
+    roots.registers.regs = NULL;
+    roots.registers.size = roots.registers.sp = 0;
+}
+
+static void freesharedheap(void) {
+    if (shared == NULL)
+        return;
+    assert(shared->nthreads == 1);
+    free(shared->roots);
+    pthread_mutex_destroy(&shared->lock);
+    pthread_cond_destroy(&shared->stopped);
+    pthread_cond_destroy(&shared->resumed);
+    free(shared);
+    shared = NULL;
+}
+/* loc.c: stopping the world */
+/*
+ * A thread that stops, or that starts to collect, first gives back
+ * the rest of its allocation buffer and of the binding records it has
+ * taken.  Until the heap is shared, the calling thread is the only one.
+ */
+bool collectionpending(void) {
+    return shared != NULL && __atomic_load_n(&shared->stopping,
+                                             __ATOMIC_ACQUIRE);
+}
+
+void beginblocking(void) {
+    if (shared == NULL)
+        return;
+    retirebuffer();
+    retirebindings();
+    pthread_mutex_lock(&shared->lock);
+    shared->nrunning--;
+    pthread_cond_signal(&shared->stopped);
+    pthread_mutex_unlock(&shared->lock);
+}
+
+void endblocking(void) {
+    if (shared == NULL)
+        return;
+    pthread_mutex_lock(&shared->lock);
+    while (shared->stopping)
+        pthread_cond_wait(&shared->resumed, &shared->lock);
+    shared->nrunning++;
+    pthread_mutex_unlock(&shared->lock);
+}
+
+void safepoint(void) {
+    if (collectionpending()) {
+        beginblocking();
+        endblocking();
+    }
+}
+/*
+ * Two threads may find the heap full at once; the second stops for the
+ * first one's collection and then tries its allocation again.
+ */
+bool stopworld(void) {
+    retirebuffer();
+    retirebindings();
+    if (shared == NULL)
+        return true;
+    pthread_mutex_lock(&shared->lock);
+    if (shared->stopping) {
+        pthread_mutex_unlock(&shared->lock);
+        safepoint();
+        return false;
+    }
+    __atomic_store_n(&shared->stopping, true, __ATOMIC_RELEASE);
+    shared->nrunning--;
+    while (shared->nrunning > 0)
+        pthread_cond_wait(&shared->stopped, &shared->lock);
+    pthread_mutex_unlock(&shared->lock);
+    return true;
+}
+
+void startworld(void) {
+    if (shared == NULL)
+        return;
+    pthread_mutex_lock(&shared->lock);
+    __atomic_store_n(&shared->stopping, false, __ATOMIC_RELEASE);
+    shared->nrunning++;
+    pthread_cond_broadcast(&shared->resumed);
+    pthread_mutex_unlock(&shared->lock);
+}
+
+struct Roots **allroots(int *n) {
+    static __thread struct Roots *mine[1];
+
+    if (shared == NULL) {
+        mine[0] = &roots;
+        *n = 1;
+        return mine;
+    }
+    *n = shared->nthreads;
+    return shared->roots;
 }
@@ -1,14 +1,23 @@
+#define _DEFAULT_SOURCE  /* for MAP_ANONYMOUS */
 #include "all.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 /* ms.c 305a */
 /* private declarations for mark-and-sweep collection 305b */
 typedef struct Mvalue Mvalue;
 struct Mvalue {
     Value v;
-    unsigned live:1;
+    unsigned live;  /* a whole word, so markers can set it atomically */
 };
 /* private declarations for mark-and-sweep collection 306b */
+/*
+ * Each page is mapped separately and fills one 4K page of memory, so
+ * a page with no live cells can be unmapped after a sweep.
+ */
+#define PAGEBYTES 4096
 #ifndef GCHYPERDEBUG /*OMIT*/
-#define GROWTH_UNIT 24\
+#define GROWTH_UNIT ((PAGEBYTES - 2 * sizeof(void *)) / sizeof(Mvalue))\
                     /* increment in which the heap grows, measured in objects */
 #else /*OMIT*/
 #define GROWTH_UNIT 3 /*OMIT*/
@@ -17,27 +26,111 @@ typedef struct Page Page;
 struct Page {
     Mvalue pool[GROWTH_UNIT];
     Page *tl;
+    int nlive;  /* live cells found by the last sweep */
 };
 /* private declarations for mark-and-sweep collection 306c */
-Page *pagelist, *curpage;
-Mvalue *hp, *heaplimit;
+/*
+ * The pages belong to the interpreter's heap, which all its threads
+ * share.  Each thread allocates from a page of its own, its buffer, and
+ * when the buffer is used up, it takes the next page under the heap's
+ * lock.  Once every page has been taken, the heap is collected.
+ */
+struct Heap {
+    pthread_mutex_t lock;  // guards the pages and the next page to take
+    Page *pagelist;
+    Page **pagetable;      // every page, in [[pagelist]] order
+    int npages;
+    int nextpage;          // index in [[pagetable]] of the next page to take
+    int heapsize;
+    struct Markpool *pool; // the markers, from the first collection on
+    int nalloc;            /* total number of allocations */
+    int ncollections;      /* total number of collections */
+    int nmarks;            /* total number of cells marked */
+    int nreleased;         /* total number of pages unmapped */
+    int maxheapsize;       /* largest heap, in cells */
+};
+static __thread Heap gc;  /* the heap of the current thread */
+
+static __thread Page *curpage;  /* the thread's buffer */
+static __thread Mvalue *hp, *heaplimit;
 /* private declarations for mark-and-sweep collection 307b */
 static void visitloc          (Value *loc);
 static void visitvalue        (Value v);
 static void visitenv          (Env env);
 static void visitexp          (Exp exp);
 static void visitexplist      (Explist es);
-static void visitframe        (Frame *fr);
-static void visitstack        (Stack s);
+static void visitframe        (Frame *fr, void *cl);
 static void visittest         (UnitTest t);
 static void visittestlists    (UnitTestlistlist uss);
 static void visitregister     (Register reg);
-static void visitregisterlist (Registerlist regs);
+static void visitregisters    (struct Registerstack *rs);
 static void visitroots        (void);
+static void visitcontinuation (int k);
+static void visitfuture       (int k);
 /* private declarations for mark-and-sweep collection S513a */
-static int nalloc;              /* total number of allocations */
-static int ncollections;        /* total number of collections */
-static int nmarks;              /* total number of cells marked */
+static __thread int nalloc;  /* allocations not yet added to the heap's */
+/* private declarations for parallel marking */
+/*
+ * Marking is driven by explicit mark deques instead of C recursion.
+ * A cell is pushed on a deque at the moment its mark bit is set, so
+ * every cell is pushed at most once.  With one marker, the deque is
+ * used as a plain stack.  With several markers, each owns a deque,
+ * pushes and pops at its bottom, and steals from the top of the
+ * others' deques when it runs dry.  The deques are Chase-Lev deques:
+ * the owner takes no lock and fences only when it pops, and a thief
+ * claims a cell with a compare-and-swap on [[top]].
+ *
+ * Everything the markers of one interpreter share is in that
+ * interpreter's pool.  A worker thread has none of the interpreter's
+ * thread-local state, so it finds the heap and the roots of every
+ * thread in the pool, and instead of marking the continuations and
+ * futures it reaches, it records them for the thread that collects.
+ */
+#define MAXMARKERS  64  /* upper bound on &gc-threads */
+#define NFIXEDROOTS 3   /* per thread: globals, pending tests, registers */
+
+typedef struct Markarray Markarray;
+struct Markarray {
+    long size;             // a power of 2
+    Markarray *retired;    // smaller arrays this one replaced
+    Mvalue *items[];       // indexed modulo size
+};
+
+typedef struct Markdeque Markdeque;
+struct Markdeque {
+    Markarray *array;      // cells marked but not yet visited
+    long top, bottom;      // pending cells are items[top..bottom)
+    int nmarks;            // cells this marker has visited
+    int nlive;             // live cells this marker found while sweeping
+    int *conts;            // continuations a worker has reached
+    int nconts, contsize;
+    int *futures;          // futures a worker has reached
+    int nfutures, futuresize;
+    struct Markpool *pool; // the pool this deque belongs to
+};
+
+struct Markpool {
+    Markdeque deques[MAXMARKERS];
+    int nmarkers;         // markers in the current collection
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+    enum { MARK, SWEEP } job;
+    unsigned generation;  // bumped to start each job
+    bool quit;            // set when the interpreter is released
+    pthread_t threads[MAXMARKERS];  // threads[i] runs deques[i], i > 0
+    int nstarted;         // worker threads running, not counting main
+    int busy;             // workers that have not finished the current job
+    int nroottasks;       // root tasks in the current collection
+    int nextroottask;     // next root task to be claimed
+    int nidle;            // markers that have run out of work
+    Heap heap;            // the heap being collected
+    struct Roots **roots; // the roots of every thread that shares it
+    int nroots;
+    int *firsttask;       // number of the first root task of each thread
+    int firstsize;
+};
+static __thread struct Markpool *pool;  /* pool of the current marker */
+static __thread Markdeque *mydeque;     /* deque of the current marker */
 /* ms.c 306a */
 int gc_uses_mark_bits = 1;
 /* ms.c 306d */
@@ -48,10 +141,10 @@ static void makecurrent(Page *page) {
     heaplimit = &page->pool[GROWTH_UNIT];
 }
 /* ms.c 306e */
-static int heapsize;            /* OMIT */
-static void addpage(void) {
-    Page *page = calloc(1, sizeof(*page));
-    assert(page != NULL);
+static void addpage(void) {  // called with the heap locked or stopped
+    Page *page = mmap(NULL, sizeof(*page), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(page != MAP_FAILED);
 
 /* tell the debugging interface that each object on [[page]] has been acquired 322a */
     {   unsigned i;
@@ -59,37 +152,133 @@ static void addpage(void) {
             gc_debug_post_acquire(&page->pool[i].v, 1);
     }
 
-    if (pagelist == NULL) {
-        pagelist = page;
+    if (gc->pagelist == NULL) {
+        gc->pagelist = page;
     } else {
-        assert(curpage != NULL && curpage->tl == NULL);
-        curpage->tl = page;
+        assert(gc->pagetable[gc->npages - 1]->tl == NULL);
+        gc->pagetable[gc->npages - 1]->tl = page;
+    }
+    if ((gc->npages & (gc->npages - 1)) == 0) {
+        int size = gc->npages ? 2 * gc->npages : 1;
+        gc->pagetable = realloc(gc->pagetable, size * sizeof(*gc->pagetable));
+        assert(gc->pagetable != NULL);
     }
-    makecurrent(page);
-    heapsize += GROWTH_UNIT;   /* OMIT */
+    gc->pagetable[gc->npages++] = page;
+    gc->heapsize += GROWTH_UNIT;   /* OMIT */
+    if (gc->heapsize > gc->maxheapsize)
+        gc->maxheapsize = gc->heapsize;
 }
-/* ms.c ((prototype)) 307a */
-Value* allocloc(void) {
-    if (hp == heaplimit)
+/* ms.c: releasing pages */
+/*
+ * After a sweep, pages on which nothing survived can be unmapped.
+ * Pages are released until the heap is down to [[target]] cells,
+ * but at least one page is always kept.  The page table is rebuilt
+ * in list order.
+ */
+static void releasepages(int target) {
+    Page *page, *next, **tail = &gc->pagelist;
+    int i;
+
+    gc->npages = 0;
+    for (page = gc->pagelist; page != NULL; page = next) {
+        next = page->tl;
+        if (page->nlive == 0 && gc->heapsize - (int) GROWTH_UNIT >= target &&
+                                           (next != NULL || gc->npages > 0)) {
+            for (i = 0; i < (int) GROWTH_UNIT; i++)
+                gc_debug_pre_release(&page->pool[i].v, 1);
+            munmap(page, sizeof(*page));
+            gc->heapsize -= GROWTH_UNIT;
+            gc->nreleased++;
+        } else {
+            *tail = gc->pagetable[gc->npages++] = page;
+            tail = &page->tl;
+        }
+    }
+    *tail = NULL;
+}
+/* ms.c: the heap and the threads' buffers */
+Heap gcheap(void) {
+    if (gc == NULL) {
+        gc = calloc(1, sizeof(*gc));
+        assert(gc != NULL);
+        pthread_mutex_init(&gc->lock, NULL);
+    }
+    return gc;
+}
+
+void usegcheap(Heap h) {
+    gc = h;
+}
+/*
+ * The first page is made when the first buffer is taken.
+ */
+static bool takepage(void) {
+    Heap h = gcheap();
+    bool taken = true;
+
+    pthread_mutex_lock(&h->lock);
+    if (h->npages == 0)
         addpage();
-    assert(hp < heaplimit);
+    if (h->nextpage < h->npages)
+        makecurrent(h->pagetable[h->nextpage++]);
+    else
+        taken = false;
+    pthread_mutex_unlock(&h->lock);
+    return taken;
+}
+/*
+ * A thread gives back its buffer by passing over the rest of it, as
+ * [[allocloc]] would: a cell that survived the last collection has its
+ * mark bit cleared, and a free cell is filled with nil.  Every cell on
+ * a page that has been taken is then allocated, as the next sweep
+ * expects.
+ */
+void retirebuffer(void) {
+    for ( ; hp < heaplimit; hp++)
+        if (hp->live) {
+            hp->live = 0;
+        } else {
+            gc_debug_pre_allocate(&hp->v);
+            hp->v = mkNil();
+        }
+    curpage = NULL;
+    hp = heaplimit = NULL;
+    if (gc != NULL)
+        __atomic_add_fetch(&gc->nalloc, nalloc, __ATOMIC_RELAXED);
+    nalloc = 0;
+}
+/* ms.c 307a */
+static void collect(void);
+
+Value* allocloc(void) {
+    for (;;) {
+        for ( ; hp < heaplimit; hp++)
+            if (hp->live) {
+                hp->live = 0;    // survived the last collection; skip it
+            } else {
 
 /* tell the debugging interface that [[&hp->v]] is about to be allocated 322b */
-    gc_debug_pre_allocate(&hp->v);
-    return &(hp++)->v;
+                gc_debug_pre_allocate(&hp->v);
+                nalloc++;
+                return &(hp++)->v;
+            }
+        if (!takepage())
+            collect();
+    }
 }
 /* ms.c 308a */
 static void visitenv(Env env) {
-    for (; env; env = env->tl)
+    for (; env && markenv(env); env = env->tl)
         visitloc(env->loc);
 }
-/* ms.c ((prototype)) 308b */
+/* ms.c 308b */
+static void pushmark(Markdeque *d, Mvalue *m);
+
 static void visitloc(Value *loc) {
     Mvalue *m = (Mvalue*) loc;
-    if (!m->live) {
-        m->live = 1;
-        visitvalue(m->v);
-    }
+    if (!__atomic_load_n(&m->live, __ATOMIC_RELAXED) &&
+        !__atomic_exchange_n(&m->live, 1, __ATOMIC_RELAXED))
+        pushmark(mydeque, m);
 }
 /* ms.c 308c */
 static void visitregister(Value *reg) {
@@ -102,7 +291,12 @@ static void visitvalue(Value v) {
     case BOOLV:
     case NUM:
     case SYM:
+        return;
     case PRIMITIVE:
+        if (v.u.primitive.function == continuation)
+            visitcontinuation(v.u.primitive.tag);
+        else if (v.u.primitive.function == future)
+            visitfuture(v.u.primitive.tag);
         return;
     case PAIR:
         visitloc(v.u.pair.car);
@@ -190,28 +384,20 @@ static void visitexplist(Explist es) {
         visitexp(es->hd);
 }
 /* ms.c S203c */
-static void visitregisterlist(Registerlist regs) {
-    for ( ; regs != NULL; regs = regs->tl)
-        visitregister(regs->hd);
-}
-/* ms.c S203d */
-/* representation of [[struct Stack]] S189a */
-struct Stack {
-    int size;
-    Frame *frames;  // memory for 'size' frames
-    Frame *sp;      // points to first unused frame
-};
-static void visitstack(Stack s) {
-    Frame *fr;
-    for (fr = s->frames; fr < s->sp; fr++) {
-        visitframe(fr);
-    }
+static void visitregisters(struct Registerstack *rs) {
+    int i;
+    for (i = 0; i < rs->sp; i++)
+        visitregister(rs->regs[i]);
 }
 /* ms.c S203e */
-static void visitframe(Frame *fr) {
-    visitexp(&fr->context);
+static void visitframe(Frame *fr, void *cl) {
+    int i;
+    (void)cl;
     if (fr->syntax != NULL)
         visitexp(fr->syntax);
+    visitenv(fr->env);
+    for (i = 0; i < fr->nvalues; i++)
+        visitvalue(framevalues(fr)[i]);
 }
 /* ms.c S203f */
 static void visittestlists(UnitTestlistlist uss) {
@@ -238,19 +424,514 @@ static void visittest(UnitTest t) {
     assert(0);
 }
 /* ms.c S204b */
+/*
+ * The roots of each thread that shares the heap are split into
+ * independent tasks: the global environment, the pending tests, the
+ * registers, and one task per segment of the thread's stack.  Parallel
+ * markers claim tasks one at a time, numbered across all the threads;
+ * a single marker visits them in order, walking each stack in one pass.
+ * A worker that is quitting may have no globals left.
+ */
+static int countroottasks(void) {
+    int i, n = 0;
+
+    if (pool->nroots > pool->firstsize) {
+        pool->firstsize = pool->nroots;
+        pool->firsttask = realloc(pool->firsttask,
+                                  pool->firstsize * sizeof(*pool->firsttask));
+        assert(pool->firsttask != NULL);
+    }
+    for (i = 0; i < pool->nroots; i++) {
+        pool->firsttask[i] = n;
+        n += NFIXEDROOTS + stacksegments(pool->roots[i]->stack);
+    }
+    return n;
+}
+
+static struct Roots *taskroots(int *task) {  // renumbers task for its thread
+    int i = pool->nroots - 1;
+
+    while (pool->firsttask[i] > *task)
+        i--;
+    *task -= pool->firsttask[i];
+    return pool->roots[i];
+}
+
+static void visitroottask(struct Roots *r, int task) {
+    switch (task) {
+    case 0:
+        if (r->globals.user != NULL)
+            visitenv(*r->globals.user);
+        return;
+    case 1:
+        visittestlists(r->globals.internal.pending_tests);
+        return;
+    case 2:
+        visitregisters(&r->registers);
+        return;
+    default:
+        task -= NFIXEDROOTS;
+        walkstack(r->stack, task, task + 1, visitframe, NULL);
+        return;
+    }
+}
+
 static void visitroots(void) {
-    visitenv(*roots.globals.user);
-    visittestlists(roots.globals.internal.pending_tests);
-    visitstack(roots.stack);
-    visitregisterlist(roots.registers);
-}
-/* ms.c ((prototype)) S215b */
-/* you need to redefine these functions */
-void printfinalstats(void) { 
-  (void)nalloc; (void)ncollections; (void)nmarks;
-  assert(0); 
-}
-/* ms.c ((prototype)) S215c */
-void avoid_unpleasant_compiler_warnings(void) {
-    (void)visitroots;
+    int i, task;
+    for (i = 0; i < pool->nroots; i++) {
+        for (task = 0; task < NFIXEDROOTS; task++)
+            visitroottask(pool->roots[i], task);
+        walkstack(pool->roots[i]->stack, 0, INT_MAX, visitframe, NULL);
+    }
+}
+/* ms.c: mark deques */
+static bool parallel(void) {
+    return pool->nmarkers > 1;
+}
+
+/*
+ * When the owner outgrows its array, it copies the pending cells into
+ * a new one.  A thief may still be reading the old array, so the old
+ * array is kept until marking is over.
+ */
+static Mvalue *getmark(Markarray *a, long i) {
+    return __atomic_load_n(&a->items[i & (a->size - 1)], __ATOMIC_RELAXED);
+}
+
+static void putmark(Markarray *a, long i, Mvalue *m) {
+    __atomic_store_n(&a->items[i & (a->size - 1)], m, __ATOMIC_RELAXED);
+}
+
+static Markarray *growdeque(Markdeque *d, long top, long bottom) {
+    Markarray *old = d->array;
+    long i, size = old ? 2 * old->size : 256;
+    Markarray *a = malloc(sizeof(*a) + size * sizeof(a->items[0]));
+
+    assert(a != NULL);
+    a->size = size;
+    a->retired = old;
+    for (i = top; i < bottom; i++)
+        putmark(a, i, getmark(old, i));
+    __atomic_store_n(&d->array, a, __ATOMIC_RELEASE);
+    return a;
+}
+
+static void freeretired(Markdeque *d) {
+    Markarray *a, *next;
+    if (d->array == NULL)
+        return;
+    for (a = d->array->retired; a != NULL; a = next) {
+        next = a->retired;
+        free(a);
+    }
+    d->array->retired = NULL;
+}
+
+static void pushmark(Markdeque *d, Mvalue *m) {
+    long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&d->top,    __ATOMIC_ACQUIRE);
+    Markarray *a = d->array;
+
+    if (a == NULL || b - t >= a->size)
+        a = growdeque(d, t, b);
+    putmark(a, b, m);
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+}
+/*
+ * A pop can race with a thief only for the last pending cell; the
+ * owner and the thief settle it with a compare-and-swap on [[top]].
+ */
+static Mvalue *popmark(Markdeque *d) {
+    long b, t;
+    Mvalue *m;
+
+    if (!parallel())
+        return d->bottom > d->top ? getmark(d->array, --d->bottom) : NULL;
+    b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+    if (t < b)
+        return getmark(d->array, b);
+    m = NULL;
+    if (t == b) {
+        m = getmark(d->array, b);
+        if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            m = NULL;
+    }
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return m;
+}
+
+static Mvalue *stealmark(Markdeque *victim) {
+    long t, b;
+    Mvalue *m;
+
+    t = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b)
+        return NULL;
+    m = getmark(__atomic_load_n(&victim->array, __ATOMIC_ACQUIRE), t);
+    if (!__atomic_compare_exchange_n(&victim->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return NULL;  // lost the cell to the owner or to another thief
+    return m;
+}
+
+static bool hasmarks(Markdeque *d) {
+    return __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) >
+           __atomic_load_n(&d->top,    __ATOMIC_RELAXED);
+}
+
+static void drainmarks(Markdeque *d) {
+    Mvalue *m;
+    while ((m = popmark(d)) != NULL) {
+        d->nmarks++;
+        visitvalue(m->v);
+    }
+}
+/* ms.c: work stealing */
+/*
+ * A thief takes the older half of a victim's pending cells.  Those
+ * cells are nearest the roots, so they tend to lead to the most work.
+ */
+static bool steal(Markdeque *thief) {
+    int i, k;
+    int start = thief - pool->deques;
+    for (k = 1; k < pool->nmarkers; k++) {
+        Markdeque *victim = &pool->deques[(start + k) % pool->nmarkers];
+        Mvalue *m;
+        long n = (__atomic_load_n(&victim->bottom, __ATOMIC_RELAXED) -
+                  __atomic_load_n(&victim->top,    __ATOMIC_RELAXED) + 1) / 2;
+        if (n > 32)
+            n = 32;
+        for (i = 0; i < n && (m = stealmark(victim)) != NULL; i++)
+            pushmark(thief, m);
+        if (i > 0)
+            return true;
+    }
+    return false;
+}
+
+static bool anymarks(void) {
+    int i;
+    for (i = 0; i < pool->nmarkers; i++)
+        if (hasmarks(&pool->deques[i]))
+            return true;
+    return false;
+}
+/*
+ * A marker that finds no work to steal counts itself idle.  Only a
+ * marker with an empty deque is ever idle, and an idle marker
+ * becomes busy again only by finding pending cells, so once every
+ * marker is idle, marking is complete.
+ */
+static void parallelmark(Markdeque *d) {
+    int task;
+    while ((task = __atomic_fetch_add(&pool->nextroottask, 1,
+                                      __ATOMIC_RELAXED)) < pool->nroottasks) {
+        struct Roots *r = taskroots(&task);
+        visitroottask(r, task);
+        drainmarks(d);
+    }
+    for (;;) {
+        drainmarks(d);
+        if (steal(d))
+            continue;
+        __atomic_add_fetch(&pool->nidle, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (__atomic_load_n(&pool->nidle, __ATOMIC_SEQ_CST) ==
+                                                               pool->nmarkers)
+                return;
+            if (anymarks()) {
+                __atomic_sub_fetch(&pool->nidle, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+/* ms.c: sweeping */
+/*
+ * Sweeping reclaims every unmarked cell in a range of pages.  Marked
+ * cells keep their mark bits; [[allocloc]] clears each bit as it
+ * passes over the cell, so the heap is clean again by the time the
+ * next collection starts.
+ */
+static int sweeppages(int lo, int hi) {
+    int i, nlive = 0;
+    Mvalue *m;
+    for (i = lo; i < hi; i++) {
+        Page *page = gc->pagetable[i];
+        page->nlive = 0;
+        for (m = page->pool; m < page->pool + GROWTH_UNIT; m++)
+            if (m->live)
+                page->nlive++;
+            else
+                gc_debug_post_reclaim(&m->v);
+        nlive += page->nlive;
+    }
+    return nlive;
+}
+/* ms.c: the marking pool */
+static struct Markpool *newpool(Heap h) {
+    struct Markpool *p = calloc(1, sizeof(*p));
+    int i;
+    assert(p != NULL);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for (i = 0; i < MAXMARKERS; i++)
+        p->deques[i].pool = p;
+    p->nmarkers = 1;
+    p->heap = h;
+    return p;
+}
+
+static void remember(int **ks, int *n, int *size, int k) {
+    if (*n == *size) {
+        *size = *size ? 2 * *size : 16;
+        *ks = realloc(*ks, *size * sizeof(**ks));
+        assert(*ks != NULL);
+    }
+    (*ks)[(*n)++] = k;
+}
+
+static void visitcontinuation(int k) {
+    Markdeque *d = mydeque;
+    if (d == &pool->deques[0])
+        markcontinuation(k);
+    else
+        remember(&d->conts, &d->nconts, &d->contsize, k);
+}
+
+static void visitfuture(int k) {
+    Markdeque *d = mydeque;
+    if (d == &pool->deques[0])
+        markfuture(k);
+    else
+        remember(&d->futures, &d->nfutures, &d->futuresize, k);
+}
+
+static void runjob(Markdeque *d) {
+    int i = d - pool->deques, n = pool->nmarkers;
+    mydeque = d;
+    switch (pool->job) {
+    case MARK:
+        parallelmark(d);
+        return;
+    case SWEEP:
+        d->nlive = sweeppages(gc->npages * i / n, gc->npages * (i+1) / n);
+        return;
+    }
+    assert(0);
+}
+
+static void *markworker(void *arg) {
+    Markdeque *d = arg;
+    unsigned seen = 0;
+    bool quit;
+    pool = d->pool;
+    gc   = pool->heap;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->quit)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        seen = pool->generation;
+        quit = pool->quit;
+        pthread_mutex_unlock(&pool->lock);
+        if (quit)
+            return NULL;
+
+        if (d - pool->deques < pool->nmarkers)
+            runjob(d);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+/*
+ * The interpreter's own thread acts as marker 0.  Worker threads are
+ * started on demand and then kept until the interpreter is released.
+ */
+static void runpool(int job) {
+    while (pool->nstarted < pool->nmarkers - 1) {
+        int i = ++pool->nstarted;
+        if (pthread_create(&pool->threads[i], NULL, markworker,
+                           &pool->deques[i]) != 0) {
+            pool->nstarted--;
+            pool->nmarkers = pool->nstarted + 1;
+            break;
+        }
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->busy = pool->nstarted;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    runjob(&pool->deques[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+/* ms.c: collection */
+/*
+ * Marking threads come from [[&gc-threads]], which is consulted
+ * at every collection, just like [[&gamma-desired]].  The thread that
+ * collects first stops every other thread that shares the heap; if
+ * another thread collected while this one waited, and left pages to
+ * take, there is nothing more to do.  Once the heap is swept, every
+ * page can be taken again, starting from the first.
+ */
+static int gcthreads(void) {
+    Value *p = find(strtoname("&gc-threads"), *roots.globals.user);
+    if (p && p->alt == NUM && p->u.num > 1)
+        return p->u.num < MAXMARKERS ? p->u.num : MAXMARKERS;
+    else
+        return 1;
+}
+
+static void collect(void) {
+    int i, nlive = 0, nenvs;
+    int gamma, shrink;
+
+    if (!stopworld())
+        return;
+    if (gc->nextpage < gc->npages) {
+        startworld();
+        return;
+    }
+    gamma  = gammadesired(200, 110);      /* percent of live data */
+    shrink = gammashrink(2 * gamma, gamma);
+    gc->ncollections++;
+    if (gc->pool == NULL)
+        gc->pool = newpool(gc);
+    pool = gc->pool;
+    pool->roots = allroots(&pool->nroots);
+    pool->nmarkers = gcthreads();
+    for (i = 0; i < pool->nmarkers; i++)
+        pool->deques[i].nmarks = pool->deques[i].nlive =
+        pool->deques[i].nconts = pool->deques[i].nfutures = 0;
+    if (parallel()) {
+        int j;
+        pool->nroottasks   = countroottasks();
+        pool->nextroottask = 0;
+        pool->nidle        = 0;
+        runpool(MARK);
+        mydeque = &pool->deques[0];
+        for (i = 1; i < pool->nmarkers; i++) {
+            for (j = 0; j < pool->deques[i].nconts; j++)
+                markcontinuation(pool->deques[i].conts[j]);
+            for (j = 0; j < pool->deques[i].nfutures; j++)
+                markfuture(pool->deques[i].futures[j]);
+        }
+    } else {
+        mydeque = &pool->deques[0];
+        visitroots();
+        drainmarks(mydeque);
+    }
+    while (tracecontinuations(visitframe, NULL) ||  // marker 0 alone
+           tracefutures(visitregister))
+        drainmarks(mydeque);
+    for (i = 0; i < pool->nmarkers; i++)
+        freeretired(&pool->deques[i]);
+    if (parallel())
+        runpool(SWEEP);
+    else
+        pool->deques[0].nlive = sweeppages(0, gc->npages);
+    nenvs = sweepenvs();
+    sweepcontinuations();
+    sweepfutures();
+    for (i = 0; i < pool->nmarkers; i++) {
+        gc->nmarks += pool->deques[i].nmarks;
+        nlive  += pool->deques[i].nlive;
+    }
+    gcprintf("GC %d: %d of %d cells live, %d bindings live, %d marker%s\n",
+             gc->ncollections, nlive, gc->heapsize, nenvs,
+             pool->nmarkers, pool->nmarkers == 1 ? "" : "s");
+
+    /* shrink a heap that is too big, then grow one that is too small */
+    if (gc->heapsize * 100 > nlive * shrink) {
+        releasepages(nlive * gamma / 100);
+        gcprintf("GC %d: heap released to %d cells\n", gc->ncollections,
+                 gc->heapsize);
+    }
+    while (gc->heapsize * 100 < nlive * gamma || gc->heapsize == nlive)
+        addpage();
+    gc->nextpage = 0;
+    startworld();
+}
+/* ms.c: releasing the heap */
+/*
+ * [[freeheap]] gives back the pages, the page table, and the marker
+ * pool, whose worker threads are told to quit and then joined.  Every
+ * other thread that shared the heap has quit.  Every cell that is
+ * still allocated is reclaimed before its page goes: a cell is
+ * allocated if its page has been taken since the last sweep, or if it
+ * survived that sweep.
+ */
+static void freepool(struct Markpool *p) {
+    int i;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = true;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 1; i <= p->nstarted; i++)
+        pthread_join(p->threads[i], NULL);
+    for (i = 0; i < MAXMARKERS; i++) {
+        freeretired(&p->deques[i]);
+        free(p->deques[i].array);
+        free(p->deques[i].conts);
+        free(p->deques[i].futures);
+    }
+    free(p->firsttask);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+    free(p);
+}
+
+void freeheap(void) {
+    int i, k;
+
+    retirebuffer();
+    if (gc == NULL)
+        return;
+    if (gc->pool != NULL)
+        freepool(gc->pool);
+    pool = NULL;
+    mydeque = NULL;
+    for (k = 0; k < gc->npages; k++) {
+        Page *page = gc->pagetable[k];
+        for (i = 0; i < (int) GROWTH_UNIT; i++) {
+            Mvalue *m = &page->pool[i];
+            if (k < gc->nextpage || m->live)
+                gc_debug_post_reclaim(&m->v);
+            gc_debug_pre_release(&m->v, 1);
+        }
+        munmap(page, sizeof(*page));
+    }
+    free(gc->pagetable);
+    pthread_mutex_destroy(&gc->lock);
+    free(gc);
+    gc = NULL;
+}
+/* ms.c S215b */
+void printfinalstats(void) {
+    Heap h = gcheap();
+    fprintf(stderr, "[Mark-and-sweep GC: allocated %d cells; "
+                    "%d collections marked %d cells; heap size %d cells "
+                    "(max %d); %d pages released]\n",
+            h->nalloc + nalloc, h->ncollections, h->nmarks, h->heapsize,
+            h->maxheapsize, h->nreleased);
 }
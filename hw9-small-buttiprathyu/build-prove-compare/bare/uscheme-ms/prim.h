@@ -21,3 +21,15 @@ xx("println",    PRINTLN,    unary)
 xx("print",      PRINT,      unary)
 xx("printu",     PRINTU,     unary)
 xx("error",      ERROR,      unary)
+/* prim.h: control */
+xx("call/cc",  CALLCC,    control)
+xx("call/1cc", CALLONECC, control)
+/* prim.h: threads */
+xx("spawn",        SPAWN,     control)
+xx("yield",        YIELD,     control)
+xx("receive",      RECEIVE,   control)
+xx("make-channel", MKCHANNEL, channel)
+xx("send",         SEND,      channel)
+/* prim.h: futures */
+xx("future", FUTURE, control)
+xx("touch",  TOUCH,  control)
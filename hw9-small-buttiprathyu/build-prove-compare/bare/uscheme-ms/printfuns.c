@@ -189,7 +189,10 @@ static void printvalueat(Printbuf output, Value v, int depth) {
         bprint(output, "%n", v.u.sym);
         return;
     case PRIMITIVE:
-        bprint(output, "<procedure>");
+        if (v.u.primitive.function == future)
+            bprint(output, "<future>");
+        else
+            bprint(output, "<procedure>");
         return;
     case PAIR:
         bprint(output, "(");
@@ -211,7 +214,7 @@ void printvalue(Printbuf output, va_list_box *box) {
     printvalueat(output, va_arg(box->ap, Value), 0);
 }
 /* printfuns.c S178c */
-Env *globalenv;
+__thread Env *globalenv;
 static void printnonglobals(Printbuf output, Namelist xs, Env env, int depth) {
     char *prefix = "";
     for (; xs; xs = xs->tl) {
@@ -296,6 +299,22 @@ static void printlet(Printbuf output, Exp let) {
         bprint(output, "(%n %e)%s", xs->hd, es->hd, xs->tl?" ":"");
     bprint(output, ") %e)", let->u.letx.body);
 }   
+/* printfuns.c: recognizing the syntactic sugar for futures */
+/*
+ * The parser turns [[(future e)]] into an application of the
+ * [[future]] control primitive to [[(lambda () e)]], which is shown
+ * the way it was written.
+ */
+static bool isfuture(Exp e) {
+    Exp fn = e->u.apply.fn;
+    Explist actuals = e->u.apply.actuals;
+    return fn->alt == LITERAL && fn->u.literal.alt == PRIMITIVE
+        && fn->u.literal.u.primitive.function == control
+        && fn->u.literal.u.primitive.tag == FUTURE
+        && actuals != NULL && actuals->tl == NULL
+        && actuals->hd->alt == LAMBDAX
+        && actuals->hd->u.lambdax.formals == NULL;
+}
 /* printfuns.c S185a */
 void printexp(Printbuf output, va_list_box *box) {
     Exp e = va_arg(box->ap, Exp);
@@ -334,8 +353,12 @@ void printexp(Printbuf output, va_list_box *box) {
         bprint(output, "%\\", e->u.lambdax);
         break;
     case APPLY:
-        bprint(output, "(%e%s%E)", e->u.apply.fn,
-              e->u.apply.actuals ? " " : "", e->u.apply.actuals);
+        if (isfuture(e))
+            bprint(output, "(future %e)",
+                   e->u.apply.actuals->hd->u.lambdax.body);
+        else
+            bprint(output, "(%e%s%E)", e->u.apply.fn,
+                   e->u.apply.actuals ? " " : "", e->u.apply.actuals);
         break;
     /* extra cases for printing {\uscheme} ASTs S186a */
     /* extra cases for printing {\uscheme} ASTs S197a */
@@ -1,18 +1,24 @@
 #include "all.h"
 /* root.c S207c */
-struct Roots roots = { { NULL, { NULL } }, NULL, NULL };
+__thread struct Roots roots = { { NULL, { NULL } }, NULL, { NULL, 0, 0 } };
 /* root.c S207d */
 #ifndef DEBUG_GC_REGISTERS    /*OMIT*/
 void pushreg(Value *reg) {
-    roots.registers = mkRL(reg, roots.registers);
+    struct Registerstack *rs = &roots.registers;
+    if (rs->sp == rs->size) {
+        rs->size = rs->size ? 2 * rs->size : 64;
+        rs->regs = realloc(rs->regs, rs->size * sizeof(*rs->regs));
+        assert(rs->regs != NULL);
+    }
+    rs->regs[rs->sp++] = reg;
 }
 /* root.c S207e */
 void popreg(Value *reg) {
-    Registerlist regs = roots.registers;
-    assert(regs != NULL);
-    assert(reg == regs->hd);
-    roots.registers = regs->tl;
-    free(regs);
+    struct Registerstack *rs = &roots.registers;
+    assert(rs->sp > 0);
+    assert(reg == rs->regs[rs->sp - 1]);
+    (void) reg;
+    rs->sp--;
 }
 #endif /*OMIT*/
 /* root.c S207f */
@@ -199,6 +199,12 @@ struct Valuelist {
    struct Valuelist *tl;
 };
 
+/* structure definitions for \uscheme S165b */
+struct Env {      /* public so the conservative collector can trace it */
+    Name name;
+    Value *loc;
+    Env tl;
+};
 /* structure definitions for \uscheme S166d */
 struct Component {
     Exp exp;
@@ -338,6 +344,11 @@ Env bindalloc    (Name name,   Value v,      Env env);
 Env bindalloclist(Namelist xs, Valuelist vs, Env env);
 /* function prototypes for \uscheme 163b */
 Value *allocate(Value v);
+/* function prototypes for the conservative collector */
+typedef enum { HEAP_VALUE, HEAP_ENV, HEAP_VALUELIST } Heapkind;
+void *allocobject(Heapkind kind, size_t size); // just malloc, by default
+void  pinliteral (Value v);    // keep a quoted value alive forever
+int   gammadesired(int defaultval, int minimum);
 /* function prototypes for \uscheme 163c */
 Value truev, falsev;
 /* function prototypes for \uscheme 163d */
@@ -1,10 +1,4 @@
 #include "all.h"
-/* env.c S165b */
-struct Env {
-    Name name;
-    Value *loc;
-    Env tl;
-};
 /* env.c S165c */
 Value* find(Name name, Env env) {
     for (; env; env = env->tl)
@@ -14,7 +8,7 @@ Value* find(Name name, Env env) {
 }
 /* env.c S165d */
 Env bindalloc(Name name, Value val, Env env) {
-    Env newenv = malloc(sizeof(*newenv));
+    Env newenv = allocobject(HEAP_ENV, sizeof(*newenv));
     assert(newenv != NULL);
 
     newenv->name = name;
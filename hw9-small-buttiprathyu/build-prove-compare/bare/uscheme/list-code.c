@@ -222,7 +222,7 @@ int lengthVL(Valuelist vs) {
 Valuelist mkVL(Value v, Valuelist vs) {
     Valuelist new_vs;
 
-    new_vs = malloc(sizeof *new_vs);
+    new_vs = allocobject(HEAP_VALUELIST, sizeof *new_vs);
     assert(new_vs != NULL);
     new_vs->hd = v;
     new_vs->tl = vs;
@@ -1,12 +1,362 @@
+#define _DEFAULT_SOURCE  /* for MAP_ANONYMOUS */
 #include "all.h"
 /* loc.c 173b */
 Value* allocate(Value v) {
-    Value *loc = malloc(sizeof(*loc));
+    Value *loc = allocobject(HEAP_VALUE, sizeof(*loc));
     assert(loc != NULL);
     *loc = v;
     return loc;
 }
+#ifndef CONSERVATIVE_GC
 /* loc.c S155c */
 void initallocate(Env *globals) {
     (void)globals;
 }
+/* loc.c: allocation without collection */
+void *allocobject(Heapkind kind, size_t size) {
+    void *p = malloc(size);
+    (void)kind;
+    assert(p != NULL);
+    return p;
+}
+
+void pinliteral(Value v) {
+    (void)v;
+}
+#else
+#include <sys/mman.h>
+/* loc.c: a conservative mark-and-sweep collector */
+/*
+ * Compiled with -DCONSERVATIVE_GC, the interpreter reclaims memory
+ * without any help from [[eval]].  Values, binding records, and value
+ * lists are allocated from 4K pages, each page holding objects of a
+ * single kind, and so of a single size.  A collection treats every
+ * word on the C stack, and every callee-saved register, as a possible
+ * pointer: a word that points into an object in use keeps that object
+ * alive.  From these ambiguous roots, from the global environment,
+ * and from quoted literals, marking proceeds precisely, because the
+ * kind of every object is known from its page.  Objects never move,
+ * so a number that merely looks like a pointer costs only the memory
+ * it keeps alive.
+ *
+ * Abstract syntax is never reclaimed, so values quoted in the source
+ * are pinned by the parser, and the collector need not walk any
+ * [[Exp]].
+ */
+#define PAGESIZE   4096
+#define MAXOBJECTS 192      /* objects per page, at most */
+#ifndef GCHYPERDEBUG
+#define MINPAGES   8        /* smallest heap of each kind, in pages */
+#else
+#define MINPAGES   1
+#endif
+
+typedef struct Gcpage Gcpage;
+struct Gcpage {
+    Heapkind kind;
+    int nobjects;                       // objects that fit on this page
+    int nfree;                          // objects not in use
+    Gcpage *next;                       // next page of the same kind
+    uint64_t used  [MAXOBJECTS / 64];
+    uint64_t marked[MAXOBJECTS / 64];
+};                                      // the objects follow the header
+
+static const size_t objsize[] = {
+    sizeof(struct Value), sizeof(struct Env), sizeof(struct Valuelist)
+};
+#define NKINDS ((int) (sizeof(objsize) / sizeof(objsize[0])))
+
+static Gcpage *pages[NKINDS];   /* every page of each kind */
+static Gcpage *cursor[NKINDS];  /* first page that may have a free object */
+static int npages[NKINDS];
+static int nlive[NKINDS];       /* objects that survived the last collection */
+
+static Gcpage **pageset;        /* every page, in an open hash table */
+static int pagesetsize;         /* 0 or a power of 2 */
+static int totalpages;
+
+static void **markstack;        /* objects marked but not yet traced */
+static int markdepth, marksize;
+
+static Value *literals;         /* pinned values */
+static int nliterals, literalsize;
+
+static Env *userenv;            /* the global environment */
+static char *stackbottom;       /* no heap pointer lives beyond here */
+
+static int nalloc;              /* total number of allocations */
+static int ncollections;        /* total number of collections */
+static int nmarks;              /* total number of objects marked */
+static int maxpages;            /* largest heap, in pages */
+/* loc.c S207a */
+int gammadesired(int defaultval, int minimum) {
+    assert(userenv != NULL);
+    Value *gammaloc = find(strtoname("&gamma-desired"), *userenv);
+    if (gammaloc && gammaloc->alt == NUM)
+        return gammaloc->u.num > minimum ? gammaloc->u.num : minimum;
+    else
+        return defaultval;
+}
+/* loc.c: finding pages and objects */
+static unsigned pagehash(Gcpage *page) {
+    return (unsigned) ((uintptr_t)page / PAGESIZE) * 2654435761u;
+}
+
+static void addtopageset(Gcpage *page) {
+    unsigned h;
+    if (2 * (totalpages + 1) > pagesetsize) {
+        Gcpage **old = pageset;
+        int i, oldsize = pagesetsize;
+        pagesetsize = pagesetsize ? 2 * pagesetsize : 256;
+        pageset = calloc(pagesetsize, sizeof(*pageset));
+        assert(pageset != NULL);
+        for (i = 0; i < oldsize; i++)
+            if (old[i] != NULL) {
+                for (h = pagehash(old[i]) & (pagesetsize - 1); pageset[h];
+                     h = (h + 1) & (pagesetsize - 1))
+                    ;
+                pageset[h] = old[i];
+            }
+        free(old);
+    }
+    for (h = pagehash(page) & (pagesetsize - 1); pageset[h];
+         h = (h + 1) & (pagesetsize - 1))
+        ;
+    pageset[h] = page;
+    totalpages++;
+}
+
+static bool isheappage(Gcpage *page) {
+    unsigned h;
+    if (pagesetsize == 0)
+        return false;
+    for (h = pagehash(page) & (pagesetsize - 1); pageset[h];
+         h = (h + 1) & (pagesetsize - 1))
+        if (pageset[h] == page)
+            return true;
+    return false;
+}
+
+static char *objects(Gcpage *page) {
+    return (char *)(page + 1);
+}
+/*
+ * Given any word, return the index of the object in use that the
+ * word points into, or -1.  Interior pointers count.
+ */
+static int objectindex(uintptr_t w, Gcpage **pagep) {
+    Gcpage *page = (Gcpage *)(w & ~(uintptr_t)(PAGESIZE - 1));
+    uintptr_t first = (uintptr_t)objects(page);
+    int i;
+
+    if (w < first || !isheappage(page))
+        return -1;
+    i = (w - first) / objsize[page->kind];
+    if (i >= page->nobjects || !(page->used[i / 64] >> (i % 64) & 1))
+        return -1;
+    *pagep = page;
+    return i;
+}
+/* loc.c: marking */
+static void mark(uintptr_t w) {
+    Gcpage *page;
+    int i = objectindex(w, &page);
+    if (i < 0 || (page->marked[i / 64] >> (i % 64) & 1))
+        return;
+    page->marked[i / 64] |= (uint64_t)1 << (i % 64);
+    if (markdepth == marksize) {
+        marksize = marksize ? 2 * marksize : 256;
+        markstack = realloc(markstack, marksize * sizeof(*markstack));
+        assert(markstack != NULL);
+    }
+    markstack[markdepth++] = objects(page) + i * objsize[page->kind];
+    nmarks++;
+}
+
+static void tracevalue(Value *v) {
+    switch (v->alt) {
+    case PAIR:
+        mark((uintptr_t)v->u.pair.car);
+        mark((uintptr_t)v->u.pair.cdr);
+        return;
+    case CLOSURE:
+        mark((uintptr_t)v->u.closure.env);
+        return;
+    default:
+        return;
+    }
+}
+
+static void traceobject(void *obj) {
+    Gcpage *page = (Gcpage *)((uintptr_t)obj & ~(uintptr_t)(PAGESIZE - 1));
+    switch (page->kind) {
+    case HEAP_VALUE:
+        tracevalue(obj);
+        return;
+    case HEAP_ENV:
+        {   Env env = obj;
+            mark((uintptr_t)env->loc);
+            mark((uintptr_t)env->tl);
+        }
+        return;
+    case HEAP_VALUELIST:
+        {   Valuelist vs = obj;
+            tracevalue(&vs->hd);
+            mark((uintptr_t)vs->tl);
+        }
+        return;
+    }
+    assert(0);
+}
+/*
+ * The C stack is scanned from a frame called through a volatile
+ * pointer, so it cannot be inlined into [[markcstack]], whose
+ * [[__builtin_unwind_init]] has already spilled every callee-saved
+ * register into the range being scanned.
+ */
+static void scanstackwords(void) {
+    void *top = &top;
+    uintptr_t *p  = (uintptr_t *)((uintptr_t)&top & ~(sizeof(*p) - 1));
+    for ( ; (char *)p < stackbottom; p++)
+        mark(*p);
+}
+static void (*volatile stackscanner)(void) = scanstackwords;
+
+static void markcstack(void) {
+    __builtin_unwind_init();
+    stackscanner();
+}
+/* loc.c: sweeping and collection */
+static void sweep(void) {
+    int k, w;
+    Gcpage *page;
+    for (k = 0; k < NKINDS; k++) {
+        nlive[k] = 0;
+        for (page = pages[k]; page != NULL; page = page->next) {
+            int nused = 0;
+            for (w = 0; w < MAXOBJECTS / 64; w++) {
+#ifdef GCHYPERDEBUG
+                uint64_t dead = page->used[w] & ~page->marked[w];
+                for ( ; dead; dead &= dead - 1) {
+                    int i = 64 * w + __builtin_ctzll(dead);
+                    memset(objects(page) + i * objsize[k], 0xdb, objsize[k]);
+                }
+#endif
+                page->used[w] &= page->marked[w];
+                page->marked[w] = 0;
+                nused += __builtin_popcountll(page->used[w]);
+            }
+            page->nfree = page->nobjects - nused;
+            nlive[k] += nused;
+        }
+        cursor[k] = pages[k];
+    }
+}
+
+static void addpage(Heapkind kind) {
+    Gcpage *page = mmap(NULL, PAGESIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(page != MAP_FAILED);
+    page->kind = kind;
+    page->nobjects = (PAGESIZE - sizeof(*page)) / objsize[kind];
+    assert(page->nobjects <= MAXOBJECTS);
+    page->nfree = page->nobjects;
+    page->next = pages[kind];
+    pages[kind] = cursor[kind] = page;
+    npages[kind]++;
+    addtopageset(page);
+    if (totalpages > maxpages)
+        maxpages = totalpages;
+}
+
+static void collect(void) {
+    int i, k;
+    int gamma = gammadesired(200, 110);  /* percent of live data */
+
+    ncollections++;
+    markdepth = 0;
+    mark((uintptr_t)*userenv);
+    for (i = 0; i < nliterals; i++)
+        tracevalue(&literals[i]);
+    markcstack();
+    while (markdepth > 0)
+        traceobject(markstack[--markdepth]);
+    sweep();
+
+    /* grow each kind until its ratio to live data is at least gamma */
+    for (k = 0; k < NKINDS; k++) {
+        int perpage = (PAGESIZE - sizeof(Gcpage)) / objsize[k];
+        while (npages[k] < MINPAGES ||
+               (long) npages[k] * perpage * 100 < (long) nlive[k] * gamma)
+            addpage(k);
+    }
+}
+/* loc.c: allocation */
+static void *takeobject(Gcpage *page) {
+    int w, i;
+    char *obj;
+    for (w = 0; ~page->used[w] == 0; w++)
+        ;
+    i = 64 * w + __builtin_ctzll(~page->used[w]);
+    assert(i < page->nobjects);
+    page->used[w] |= (uint64_t)1 << (i % 64);
+    page->nfree--;
+    obj = objects(page) + i * objsize[page->kind];
+    memset(obj, 0, objsize[page->kind]);
+    nalloc++;
+    return obj;
+}
+
+void *allocobject(Heapkind kind, size_t size) {
+    bool collected = false;
+    Gcpage *page;
+
+    assert(size == objsize[kind]);
+    (void)size;
+#ifdef GCHYPERDEBUG
+    if (pages[kind] != NULL) {
+        collect();
+        collected = true;
+    }
+#endif
+    for (;;) {
+        for (page = cursor[kind]; page != NULL; page = page->next)
+            if (page->nfree > 0) {
+                cursor[kind] = page;
+                return takeobject(page);
+            }
+        if (!collected && pages[kind] != NULL) {
+            collect();
+            collected = true;
+        } else {
+            addpage(kind);
+        }
+    }
+}
+/* loc.c: pinning literals */
+void pinliteral(Value v) {
+    if (nliterals == literalsize) {
+        literalsize = literalsize ? 2 * literalsize : 64;
+        literals = realloc(literals, literalsize * sizeof(*literals));
+        assert(literals != NULL);
+    }
+    literals[nliterals++] = v;
+}
+/* loc.c: initialization and statistics */
+static void printfinalstats(void) {
+    fprintf(stderr, "[Conservative GC: allocated %d objects; "
+                    "%d collections marked %d objects; "
+                    "max heap %d pages (%lu bytes)]\n",
+            nalloc, ncollections, nmarks,
+            maxpages, (unsigned long) maxpages * PAGESIZE);
+}
+/*
+ * [[globals]] points into [[main]]'s frame, the oldest frame that
+ * can hold a heap pointer, so the stack is scanned up to there.
+ */
+void initallocate(Env *globals) {
+    userenv     = globals;
+    stackbottom = (char *)(globals + 1);
+    atexit(printfinalstats);
+}
+#endif
@@ -97,7 +97,9 @@ ParserResult sSexp(ParserState s) {
     } else {
         Par p = s->input->hd;
         halfshift(s);
-        s->components[s->nparsed++].value = parsesx(p, s->context.source);
+        Value v = parsesx(p, s->context.source);
+        pinliteral(v);   // quoted values live as long as the code
+        s->components[s->nparsed++].value = v;
         return PARSED;
     }
 }
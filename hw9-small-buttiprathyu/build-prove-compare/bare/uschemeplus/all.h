@@ -41,6 +41,9 @@ typedef enum {
 
 /* type definitions for \uschemeplus 251b */
 typedef struct Stack *Stack;
+typedef struct Evaluation *Evaluation;  // an evaluation set aside
+typedef struct Conttable *Conttable;    // the continuations of one interpreter
+typedef struct Sharedheap *Sharedheap;  // a heap and the threads that share it
 typedef struct Frame Frame;
 /* type definitions for \uscheme 151b */
 typedef enum Letkeyword { LET, LETSTAR, LETREC } Letkeyword;
@@ -62,6 +65,7 @@ enum {
 /* shared type definitions 42b */
 typedef struct Name *Name;
 typedef struct Namelist *Namelist;   // list of Name
+typedef struct Nametable *Nametable; // the names of one interpreter
 /* shared type definitions (generated by a script) */
 typedef struct Par *Par;
 typedef enum { ATOM, LIST } Paralt; 
@@ -90,7 +94,9 @@ enum Sugar {
 
   RECORD,             /* record-type definition */
 
-  COND                /* McCarthy's conditional from Lisp */
+  COND,               /* McCarthy's conditional from Lisp */
+
+  FUTUREX             /* (future e), which applies future to a thunk */
 
 };
 /* shared type definitions S6a */
@@ -210,9 +216,27 @@ struct Valuelist {
 };
 
 /* structure definitions for \uschemeplus 252a */
+typedef enum {
+    HANDLER_CHAIN, CALL_CHAIN, LOOP_CHAIN, ESCAPE_CHAIN, NCHAINS
+} Framechain;
+/*
+ * A frame records what kind of context it is, its depth, the
+ * expression that pushed it, at most three operand words, and a link
+ * along its chain; there is no embedded [[struct Exp]].  A frame that
+ * collects values has [[nslots]] of them laid out directly below it on
+ * the stack.
+ */
 struct Frame {
-    struct Exp context;     // mutated in place during evaluation
-    Exp syntax;             // when not NULL, kept pristine for error messages
+    unsigned char alt;      // an Expalt: the kind of context
+    unsigned char let;      // a Letkeyword, for a LETX context
+    unsigned short nslots;  // room for values below the frame
+    unsigned short nvalues; // values saved so far
+    int depth;              // frames on the stack, counting this one
+    Exp syntax;             // the expression that pushed the frame, or NULL
+    Explist es;             // expressions not yet evaluated
+    Namelist xs;            // names not yet bound (let* only)
+    Env env;                // the saved environment (LETXENV and CALLENV)
+    Frame *link;            // next older frame on the same chain
 };
 /* structure definitions for \uscheme S166d */
 struct Component {
@@ -366,15 +390,52 @@ Printer   printvaluelist;
 
 /* function prototypes for \uschemeplus 252b */
 Stack  emptystack  (void);
-Exp    pushcontext (struct Exp e, Stack s);
+Frame *pushframe   (Expalt alt, Exp syntax, int nslots, Stack s);
 void   popframe    (Stack s);
 void   clearstack  (Stack s);
+void   freestack   (Stack s);  // s must have left the ring
+void   joinring    (Stack s, Stack ring);  // s runs just before ring
+void   leavering   (Stack s);
+Stack  nextstack   (Stack s);  // next thread on the ring
+void   setwaiting  (Stack s, Stack waiting);  // walking s walks waiting too
+void   retagframe  (Frame *fr, Expalt alt, Stack s);  // fr must be on top
+int    chaindepth  (Framechain k, Stack s);  // depth of nearest frame, or 0
+int    stackdepth  (Stack s);  // frames on s
+Frame *unwindto    (Framechain k, Stack s);  // pops frames above nearest
+int    stacksegments(Stack s);  // segments holding frames, over the rings
+void   walkstack   (Stack s, int lo, int hi, void (*visit)(Frame *, void *),
+                    void *cl);  // frames in segments [lo, hi) of the rings
+int    capturestack(Stack s);   // seals s's frames; returns a continuation
+void   resumestack (int k, Stack s);  // s's frames become k's
+void   markcontinuation  (int k);
+bool   tracecontinuations(void (*visit)(Frame *, void *), void *cl);
+int    sweepcontinuations(void);  // free unmarked ones; return # live
+Conttable conttable   (void);         // the current interpreter's continuations
+void      useconttable(Conttable t);  // share another thread's continuations
 /* function prototypes for \uschemeplus 252c */
 Frame *topframe (Stack s);  // NULL if empty
 /* function prototypes for \uschemeplus 252d */
 void   pushenv_opt (Env env, Expalt context, Stack s);  // may optimize
 /* function prototypes for \uschemeplus 253a */
 void stack_trace_init(int *countp);  // how many steps to show
+void stack_trace_ring(int capacity, const char *filename);  // binary trace
+/* function prototypes for futures */
+extern bool heap_is_shared;   // may threads allocate and read at once?
+void  setfuturethreads(int n);  // workers wanted; negative for one per CPU
+int   futurethreads   (void);   // workers wanted; 0 runs futures at once
+Value mkfuture        (Exp source, Value thunk);  // queues (thunk) on the pool
+Value touchfuture     (Exp e, Value v, bool *thrown);  // waits for v
+void  escapefuture    (Value v);  // ends a running future by throwing v
+int   futureworker    (void);   // number of this worker, 0 if not one
+void  markfuture      (int k);
+bool  tracefutures    (void (*visit)(Value *));
+int   sweepfutures    (void);   // recycle unmarked ones; return # live
+/* function prototypes for sharing the heap */
+Sharedheap sharedheap   (void);  // the calling thread's heap, for its workers
+void       joinheap     (Sharedheap h);  // a worker starts to allocate from h
+void       quitheap     (void);  // a worker stops, before it quits
+void       beginblocking(void);  // the thread waits; collections need not
+void       endblocking  (void);  // the thread runs again, after any collection
 void stack_trace_current_expression(Exp e,   Env rho, Stack s);
 void stack_trace_current_value     (Value v, Env rho, Stack s);
 /* function prototypes for \uschemeplus 253b */
@@ -382,16 +443,10 @@ Value getoption(Name name, Env env, Value defaultval);
 /* function prototypes for \uschemeplus 253c */
 Value validate(Value v);
 /* function prototypes for \uschemeplus 260a */
-Exp transition_explist(Explist es, Value v); // pointer to static memory
-/* function prototypes for \uschemeplus 260b */
-Exp head_replaced_with_hole(Explist es);
-                                        // shares memory with transition_explist
-/* function prototypes for \uschemeplus 260c */
-Explist copyEL(Explist es);
-void    freeEL(Explist es);
-/* function prototypes for \uschemeplus 261a */
-Valuelist asLiterals(Explist es);
-Value     asLiteral (Exp e);
+Exp       nextpending    (Frame *fr);         // NULL when none are pending
+void      pushvalue      (Frame *fr, Value v);
+Value    *framevalues    (Frame *fr);
+Valuelist framevaluelist (Frame *fr, int first);
 /* function prototypes for \uschemeplus 261b */
 void freeVL(Valuelist vs);
 /* function prototypes for \uschemeplus S191c */
@@ -407,7 +462,7 @@ Env bindalloclist(Namelist xs, Valuelist vs, Env env);
 /* function prototypes for \uscheme 163b */
 Value *allocate(Value v);
 /* function prototypes for \uscheme 163c */
-Value truev, falsev;
+extern __thread Value truev, falsev;
 /* function prototypes for \uscheme 163d */
 bool istrue(Value v);
 /* function prototypes for \uscheme 163e */
@@ -415,6 +470,8 @@ Value unspecified(void);
 /* function prototypes for \uscheme 164 */
 Value eval   (Exp e, Env rho);
 Env   evaldef(Def d, Env rho, Echo echo);
+Evaluation saveeval   (void);  // lets eval be called from a primitive
+void       restoreeval(Evaluation saved);
 /* function prototypes for \uscheme ((elided)) (THIS CAN'T HAPPEN -- claimed code was not used) */
 Exp desugarLetStar(Namelist xs, Explist es, Exp body);
 Exp desugarLet    (Namelist xs, Explist es, Exp body);
@@ -422,6 +479,17 @@ Exp desugarLet    (Namelist xs, Explist es, Exp body);
 void initallocate(Env *globals);
 /* function prototypes for \uscheme S148c */
 void initvalue(void);
+Env *initscheme(void);  // a fresh interpreter for the calling thread
+void installprinters(void);
+void freescheme(void);     // releases the calling thread's interpreter
+void freeevaluator(void);  // releases what eval keeps in the calling thread
+/* function prototypes for releasing an interpreter */
+void freeallocate     (void);  // undoes initallocate
+void freeeval         (void);  // every thread's stack
+void freecontinuations(void);
+void freefutures      (void);  // joins the workers
+void freenames        (void);
+void freeprint        (void);
 /* function prototypes for \uscheme S149a */
 void readevalprint(XDefstream xdefs, Env *envp, Echo echo);
 /* function prototypes for \uscheme S149b */
@@ -461,13 +529,15 @@ Deflist desugarRecord(Name recname, Namelist fieldnames);
 /* shared function prototypes 42c */
 Name strtoname(const char *s);
 const char *nametostr(Name x);
+Nametable nametable   (void);         // the current interpreter's names
+void      usenametable(Nametable t);  // share another thread's names
 /* shared function prototypes 46b */
 void print (const char *fmt, ...);  // print to standard output
 void fprint(FILE *output, const char *fmt, ...);  // print to given file
 /* shared function prototypes 47a */
 __noreturn // OMIT
 void runerror (const char *fmt, ...);
-extern jmp_buf errorjmp;        // longjmp here on error
+extern __thread jmp_buf errorjmp;        // longjmp here on error
 /* shared function prototypes 47b */
 __noreturn // OMIT
 void synerror (Sourceloc src, const char *fmt, ...);
@@ -529,7 +599,7 @@ Parstream parstream(Linestream lines, Prompts prompts);
 Par       getpar   (Parstream r);
 Sourceloc parsource(Parstream pars);
 /* shared function prototypes S10a */
-extern bool read_tick_as_quote;
+extern __thread bool read_tick_as_quote;
 /* shared function prototypes S16c */
 Printbuf printbuf(void);
 void freebuf(Printbuf *);
@@ -555,8 +625,9 @@ Printer printpar;
 /* shared function prototypes S24a */
 typedef enum ErrorMode { NORMAL, TESTING } ErrorMode;
 void set_error_mode(ErrorMode mode);
-extern jmp_buf testjmp;    /* if error occurs during a test, longjmp here */
-Printbuf errorbuf;         /* if error occurs during a test, message is here */
+ErrorMode error_mode(void);
+extern __thread jmp_buf testjmp;    /* longjmp here on error in a test */
+extern __thread Printbuf errorbuf;   /* message of an error in a test */
 /* shared function prototypes S28 */
 extern int  checkoverflow(int limit);
 extern void reset_overflow_check(void);
@@ -579,16 +650,20 @@ void report_test_results(int npassed, int ntests);
 /* shared function prototypes S139d */
 Printer printexp, printdef, printvalue, printfun;
 /* shared function prototypes S150d */
-Primitive arith, binary, unary;
+Primitive arith, binary, unary, channel;
+Primitive control, continuation, escape;  // applied by eval itself
+Primitive future;  // a future's value, which only touch may take
 /* shared function prototypes S167b */
 ParserResult sSexp    (ParserState state);
 ParserResult sBindings(ParserState state);
 
 /* global variables for \uschemeplus 252e */
-extern int high_stack_mark;
+extern __thread int high_stack_mark;
 /* global variables for \uschemeplus 252f */
-extern int optimize_tail_calls;
-extern int show_high_stack_mark;
+extern __thread int optimize_tail_calls;
+extern __thread int show_high_stack_mark;
+extern __thread int max_stack_depth;     // frames allowed on the stack
+#define MAXSTACKDEPTH 1000000  /* default for &max-stack-depth */
 
 /* macro definitions used in parsing S38a */
 #define ANEXP(ALT)  (  0+(ALT))
@@ -1,16 +1,20 @@
 #include "all.h"
 /* error.c S24b */
-jmp_buf errorjmp;
-jmp_buf testjmp;
+__thread jmp_buf errorjmp;
+__thread jmp_buf testjmp;
 
-static ErrorMode mode = NORMAL;
+static __thread ErrorMode mode = NORMAL;
 /* error.c S24c */
 void set_error_mode(ErrorMode new_mode) {
   assert(new_mode == NORMAL || new_mode == TESTING);
   mode = new_mode;
 }
+
+ErrorMode error_mode(void) {
+  return mode;
+}
 /* error.c S25 */
-Printbuf errorbuf;
+__thread Printbuf errorbuf;
 void runerror(const char *fmt, ...) {
     va_list_box box;
 
@@ -40,7 +44,7 @@ void runerror(const char *fmt, ...) {
     }
 }
 /* error.c S26a */
-static ErrorFormat toplevel_error_format = WITH_LOCATIONS;
+static __thread ErrorFormat toplevel_error_format = WITH_LOCATIONS;
 
 void synerror(Sourceloc src, const char *fmt, ...) {
     va_list_box box;
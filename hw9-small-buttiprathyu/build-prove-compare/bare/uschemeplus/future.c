@@ -0,0 +1,485 @@
+#define _DEFAULT_SOURCE  /* for sysconf */
+#include "all.h"
+#include <pthread.h>
+#include <unistd.h>
+/* future.c: futures and the pool that runs them */
+/*
+ * [[(future e)]] evaluates [[e]] on a pool of worker threads and
+ * returns at once; [[(touch f)]] waits for the result.  If [[e]] throws
+ * a value that it does not catch, [[touch]] throws the same value, and
+ * if [[e]] fails with an error, [[touch]] fails with its message.  Each
+ * worker is an evaluator of its own: everything [[eval]] keeps is
+ * thread-local, so a worker shares only the heap with the thread that
+ * made the future.  That is safe only when nothing in the heap moves
+ * or dies while a worker reads it, and when allocation is thread-safe;
+ * an allocator that promises both sets [[heap_is_shared]].  A worker
+ * joins the heap with [[joinheap]], and a thread that waits, for a
+ * future or for work, tells the heap with [[beginblocking]], so that
+ * a collection need not wait for it.  Otherwise the pool has no
+ * workers, and a future runs as soon as it is made, but its outcome
+ * still waits for [[touch]].
+ *
+ * A future should compute a pure function.  A worker sees the
+ * variables its function closes over, but not the caller's options,
+ * continuations, or threads, and a future that sets a variable another
+ * thread reads races with that thread.
+ *
+ * Each worker owns a deque of futures waiting to run.  A worker pushes
+ * the futures it makes onto the bottom of its own deque and pops from
+ * the bottom; when its deque is empty, it steals from the top of the
+ * others'.  The interpreter's own thread pushes onto deque 0, from
+ * which workers only steal.  Workers are started as futures are made,
+ * up to [[&future-threads]], and then kept until the interpreter is
+ * released.
+ *
+ * A thread that touches a future no one has started runs it then and
+ * there, leaving a stale entry in some deque; a future is claimed under
+ * the pool's lock, so it runs only once.  A thread blocks in [[touch]]
+ * only for a future that is running on another thread, and since a
+ * pure future can touch only futures made before it or by it, threads
+ * that block never wait for one another in a cycle.  Because the
+ * interpreter's own thread runs what it touches, a program finishes
+ * even if no worker can be started.
+ */
+#define MAXWORKERS 256
+
+struct Future {
+    enum { WAITING, RUNNING, FINISHED, THROWN, FAILED, FREE } state;
+    Exp source;    // the (future e) that made it, for messages
+    Value thunk;   // (lambda () e), until it has run
+    Value value;   // when FINISHED, or the value thrown, when THROWN
+    char *error;   // message, when FAILED
+    bool live, traced;  // reached in the current collection
+    int nextfree;  // next free entry, when FREE
+};
+
+typedef struct Workdeque {
+    pthread_mutex_t lock;
+    int *items;              // numbers of futures waiting to run
+    int size;
+    int top, bottom;         // waiting futures are items[top..bottom)
+    struct Futurepool *pool; // the pool this deque belongs to
+    pthread_t thread;        // the worker that owns it, if any
+} Workdeque;
+
+struct Futurepool {
+    pthread_mutex_t lock;    // guards everything below but the deques
+    pthread_cond_t work;     // signaled when a future is queued
+    pthread_cond_t done;     // broadcast when a future finishes
+    struct Future **futures; // futures made, by number
+    int nfutures, size;
+    int freefutures;         // first FREE entry, or -1
+    Workdeque deques[MAXWORKERS + 1];  // deques[0] is the interpreter's
+    int target;              // workers wanted, from &future-threads
+    int nworkers;            // workers started
+    int nidle;               // workers waiting for a future to run
+    int nqueued;             // futures waiting in some deque
+    bool quit;               // set when the interpreter is released
+    Nametable names;         // the interpreter's names, which workers share
+    Sharedheap heap;         // and its heap
+};
+
+static __thread struct Futurepool *pool;  /* pool of the current thread */
+static __thread Workdeque *mydeque;       /* deque the thread pushes onto */
+static __thread bool isworker;
+static __thread struct Future *running;   /* future the thread is running */
+
+/* future.c: work deques */
+static void pushwork(Workdeque *d, int k) {
+    pthread_mutex_lock(&d->lock);
+    if (d->top > 0 && d->bottom == d->size) {
+        memmove(d->items, d->items + d->top,
+                (d->bottom - d->top) * sizeof(*d->items));
+        d->bottom -= d->top;
+        d->top = 0;
+    }
+    if (d->bottom == d->size) {
+        d->size = d->size ? 2 * d->size : 64;
+        d->items = realloc(d->items, d->size * sizeof(*d->items));
+        assert(d->items != NULL);
+    }
+    d->items[d->bottom++] = k;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int popwork(Workdeque *d) {  // newest first, or -1
+    int k = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->top < d->bottom)
+        k = d->items[--d->bottom];
+    pthread_mutex_unlock(&d->lock);
+    return k;
+}
+
+static int stealwork(Workdeque *d) {  // oldest first, or -1
+    int k = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->top < d->bottom)
+        k = d->items[d->top++];
+    pthread_mutex_unlock(&d->lock);
+    return k;
+}
+
+static int findwork(Workdeque *thief) {
+    int i, k, n = __atomic_load_n(&pool->nworkers, __ATOMIC_RELAXED) + 1;
+    int start = thief - pool->deques;
+
+    if ((k = popwork(thief)) >= 0)
+        return k;
+    for (i = 1; i < n; i++)
+        if ((k = stealwork(&pool->deques[(start + i) % n])) >= 0)
+            return k;
+    return -1;
+}
+/* future.c: the pool */
+static struct Futurepool *newpool(void) {
+    struct Futurepool *p = calloc(1, sizeof(*p));
+    int i;
+
+    assert(p != NULL);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->done, NULL);
+    for (i = 0; i <= MAXWORKERS; i++) {
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+        p->deques[i].pool = p;
+    }
+    p->target = -1;
+    p->freefutures = -1;
+    p->names = nametable();
+    p->heap = sharedheap();
+    return p;
+}
+
+void setfuturethreads(int n) {
+    if (isworker)
+        return;  // only the interpreter's own options count
+    if (pool == NULL) {
+        pool = newpool();
+        mydeque = &pool->deques[0];
+    }
+    if (n < 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > MAXWORKERS)
+        n = MAXWORKERS;
+    if (!heap_is_shared)
+        n = 0;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->target, n, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int futurethreads(void) {  // workers read it without the lock
+    if (pool == NULL)
+        setfuturethreads(-1);
+    return __atomic_load_n(&pool->target, __ATOMIC_RELAXED);
+}
+/*
+ * A future runs in testing mode, so that the message of an error is
+ * kept for [[touch]] instead of printed, and a value it throws but does
+ * not catch comes back through [[escapefuture]].  Because a thread may
+ * run a future while another evaluation on the same thread waits in
+ * [[touch]], running one sets aside the evaluation, the error handler,
+ * and the error mode of the one that waits.
+ */
+static bool claim(struct Future *f) {  // called with the pool locked
+    if (f->state != WAITING)
+        return false;
+    f->state = RUNNING;
+    return true;
+}
+
+static void finish(struct Future *f, int state, Value v, char *error) {
+    pthread_mutex_lock(&pool->lock);
+    f->state = state;
+    f->thunk = falsev;
+    f->value = v;
+    f->error = error;
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void resume(Evaluation waiting, jmp_buf handler, ErrorMode mode,
+                   struct Future *outer) {
+    restoreeval(waiting);
+    memcpy(testjmp, handler, sizeof(jmp_buf));
+    set_error_mode(mode);
+    running = outer;
+}
+
+static void runfuture(struct Future *f) {  // f is claimed
+    struct Future *outer = running;
+    ErrorMode mode = error_mode();
+    Evaluation waiting;
+    jmp_buf handler;
+    Lambda lambda = f->thunk.u.closure.lambda;
+    Env env = f->thunk.u.closure.env;
+    Value v;
+    char *msg;
+
+    memcpy(handler, testjmp, sizeof(jmp_buf));
+    waiting = saveeval();
+    set_error_mode(TESTING);
+    running = f;
+    switch (setjmp(testjmp)) {
+    case 0:
+        v = eval(lambda.body, env);
+        resume(waiting, handler, mode, outer);
+        finish(f, FINISHED, v, NULL);
+        return;
+    case 1:   // from runerror
+        msg = bufcopy(errorbuf);
+        bufreset(errorbuf);
+        resume(waiting, handler, mode, outer);
+        finish(f, FAILED, falsev, msg);
+        return;
+    default:  // from escapefuture
+        resume(waiting, handler, mode, outer);
+        finish(f, THROWN, f->value, NULL);
+        return;
+    }
+}
+
+int futureworker(void) {
+    return isworker ? (int) (mydeque - pool->deques) : 0;
+}
+
+void escapefuture(Value v) {
+    if (running != NULL) {
+        running->value = v;
+        longjmp(testjmp, 2);
+    }
+}
+
+static void *worker(void *arg) {
+    Workdeque *d = arg;
+    int k;
+
+    pool     = d->pool;
+    mydeque  = d;
+    isworker = true;
+    usenametable(pool->names);
+    joinheap(pool->heap);
+    initvalue();
+    installprinters();
+    while (!__atomic_load_n(&pool->quit, __ATOMIC_RELAXED)) {
+        if ((k = findwork(d)) >= 0) {
+            struct Future *f;
+            bool claimed;
+
+            __atomic_sub_fetch(&pool->nqueued, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_lock(&pool->lock);
+            f = pool->futures[k];
+            claimed = claim(f);
+            pthread_mutex_unlock(&pool->lock);
+            if (claimed)
+                runfuture(f);
+            continue;
+        }
+        beginblocking();
+        pthread_mutex_lock(&pool->lock);
+        pool->nidle++;
+        while (__atomic_load_n(&pool->nqueued, __ATOMIC_SEQ_CST) <= 0 &&
+               !pool->quit)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        pool->nidle--;
+        pthread_mutex_unlock(&pool->lock);
+        endblocking();
+    }
+    quitheap();
+    usenametable(NULL);  // the interpreter frees its names
+    freeevaluator();
+    return NULL;
+}
+
+static void startworker(void) {  // called with the pool locked
+    Workdeque *d = &pool->deques[pool->nworkers + 1];
+
+    if (pthread_create(&d->thread, NULL, worker, d) == 0)
+        __atomic_add_fetch(&pool->nworkers, 1, __ATOMIC_RELAXED);
+}
+/* future.c: making and touching futures */
+static int newfuture(void) {  // called with the pool locked
+    int k = pool->freefutures;
+
+    if (k >= 0) {
+        pool->freefutures = pool->futures[k]->nextfree;
+        return k;
+    }
+    if (pool->nfutures == pool->size) {
+        pool->size = pool->size ? 2 * pool->size : 256;
+        pool->futures = realloc(pool->futures,
+                                pool->size * sizeof(*pool->futures));
+        assert(pool->futures != NULL);
+    }
+    k = pool->nfutures++;
+    pool->futures[k] = malloc(sizeof(*pool->futures[k]));
+    assert(pool->futures[k] != NULL);
+    return k;
+}
+
+Value mkfuture(Exp source, Value thunk) {
+    struct Future *f;
+    int k;
+
+    assert(thunk.alt == CLOSURE && thunk.u.closure.lambda.formals == NULL);
+    futurethreads();  // makes the pool
+    pthread_mutex_lock(&pool->lock);
+    k = newfuture();
+    f = pool->futures[k];
+    f->state  = WAITING;
+    f->source = source;
+    f->thunk  = thunk;
+    f->value  = falsev;
+    f->error  = NULL;
+    f->live   = f->traced = false;
+    if (pool->target == 0) {
+        claim(f);
+        pthread_mutex_unlock(&pool->lock);
+        runfuture(f);
+        return mkPrimitive(k, future);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pushwork(mydeque, k);
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->nqueued, 1, __ATOMIC_SEQ_CST);
+    if (pool->nidle > 0)
+        pthread_cond_signal(&pool->work);
+    else if (pool->nworkers < pool->target && !pool->quit)
+        startworker();
+    pthread_mutex_unlock(&pool->lock);
+    return mkPrimitive(k, future);
+}
+
+/*
+ * A thread that waits in [[touch]] counts as stopped, so it begins to
+ * block before it takes the pool's lock, which a collection needs to
+ * sweep the futures, and it reads the outcome only once it runs again.
+ */
+Value touchfuture(Exp e, Value v, bool *thrown) {
+    struct Future *f;
+    bool claimed, busy;
+
+    *thrown = false;
+    if (v.alt != PRIMITIVE || v.u.primitive.function != future)
+        return v;  // touching any other value is a no-op
+    pthread_mutex_lock(&pool->lock);
+    f = pool->futures[v.u.primitive.tag];
+    claimed = claim(f);
+    busy = !claimed && f->state == RUNNING;
+    pthread_mutex_unlock(&pool->lock);
+    if (claimed)
+        runfuture(f);
+    if (busy) {
+        beginblocking();
+        pthread_mutex_lock(&pool->lock);
+        while (f->state == RUNNING)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+        endblocking();
+    }
+    if (f->state == FAILED)
+        runerror("in %e, %e failed: %s", e, f->source, f->error);
+    *thrown = f->state == THROWN;
+    return f->value;
+}
+
+Value future(Exp e, int tag, Valuelist vs) {
+    (void)tag; (void)vs;
+    runerror("in %e, a future is not a function; touch it instead", e);
+    return falsev;
+}
+/* future.c: futures and the garbage collector */
+/*
+ * Like a continuation, a future is an index into a table, so a
+ * collector calls [[markfuture]] for each future it reaches, then
+ * calls [[tracefutures]] until it returns false, draining its marks in
+ * between.  A future that is waiting or running is a root, since its
+ * thunk has yet to finish.  Finally [[sweepfutures]] recycles the
+ * settled futures not reached.
+ */
+void markfuture(int k) {
+    assert(pool != NULL && 0 <= k && k < pool->nfutures);
+    __atomic_store_n(&pool->futures[k]->live, true, __ATOMIC_RELAXED);
+}
+
+bool tracefutures(void (*visit)(Value *)) {
+    bool traced = false;
+    int k;
+
+    if (pool == NULL)
+        return false;
+    for (k = 0; k < pool->nfutures; k++) {
+        struct Future *f = pool->futures[k];
+        if (!f->traced && (f->live || f->state == WAITING ||
+                                      f->state == RUNNING)) {
+            f->traced = traced = true;
+            visit(&f->thunk);
+            visit(&f->value);
+        }
+    }
+    return traced;
+}
+
+int sweepfutures(void) {
+    int k, nlive = 0;
+
+    if (pool == NULL)
+        return 0;
+    pthread_mutex_lock(&pool->lock);
+    for (k = 0; k < pool->nfutures; k++) {
+        struct Future *f = pool->futures[k];
+        if (f->state == FREE)
+            continue;
+        if (f->live || f->state == WAITING || f->state == RUNNING) {
+            f->live = f->traced = false;
+            nlive++;
+        } else {
+            free(f->error);
+            f->state = FREE;
+            f->value = falsev;
+            f->error = NULL;
+            f->nextfree = pool->freefutures;
+            pool->freefutures = k;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return nlive;
+}
+/* future.c: releasing the pool */
+/*
+ * Only the interpreter's own thread releases the pool.  Each worker
+ * finishes the future it is running, if any, and then quits, leaving
+ * any futures still waiting unrun.  A worker may collect as it
+ * finishes, so the interpreter's thread blocks while it joins them.
+ */
+void freefutures(void) {
+    int i;
+
+    if (pool == NULL || isworker)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->quit, true, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    beginblocking();
+    for (i = 1; i <= __atomic_load_n(&pool->nworkers, __ATOMIC_RELAXED); i++)
+        pthread_join(pool->deques[i].thread, NULL);
+    endblocking();
+    for (i = 0; i < pool->nfutures; i++) {
+        free(pool->futures[i]->error);
+        free(pool->futures[i]);
+    }
+    free(pool->futures);
+    for (i = 0; i <= MAXWORKERS; i++) {
+        free(pool->deques[i].items);
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+    pool = NULL;
+    mydeque = NULL;
+}
@@ -10,3 +10,31 @@ Value* allocate(Value v) {
 void initallocate(Env *globals) {
     (void)globals;
 }
+
+void freeallocate(void) {
+    // objects are never freed, so there is nothing to give back
+}
+/* loc.c: sharing the heap */
+/*
+ * Objects come from [[malloc]] and are never moved or freed, so any
+ * number of threads may allocate and read them at once.  There is no
+ * collection to stop for, so joining the heap and blocking do nothing.
+ */
+bool heap_is_shared = true;
+
+Sharedheap sharedheap(void) {
+    return NULL;
+}
+
+void joinheap(Sharedheap h) {
+    (void)h;
+}
+
+void quitheap(void) {
+}
+
+void beginblocking(void) {
+}
+
+void endblocking(void) {
+}
@@ -1,4 +1,5 @@
 #include "all.h"
+#include <pthread.h>
 /* name.c S135a */
 struct Name {
     const char *s;
@@ -9,21 +10,81 @@ const char* nametostr(Name np) {
     return np->s;
 }
 /* name.c S135c */
-Name strtoname(const char *s) {
-    static Namelist all_names;
-    assert(s != NULL);
+/*
+ * An interpreter's names are kept in a table that its future workers
+ * share, so [[strtoname]] on a worker finds the same [[Name]] as on the
+ * interpreter's own thread.  Names are only ever added, at the head of
+ * the list, so a search takes no lock; a thread that adds a name takes
+ * the table's lock and searches again, in case another thread has just
+ * added the same name.
+ */
+struct Nametable {
+    Namelist all_names;
+    pthread_mutex_t lock;   // guards additions to [[all_names]]
+};
+static __thread Nametable table;  /* names of the current interpreter */
+
+Nametable nametable(void) {
+    if (table == NULL) {
+        table = malloc(sizeof(*table));
+        assert(table != NULL);
+        table->all_names = NULL;
+        pthread_mutex_init(&table->lock, NULL);
+    }
+    return table;
+}
+
+void usenametable(Nametable t) {
+    table = t;
+}
 
-    for (Namelist unsearched = all_names; unsearched; unsearched = unsearched->
-                                                                             tl)
+static Name search(const char *s, Namelist unsearched) {
+    for ( ; unsearched; unsearched = unsearched->tl)
         if (strcmp(s, unsearched->hd->s) == 0)
             return unsearched->hd;
+    return NULL;
+}
 
-    /* allocate a new name, add it to [[all_names]], and return it S135d */
-    Name np = malloc(sizeof(*np));
-    assert(np != NULL);
-    np->s = malloc(strlen(s) + 1);
-    assert(np->s != NULL);
-    strcpy((char*)np->s, s);
-    all_names = mkNL(np, all_names);
+Name strtoname(const char *s) {
+    Nametable t = nametable();
+    Name np;
+
+    assert(s != NULL);
+    np = search(s, __atomic_load_n(&t->all_names, __ATOMIC_ACQUIRE));
+    if (np != NULL)
+        return np;
+    pthread_mutex_lock(&t->lock);
+    np = search(s, t->all_names);
+    if (np == NULL) {
+        /* allocate a new name, add it to [[all_names]], and return it S135d */
+        np = malloc(sizeof(*np));
+        assert(np != NULL);
+        np->s = malloc(strlen(s) + 1);
+        assert(np->s != NULL);
+        strcpy((char*)np->s, s);
+        __atomic_store_n(&t->all_names, mkNL(np, t->all_names),
+                         __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&t->lock);
     return np;
 }
+/* name.c: releasing the names */
+/*
+ * Names are compared by address, so they are released only with the
+ * interpreter that made them.  A worker gives up its borrowed table
+ * before it quits, so only the interpreter's own thread frees it.
+ */
+void freenames(void) {
+    Namelist xs, tl;
+    if (table == NULL)
+        return;
+    for (xs = table->all_names; xs; xs = tl) {
+        tl = xs->tl;
+        free((char *)xs->hd->s);
+        free(xs->hd);
+        free(xs);
+    }
+    pthread_mutex_destroy(&table->lock);
+    free(table);
+    table = NULL;
+}
@@ -25,6 +25,7 @@ struct Usage usage_table[] = {
     { ANEXP(RETURNX),    "(return exp)" },
     { ANEXP(THROW),      "(throw exp)" },
     { ANEXP(TRY_CATCH),  "(try-catch body handler)" },
+    { SUGAR(FUTUREX),    "(future exp)" },
     { -1, NULL }
 };
 /* parse.c S167c */
@@ -61,10 +62,11 @@ struct ParserRow exptable[] = {
   { "return",    RETURNX,   returnshifts },
   { "throw",     THROW,     returnshifts },
   { "try-catch", TRY_CATCH, tcshifts },
+  { "future",    SUGAR(FUTUREX), returnshifts },
   { NULL,     ANEXP(APPLY),   applyshifts }  // must come last
 };
 /* parse.c S168a */
-bool read_tick_as_quote = true;
+__thread bool read_tick_as_quote = true;
 /* parse.c S168b */
 Exp reduce_to_exp(int code, struct Component *comps) {
     switch(code) {
@@ -89,6 +91,9 @@ Exp reduce_to_exp(int code, struct Component *comps) {
     case ANEXP(RETURNX):   return mkReturnx(comps[0].exp);
     case ANEXP(THROW):     return mkThrow(comps[0].exp);
     case ANEXP(TRY_CATCH): return mkTryCatch(comps[0].exp, comps[1].exp);
+    case SUGAR(FUTUREX):   return mkApply(mkLiteral(mkPrimitive(FUTURE, control)),
+                                          mkEL(mkLambdax(mkLambda(NULL,
+                                                         comps[0].exp)), NULL));
     }
     assert(0);
 }
@@ -134,3 +134,36 @@ Value equalatoms(Value v, Value w) {
         return falsev;
     }
 }
+/* prim.c: channels */
+/*
+ * A channel is a pair whose car holds the list of messages not yet
+ * received, oldest first, and whose cdr holds the last pair of that
+ * list, or the empty list.  Because [[receive]] may block, [[eval]]
+ * applies it.
+ */
+static Value send(Exp e, Value ch, Value msg) {
+    Value cell;
+
+    if (ch.alt != PAIR)
+        runerror("in %e, expected a channel, but got %v", e, ch);
+    cell = cons(msg, mkNil());
+    if (ch.u.pair.cdr->alt == PAIR)
+        *ch.u.pair.cdr->u.pair.cdr = cell;
+    else
+        *ch.u.pair.car = cell;
+    *ch.u.pair.cdr = cell;
+    return msg;
+}
+
+Value channel(Exp e, int tag, Valuelist args) {
+    switch (tag) {
+    case MKCHANNEL:
+        checkargc(e, 0, lengthVL(args));
+        return cons(mkNil(), mkNil());
+    case SEND:
+        checkargc(e, 2, lengthVL(args));
+        return send(e, nthVL(args, 0), nthVL(args, 1));
+    default:
+        assert(0);
+    }
+}
@@ -9,9 +9,10 @@ void bprint(Printbuf output, const char *fmt, ...) {
     va_end(box.ap);
 }
 /* print.c S21a */
+static __thread Printbuf stdoutbuf;
+
 void print(const char *fmt, ...) {
     va_list_box box;
-    static Printbuf stdoutbuf;
 
     if (stdoutbuf == NULL)
         stdoutbuf = printbuf();
@@ -26,7 +27,7 @@ void print(const char *fmt, ...) {
 }
 /* print.c S21b */
 void fprint(FILE *output, const char *fmt, ...) {
-    static Printbuf buf;
+    static __thread Printbuf buf;
     va_list_box box;
 
     if (buf == NULL)
@@ -40,8 +41,13 @@ void fprint(FILE *output, const char *fmt, ...) {
     fflush(output);
     freebuf(&buf);
 }
+/* print.c: releasing the buffer */
+void freeprint(void) {
+    if (stdoutbuf != NULL)
+        freebuf(&stdoutbuf);
+}
 /* print.c S22a */
-static Printer *printertab[256];
+static __thread Printer *printertab[256];
 
 void vbprint(Printbuf output, const char *fmt, va_list_box *box) {
     const unsigned char *p;
@@ -0,0 +1,75 @@
+/*
+ * embed.c: many uScheme interpreters in one process
+ *
+ * Each of NTHREADS threads starts an interpreter with initscheme(),
+ * runs a program that uses futures (and, in uscheme-ms, parallel
+ * marking), checks the answer, and releases the interpreter with
+ * freescheme(); then it does it all again, NROUNDS times.  No two
+ * interpreters share anything, so the threads never wait for one
+ * another.  Build it with "make embed" in the directory of uschemeplus,
+ * uscheme-ms, uscheme-copy, or uscheme-mc; "make check-embed" builds it
+ * and runs it.  Under a sanitizer, it checks that interpreters neither
+ * race nor leak.
+ */
+#include "all.h"
+#include <pthread.h>
+
+#define NTHREADS 4
+#define NROUNDS  3
+
+static const char *program =
+    "(val &gc-threads %d)\n"
+    "(val &future-threads %d)\n"
+    "(define build (n) (if (= n 0) '() (cons n (build (- n 1)))))\n"
+    "(define sum (xs) (foldl + 0 xs))\n"
+    "(define loop (k acc)\n"
+    "  (if (= k 0) acc (loop (- k 1) (+ acc (sum (build 100))))))\n"
+    "(val f (future (loop 50 0)))\n"
+    "(val answer (+ (loop 100 %d) (touch f)))\n";
+
+static int failures;
+
+static void *run(void *arg) {
+    int id = (int) (long) arg;
+    char source[1024];
+    int round;
+
+    for (round = 0; round < NROUNDS; round++) {
+        int seed = 1000 * id + round;
+        Env *envp = initscheme();
+        Value *answer;
+
+        snprintf(source, sizeof(source), program, id % 3 + 1, id % 2 + 1, seed);
+        if (setjmp(errorjmp)) {
+            fprintf(stderr, "thread %d, round %d: error\n", id, round);
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+            freescheme();
+            return NULL;
+        }
+        readevalprint(stringxdefs("embedded program", source), envp,
+                      NO_ECHOES);
+        answer = find(strtoname("answer"), *envp);
+        if (answer == NULL || answer->alt != NUM ||
+            answer->u.num != 5050 * 150 + seed) {
+            fprintf(stderr, "thread %d, round %d: wrong answer\n", id, round);
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+        }
+        freescheme();
+    }
+    return NULL;
+}
+
+int main(void) {
+    pthread_t threads[NTHREADS];
+    long i;
+
+    for (i = 0; i < NTHREADS; i++)
+        pthread_create(&threads[i], NULL, run, (void *) i);
+    for (i = 0; i < NTHREADS; i++)
+        pthread_join(threads[i], NULL);
+    if (failures > 0)
+        return 1;
+    printf("%d interpreters on %d threads: all answers right\n",
+           NTHREADS * NROUNDS, NTHREADS);
+    return 0;
+}